@@ -47,7 +47,7 @@ import network
 import espnow
 from neopixel import NeoPixel
 import utime
-import struct
+from espnow_rc import decode_channels, is_keepalive, addressed_to
 
 button = Pin(9, Pin.IN) # User key/button on CyberBrick Core
 
@@ -173,12 +173,19 @@ def mapchannel(chvalue, minmapvalue, maxmapvalue):
   else:
     return SERVORAWmidpoint - ((CRSF_CHANNEL_VALUE_MID-chvalue)*(SERVORAWmidpoint-minmapvalue)/(CRSF_CHANNEL_VALUE_MID-CRSF_CHANNEL_VALUE_MIN))
 
+last_rx_ms = utime.ticks_ms() # time of the last frame for this receiver
+
 while True:
   if button.value() == 0:
     send_bind()
   try:
     # Receive message (host MAC, message, 500ms failsafe timeout)
     host, msg = e.recv(500)
+    if msg is not None and not addressed_to(msg, mac):
+      # Convoy frame driving other models only, no signal for this one once the failsafe timeout passed
+      if utime.ticks_diff(utime.ticks_ms(), last_rx_ms) < 500:
+        continue
+      msg = None
     if msg == None:
       # Failsafe
       # Motor off, no change to steering
@@ -209,8 +216,9 @@ while True:
       enow_reset()
 
     else:
-      if len(msg) > 31:
-        ch = struct.unpack('<HHHHHHHHHHHHHHHH', msg)
+      last_rx_ms = utime.ticks_ms()
+      ch = decode_channels(msg, mac)
+      if ch is not None:
         if len(ch) == 16:
           # Received expected CRSF telegram channel count from the handset
           # Blink green
@@ -291,8 +299,11 @@ while True:
               M2A.duty_u16(0)
               M2B.duty_u16((int)(min(PWMGAINCOEFFICIENTNEG*(CRSF_CHANNEL_VALUE_MID-lefttrack), FULLSCALE16BIT)))
 
+      elif is_keepalive(msg):
+        # Channels unchanged at the transmitter (send-on-change mode), hold the outputs
+        pass
       else:
-        # Unexpected message length - blink yellow
+        # Unexpected message - blink yellow
         if ((utime.ticks_ms() % blinkertime_ms) > (blinkertime_ms / 2)):
           np[0] = (0, 0, 0) # Dark phase
         else:
@@ -35,6 +35,12 @@ The most widely used mapping of the first 4 control channels are (Mode 2, AETR):
 2) ch2 - right vertical (RV) stick (up 173, down 1811)
 3) ch3 - left vertical (LV) stick (down 173, up 1811)
 4) ch4 - left horizontal (LH) stick (left 173, right 1811)
+
+Every received frame is printed as one line:
+  <ticks_ms> <seq> | <ch1> ... <ch16>
+where seq is the frame sequence number ('-' for transmitter firmware that
+does not send one). Capture the REPL output to a file and run
+tools/link_stats.py on it for loss, burst-loss and duplicate statistics.
 """
 
 from machine import Pin, PWM
@@ -42,7 +48,7 @@ import network
 import espnow
 from neopixel import NeoPixel
 import utime
-import struct
+from espnow_rc import decode_frame, addressed_to
 
 button = Pin(9, Pin.IN) # User key/button on CyberBrick Core
 
@@ -110,12 +116,19 @@ np.write()
 
 blinkertime_ms = 750  # 1.5 Hz
 
+last_rx_ms = utime.ticks_ms() # time of the last frame for this receiver
+
 while True:
   if button.value() == 0:
     send_bind()
   try:
     # Receive message (host MAC, message, 500ms failsafe timeout)
     host, msg = e.recv(500)
+    if msg is not None and not addressed_to(msg, mac):
+      # Convoy frame driving other models only, no signal for this one once the failsafe timeout passed
+      if utime.ticks_diff(utime.ticks_ms(), last_rx_ms) < 500:
+        continue
+      msg = None
     if msg == None:
       # No signal from remote, blink red
       if ((utime.ticks_ms() % blinkertime_ms) > (blinkertime_ms / 2)):
@@ -127,11 +140,16 @@ while True:
       enow_reset()
 
     else:
-      if len(msg) > 31:
-        ch = struct.unpack('<HHHHHHHHHHHHHHHH', msg)
-        if len(ch) == 16:
+      last_rx_ms = utime.ticks_ms()
+      frame = decode_frame(msg, mac)
+      if frame is not None:
+        seq, ch = frame
+        if ch is None:
+          print('%-9i%-6s| keepalive' % (utime.ticks_ms(), seq))
+        elif len(ch) == 16:
           # Received expected CRSF telegram channel count from the handset
-          print('%-5i%-5i%-5i%-5i| %-5i%-5i%-5i%-5i|%-5i%-5i%-5i%-5i| %-5i%-5i%-5i%-5i' % (ch[0:16]))
+          print('%-9i%-6s| ' % (utime.ticks_ms(), '-' if seq is None else seq) +
+                '%-5i%-5i%-5i%-5i| %-5i%-5i%-5i%-5i|%-5i%-5i%-5i%-5i| %-5i%-5i%-5i%-5i' % (ch[0:16]))
           # Blink Core LED green
           if ((utime.ticks_ms() % blinkertime_ms) > (blinkertime_ms / 2)):
             np[0] = (0, 0, 0) # Dark phase
@@ -139,8 +157,8 @@ while True:
             np[0] = (0, 10, 0) # Dim green phase
           np.write()
       else:
-        # Unexpected message length
-        print(f"Unexpected ESP-NOW message length: {len(msg)}")
+        # Unexpected message
+        print(f"Unexpected ESP-NOW message ({len(msg)} bytes)")
         # Blink yellow
         if ((utime.ticks_ms() % blinkertime_ms) > (blinkertime_ms / 2)):
           np[0] = (0, 0, 0) # Dark phase
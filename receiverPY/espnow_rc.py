@@ -0,0 +1,162 @@
+"""
+This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+https://github.com/rotorman/CyberBrick_ESPNOW
+Copyright (C) 2025, Risto Koiva
+
+License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+"""
+
+"""
+Reference decoder of the ESP-NOW frames sent by the transmitter firmware.
+Runs both on the CyberBrick Core (MicroPython, copy this file next to the
+model script) and on a PC (CPython) for host side tools.
+
+The wire format is defined in transmitterFW/lib/EspNowProtocol/espnow_protocol.h:
+
+Version 2, 26 bytes:
+  byte 0      magic 0xCB
+  byte 1      version 2
+  bytes 2-3   sequence number, little-endian, incremented for every frame the
+              transmitter hands to the radio and wrapping at 65536, so a gap
+              is a frame lost on air
+  bytes 4-25  16 channels of 11 bits, LSB first (CRSF RC channels packed layout)
+
+Version 2 keepalive, 4 bytes: the header alone, sent by a transmitter built
+with ESPNOW_SEND_ON_CHANGE while the channels are unchanged. The receiver
+holds its outputs, receiving it restarts the failsafe timeout like any frame.
+
+Version 2 group (convoy) frame, 28 + 3 * slots bytes, broadcast by a
+transmitter built with ESPNOW_CONVOY to drive several models at once:
+  byte 0      magic 0xCC
+  byte 1      version 2
+  bytes 2-3   sequence number, as above
+  byte 4      slots, number of receivers driven by the frame
+  byte 5      width, channels per receiver
+  bytes 6-27  the 16 channels, as above
+  then        3 bytes per slot: the last 3 bytes of that receiver's MAC address
+The receiver of slot n gets channels n * width to n * width + width - 1 as its
+channels 1 to width, its remaining channels are centered.
+
+Version 1, 24 bytes: as version 2 without the sequence number.
+
+Legacy, 32 bytes: 16 channels as little-endian 16-bit values, no header
+(transmitter firmware built with ESPNOW_LEGACY_PAYLOAD or before the
+versioned format).
+"""
+
+import struct
+
+ESPNOW_RC_MAGIC = 0xCB
+ESPNOW_RC_GROUP_MAGIC = 0xCC
+ESPNOW_RC_CHANNEL_MID = 992
+ESPNOW_RC_MAC_TAIL_LEN = 3
+ESPNOW_RC_VERSION = 2
+ESPNOW_RC_NUM_CHANNELS = 16
+ESPNOW_RC_CHANNEL_BITS = 11
+ESPNOW_RC_CHANNELS_BYTES = 22
+ESPNOW_RC_LEGACY_LEN = 32
+ESPNOW_RC_KEEPALIVE_LEN = 4
+
+def unpack_channels(data, offset=0, count=ESPNOW_RC_NUM_CHANNELS, bits=ESPNOW_RC_CHANNEL_BITS):
+  # LSB first bit unpacking, works without big integers
+  mask = (1 << bits) - 1
+  ch = []
+  value = 0
+  merged = 0
+  i = offset
+  for _ in range(count):
+    while merged < bits:
+      value |= data[i] << merged
+      i += 1
+      merged += 8
+    ch.append(value & mask)
+    value >>= bits
+    merged -= bits
+  return ch
+
+def decode_group(msg, mac):
+  # Returns (seq, channels) of a group frame for the receiver with the MAC address
+  # `mac`, or None if the receiver is not part of the group
+  n = len(msg)
+  if n < 6 or msg[1] != 2:
+    return None
+  slots = msg[4]
+  width = msg[5]
+  if slots * width > ESPNOW_RC_NUM_CHANNELS or n != 6 + ESPNOW_RC_CHANNELS_BYTES + ESPNOW_RC_MAC_TAIL_LEN * slots:
+    return None
+  tail = bytes(mac[-ESPNOW_RC_MAC_TAIL_LEN:])
+  for slot in range(slots):
+    offset = 6 + ESPNOW_RC_CHANNELS_BYTES + ESPNOW_RC_MAC_TAIL_LEN * slot
+    if bytes(msg[offset:offset + ESPNOW_RC_MAC_TAIL_LEN]) == tail:
+      ch = unpack_channels(msg, 6)[slot * width:slot * width + width]
+      return msg[2] | (msg[3] << 8), tuple(ch + [ESPNOW_RC_CHANNEL_MID] * (ESPNOW_RC_NUM_CHANNELS - width))
+  return None
+
+def decode_frame(msg, mac=None):
+  # Returns (seq, channels) of a received frame, seq is None for frames without
+  # a sequence number and channels is None for a keepalive,
+  # or None if the frame is not an RC frame of a known format.
+  # Group frames are decoded for the receiver with the MAC address `mac`.
+  if msg is None:
+    return None
+  n = len(msg)
+  if n == ESPNOW_RC_LEGACY_LEN:
+    return None, struct.unpack('<16H', msg)
+  if n > 1 and msg[0] == ESPNOW_RC_GROUP_MAGIC and mac is not None:
+    return decode_group(msg, mac)
+  if n < 2 or msg[0] != ESPNOW_RC_MAGIC:
+    return None
+  if msg[1] == 2 and n == 4 + ESPNOW_RC_CHANNELS_BYTES:
+    return msg[2] | (msg[3] << 8), tuple(unpack_channels(msg, 4))
+  if msg[1] == 2 and n == ESPNOW_RC_KEEPALIVE_LEN:
+    return msg[2] | (msg[3] << 8), None
+  if msg[1] == 1 and n == 2 + ESPNOW_RC_CHANNELS_BYTES:
+    return None, tuple(unpack_channels(msg, 2))
+  return None
+
+def addressed_to(msg, mac):
+  # False for a group frame that does not drive the receiver with the MAC address `mac`
+  if msg is None or len(msg) < 2 or msg[0] != ESPNOW_RC_GROUP_MAGIC:
+    return True
+  return decode_group(msg, mac) is not None
+
+def decode_channels(msg, mac=None):
+  # Returns the 16 channel values (CRSF format, 172 to 1811) of a received frame,
+  # or None if the frame is a keepalive or not an RC frame of a known format
+  frame = decode_frame(msg, mac)
+  if frame is None:
+    return None
+  return frame[1]
+
+def is_keepalive(msg):
+  # True for a keepalive frame: the link is up, the channels did not change
+  return msg is not None and len(msg) == ESPNOW_RC_KEEPALIVE_LEN and msg[0] == ESPNOW_RC_MAGIC and msg[1] == 2
+
+def encode_channels(ch, seq=0):
+  # Builds a current version frame, for host side tools and tests
+  value = 0
+  for n in range(ESPNOW_RC_NUM_CHANNELS):
+    value |= (ch[n] & ((1 << ESPNOW_RC_CHANNEL_BITS) - 1)) << (n * ESPNOW_RC_CHANNEL_BITS)
+  packed = bytes((value >> (8 * n)) & 0xFF for n in range(ESPNOW_RC_CHANNELS_BYTES))
+  return bytes((ESPNOW_RC_MAGIC, ESPNOW_RC_VERSION, seq & 0xFF, (seq >> 8) & 0xFF)) + packed
+
+def encode_keepalive(seq=0):
+  # Builds a keepalive frame, for host side tools and tests
+  return bytes((ESPNOW_RC_MAGIC, ESPNOW_RC_VERSION, seq & 0xFF, (seq >> 8) & 0xFF))
+
+def encode_group(ch, macs, seq=0):
+  # Builds a group frame for the receivers with the MAC addresses `macs`, for host side tools and tests
+  frame = encode_channels(ch, seq)
+  slots = len(macs)
+  return (bytes((ESPNOW_RC_GROUP_MAGIC, ESPNOW_RC_VERSION, seq & 0xFF, (seq >> 8) & 0xFF, slots, ESPNOW_RC_NUM_CHANNELS // slots)) +
+          frame[4:] + b''.join(bytes(mac[-ESPNOW_RC_MAC_TAIL_LEN:]) for mac in macs))
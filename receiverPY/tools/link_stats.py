@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""
+This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+https://github.com/rotorman/CyberBrick_ESPNOW
+Copyright (C) 2025, Risto Koiva
+
+License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+"""
+
+"""
+Host side ESP-NOW link statistics from a captured receiver log.
+
+Reads the REPL output of the debug receiver script (debug/debug.py), one
+line per received frame:
+  <ticks_ms> <seq> | <ch1> ... <ch16>
+  <ticks_ms> <seq> | keepalive
+Other lines (and frames without a sequence number) are skipped. Keepalives
+count like channel frames, in send-on-change mode the gaps between them show
+up as transmitter pauses.
+
+Reports the loss rate, the distribution of burst-loss lengths, duplicate and
+reordered frames. Since the transmitter only advances the sequence number
+for frames it hands to the radio, a pause in reception with contiguous
+sequence numbers means the transmitter did not send (e.g. handset
+disconnected), not that frames were lost.
+
+Usage: link_stats.py [--pause-ms N] [log ...]   (stdin without a log file)
+       link_stats.py --self-test                (checks the statistics on known sequences)
+"""
+
+import argparse
+import re
+import sys
+
+SEQ_MODULO = 1 << 16
+REORDER_WINDOW = 1024 # how far back a late frame may arrive and still be matched to a gap
+
+LINE = re.compile(r'^\s*(\d+)\s+(\d+)\s*\|\s*(keepalive)?')
+
+class LinkStats:
+  def __init__(self, pause_ms):
+    self.pause_ms = pause_ms
+    self.received = 0
+    self.keepalives = 0
+    self.expected = 0
+    self.lost = 0
+    self.duplicates = 0
+    self.reordered = 0
+    self.restarts = 0
+    self.bursts = {} # burst length -> count
+    self.tx_pauses = 0
+    self.tx_pause_ms = 0
+    self.last_seq = None
+    self.last_ticks = None
+    self.missing = {} # seq -> (first seq, length) of the burst it was counted in, for late frames
+    self.seen = {} # recently received seq -> ticks, tells duplicates from a transmitter restart
+
+  def frame(self, ticks, seq, keepalive=False):
+    self.received += 1
+    if keepalive:
+      self.keepalives += 1
+    if self.last_seq is None:
+      self._start(ticks, seq)
+      return
+
+    diff = (seq - self.last_seq) % SEQ_MODULO
+    if diff == 0:
+      self.duplicates += 1
+      return
+    if diff >= SEQ_MODULO // 2:
+      # Older than the newest frame seen
+      if seq in self.missing:
+        # Late, the burst it was counted in splits into the frames before and after it
+        self._split(seq)
+        self.lost -= 1
+        self.reordered += 1
+        self.seen[seq] = ticks
+      elif seq in self.seen and ticks - self.seen[seq] < self.pause_ms:
+        self.duplicates += 1
+      else:
+        # The sequence jumped back to a number not seen recently: the transmitter restarted
+        self.restarts += 1
+        self._start(ticks, seq)
+      return
+
+    gap = diff - 1
+    self.expected += diff
+    if gap:
+      self.lost += gap
+      self.bursts[gap] = self.bursts.get(gap, 0) + 1
+      burst = ((seq - gap) % SEQ_MODULO, gap)
+      for n in range(1, min(gap, REORDER_WINDOW) + 1):
+        self.missing[(seq - n) % SEQ_MODULO] = burst
+    elif self.last_ticks is not None and ticks - self.last_ticks >= self.pause_ms:
+      # Nothing lost, nothing sent
+      self.tx_pauses += 1
+      self.tx_pause_ms += ticks - self.last_ticks
+    self.seen[seq] = ticks
+    self._forget_old(seq)
+    self.last_seq = seq
+    self.last_ticks = ticks
+
+  def _split(self, seq):
+    first, length = self.missing.pop(seq)
+    self.bursts[length] -= 1
+    left = (seq - first) % SEQ_MODULO
+    right = length - left - 1
+    for part in (left, right):
+      if part:
+        self.bursts[part] = self.bursts.get(part, 0) + 1
+    # The other missing frames of the burst now belong to one of the two parts
+    for n in range(max(0, length - REORDER_WINDOW), length):
+      other = (first + n) % SEQ_MODULO
+      if self.missing.get(other) == (first, length):
+        self.missing[other] = (first, left) if n < left else ((seq + 1) % SEQ_MODULO, right)
+
+  def _start(self, ticks, seq):
+    self.expected += 1
+    self.last_seq = seq
+    self.last_ticks = ticks
+    self.missing = {}
+    self.seen = {seq: ticks}
+
+  def _forget_old(self, seq):
+    if len(self.missing) > 2 * REORDER_WINDOW:
+      self.missing = {s: g for s, g in self.missing.items() if (seq - s) % SEQ_MODULO <= REORDER_WINDOW}
+    if len(self.seen) > 2 * REORDER_WINDOW:
+      self.seen = {s: t for s, t in self.seen.items() if (seq - s) % SEQ_MODULO <= REORDER_WINDOW}
+
+  def report(self, out):
+    loss = 100.0 * self.lost / self.expected if self.expected else 0.0
+    out.write('frames received     %d (%d keepalives)\n' % (self.received, self.keepalives))
+    out.write('frames expected     %d\n' % self.expected)
+    out.write('frames lost         %d (%.2f %%)\n' % (self.lost, loss))
+    out.write('duplicates          %d\n' % self.duplicates)
+    out.write('reordered           %d\n' % self.reordered)
+    out.write('transmitter restarts %d\n' % self.restarts)
+    out.write('transmitter pauses  %d (%d ms, gaps >= %d ms without lost frames)\n' % (self.tx_pauses, self.tx_pause_ms, self.pause_ms))
+    bursts = sum(self.bursts.values())
+    if bursts:
+      out.write('\nburst-loss length distribution (%d bursts, mean %.2f frames):\n' % (bursts, self.lost_in_bursts() / bursts))
+      out.write('%8s %8s %8s\n' % ('length', 'bursts', 'frames'))
+      for length in sorted(self.bursts):
+        if not self.bursts[length]:
+          continue
+        out.write('%8d %8d %8d\n' % (length, self.bursts[length], length * self.bursts[length]))
+
+  def lost_in_bursts(self):
+    return sum(length * count for length, count in self.bursts.items())
+
+# (sequence numbers received, frames lost, reordered, {burst length: bursts})
+SELF_TESTS = [
+  ([1, 2, 6, 3, 4, 7], 1, 2, {1: 1}),       # two late frames from the same burst
+  ([1, 5, 3], 2, 1, {1: 2}),                # a late frame splits its burst in two
+  ([1, 5, 2, 3, 4], 0, 3, {}),              # the whole burst arrives late
+  ([10, 14, 13, 11], 1, 2, {1: 1}),         # late frames in reverse order
+  ([65534, 1, 0], 1, 1, {1: 1}),            # a burst across the 16-bit wrap
+]
+
+def self_test():
+  failed = 0
+  for seqs, lost, reordered, bursts in SELF_TESTS:
+    stats = LinkStats(100)
+    for n, seq in enumerate(seqs):
+      stats.frame(n * 10, seq)
+    got = {length: count for length, count in stats.bursts.items() if count}
+    if (stats.lost, stats.reordered, got) != (lost, reordered, bursts):
+      print('FAIL %s: lost %d, reordered %d, bursts %s; expected %d, %d, %s' % (seqs, stats.lost, stats.reordered, got, lost, reordered, bursts))
+      failed += 1
+  print('%d of %d self tests passed' % (len(SELF_TESTS) - failed, len(SELF_TESTS)))
+  return 1 if failed else 0
+
+def main():
+  parser = argparse.ArgumentParser(description='ESP-NOW link statistics from a captured receiver log (debug/debug.py output)')
+  parser.add_argument('logs', nargs='*', help='receiver log files, stdin if none')
+  parser.add_argument('--pause-ms', type=int, default=100, help='reception gap counted as a transmitter pause when no frame was lost (default 100)')
+  parser.add_argument('--self-test', action='store_true', help='check the statistics on known sequences and exit')
+  args = parser.parse_args()
+  if args.self_test:
+    return self_test()
+
+  stats = LinkStats(args.pause_ms)
+  files = [open(name, errors='replace') for name in args.logs] or [sys.stdin]
+  for f in files:
+    for line in f:
+      m = LINE.match(line)
+      if m:
+        stats.frame(int(m.group(1)), int(m.group(2)), m.group(3) is not None)
+  stats.report(sys.stdout)
+  return 0 if stats.received else 1
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -27,7 +27,23 @@
 
 #define GPIO_PIN_BOOT0 0
 #define CRSF_NUM_CHANNELS 16U
-#define RF_FRAME_RATE_US 20000U // 50 Hz
+#ifndef RF_FRAME_RATE_US
+#define RF_FRAME_RATE_US 20000U // packet rate at startup, 50 Hz, one of RFpacketIntervalsUS
+#endif
+#ifndef BIND_TIMEOUT_MS
+#define BIND_TIMEOUT_MS 30000U // how long "Bind" in the parameter menu listens for a receiver's bind frame
+#endif
+
+// ESP-NOW packet rates selectable at runtime: 50, 100, 250, 500 and 1000 Hz
+static constexpr uint32_t RFpacketIntervalsUS[] = {20000, 10000, 4000, 2000, 1000};
+
+/**
+ * @brief Change the ESP-NOW packet rate, together with the handset sync and telemetry timing
+ * @param intervalUS one of RFpacketIntervalsUS
+ * @return false if the interval is not supported or too short for the current handset baud rate
+ */
+bool setPacketInterval(uint32_t intervalUS);
+uint32_t getPacketInterval();
 
 typedef enum
 {
@@ -43,4 +59,77 @@ inline void setConnectionState(connectionState_e newState) {
     connectionState = newState;
 }
 
-extern volatile uint16_t ChannelData[CRSF_NUM_CHANNELS]; // Current state of channels, CRSF format
+extern volatile uint16_t ChannelData[CRSF_NUM_CHANNELS]; // Current state of channels, CRSF format, written by the handset input only
+
+typedef struct
+{
+    uint32_t switches;      // model selections whose receiver has been reached since the last reset
+    uint32_t lastUS;        // time from the model selection to the first frame acknowledged by its receiver
+    uint32_t minUS;
+    uint32_t maxUS;
+    uint32_t avgUS;
+    uint32_t peerHits;      // selections whose receiver was still a registered ESP-NOW peer (since boot)
+    uint32_t peerMisses;    // selections that had to register the receiver
+    uint32_t peerEvictions; // receivers unregistered to make room
+} modelSwitchStats_t;
+
+/**
+ * @brief Read the model selection statistics
+ * @param reset start a new measurement window of the switch times after reading
+ */
+void getModelSwitchStats(modelSwitchStats_t *stats, bool reset);
+
+// Stages of an RC frame on its way from the handset to the model and the timing of the send path,
+// see getLatencyHistogram()
+typedef enum
+{
+    latencyInput,      // arrival at the UART to RcPacketToChannelsData()
+    latencySchedule,   // RcPacketToChannelsData() to esp_now_send(), the wait for the next send slot
+    latencyAir,        // esp_now_send() to the ESP-NOW send callback, every frame including keepalives and failed ones
+    latencyTotal,      // arrival at the UART to the send callback of its first transmission, if that succeeded
+    latencyTimerIsr,   // duration of the hardware timer ISR
+    latencyWakeup,     // timer ISR to the sender task running
+    latencyRxJitter,   // deviation of the time between two RC frame arrivals from the packet interval
+    latencyTurnaround, // half duplex: arrival of an RC frame to the line back in RX after the telemetry burst replying to it
+    latencyStageCount
+} latencyStage_e;
+
+/**
+ * @brief Read the log-scale latency histogram of one stage
+ * @param reset start over with the next sample
+ */
+void getLatencyHistogram(latencyStage_e stage, struct latencyHistogram_s *histogram, bool reset);
+
+typedef struct
+{
+    uint16_t kbps;         // ESP-NOW PHY rate the selected model's frames are sent at
+    bool adaptive;         // the rate follows the link (ESPNOW_PHY_RATE 0, or "Auto" in the parameter menu)
+    uint32_t stepsDown;    // adaptive moves to a more robust rate
+    uint32_t stepsUp;      // adaptive moves to a faster rate
+    uint32_t failedProbes; // moves up taken back within their first window
+} phyRateStats_t;
+
+/**
+ * @brief Read the ESP-NOW PHY rate and the moves of the adaptive rate
+ * @param reset start counting the moves from zero
+ */
+void getPhyRateStats(phyRateStats_t *stats, bool reset);
+
+typedef struct
+{
+    const char *name;
+    int8_t core;             // core the task runs on
+    uint8_t priority;        // FreeRTOS priority, 0 for the timer ISR
+    uint16_t loadPermille;   // busy share of the time since the last reset, in 0.1 %
+    uint32_t runs;           // wake-ups (loop() passes, ISR calls) since the last reset
+    uint32_t stackFreeBytes; // least free stack since the task started (high-water mark), 0 for the timer ISR
+} taskStats_t;
+
+/**
+ * @brief Read the CPU load and stack use of the firmware's tasks: the Arduino loop task, the CRSF RX task
+ * (CRSF_RX_TASK), the ESP-NOW sender task and the timer ISR
+ * @param stats receives up to `maxTasks` entries
+ * @param reset start a new load measurement window after reading
+ * @return the number of entries filled in
+ */
+uint8_t getTaskStats(taskStats_t *stats, uint8_t maxTasks, bool reset);
@@ -25,27 +25,164 @@
 
 #define crclen 256
 
+#ifndef CRC_SLICES
+#define CRC_SLICES 4 // most bytes consumed per step by calc(): 1, 4 or 8, costs a 256 entry table per byte
+#endif
+
+static_assert(CRC_SLICES == 1 || CRC_SLICES == 4 || CRC_SLICES == 8, "CRC_SLICES must be 1, 4 or 8");
+
+/* Slice-by-N: tab[0] is the classic byte table, tab[k][x] is the CRC of byte x followed by k zero bytes.
+   As the CRC is linear, N bytes are then folded in with N independent lookups instead of a chain of N. */
+
 class GENERIC_CRC8
 {
 private:
-    uint8_t crc8tab[crclen];
-    uint8_t crcpoly;
+    uint8_t crc8tab[CRC_SLICES][crclen];
 
 public:
-    GENERIC_CRC8(uint8_t poly);
-    uint8_t calc(const uint8_t data);
-    uint8_t calc(const uint8_t *data, uint16_t len, uint8_t crc = 0);
+    /**
+     * @brief Build the tables, at compile time when the object is constexpr
+     */
+    constexpr GENERIC_CRC8(uint8_t poly) : crc8tab{}
+    {
+        for (uint16_t i = 0; i < crclen; i++)
+        {
+            uint8_t crc = i;
+            for (uint8_t j = 0; j < 8; j++)
+            {
+                crc = (crc << 1) ^ ((crc & 0x80) ? poly : 0);
+            }
+            crc8tab[0][i] = crc;
+        }
+        for (uint8_t k = 1; k < CRC_SLICES; k++)
+        {
+            for (uint16_t i = 0; i < crclen; i++)
+            {
+                crc8tab[k][i] = crc8tab[0][crc8tab[k - 1][i]];
+            }
+        }
+    }
+
+    ICACHE_RAM_ATTR uint8_t calc(const uint8_t data) const
+    {
+        return crc8tab[0][data];
+    }
+
+    /**
+     * @tparam SLICES bytes per step, the default is the fastest the tables allow
+     */
+    template <unsigned SLICES = CRC_SLICES>
+    ICACHE_RAM_ATTR uint8_t calc(const uint8_t *data, uint16_t len, uint8_t crc = 0) const
+    {
+        static_assert(SLICES == 1 || SLICES == 4 || SLICES == 8, "SLICES must be 1, 4 or 8");
+        static_assert(SLICES <= CRC_SLICES, "not enough tables, raise CRC_SLICES");
+        if constexpr (SLICES == 8)
+        {
+            for (; len >= 8; len -= 8, data += 8)
+            {
+                crc = crc8tab[7][crc ^ data[0]] ^ crc8tab[6][data[1]] ^ crc8tab[5][data[2]] ^ crc8tab[4][data[3]] ^
+                      crc8tab[3][data[4]] ^ crc8tab[2][data[5]] ^ crc8tab[1][data[6]] ^ crc8tab[0][data[7]];
+            }
+        }
+        if constexpr (SLICES >= 4)
+        {
+            for (; len >= 4; len -= 4, data += 4)
+            {
+                crc = crc8tab[3][crc ^ data[0]] ^ crc8tab[2][data[1]] ^ crc8tab[1][data[2]] ^ crc8tab[0][data[3]];
+            }
+        }
+        while (len--)
+        {
+            crc = crc8tab[0][crc ^ *data++];
+        }
+        return crc;
+    }
 };
 
+/* CRCs of 8 to 16 bits. Internally the CRC is kept aligned to the top of a 16-bit register
+   (polynomial and value shifted up by 16 - bits), so the two register bytes slice like data bytes. */
+
 class Crc2Byte
 {
 private:
-    uint16_t _crctab[crclen];
+    uint16_t _crctab[CRC_SLICES][crclen];
     uint8_t  _bits;
     uint16_t _bitmask;
     uint16_t _poly;
 
+    constexpr void build(uint8_t bits, uint16_t poly)
+    {
+        _poly = poly;
+        _bits = bits;
+        _bitmask = (1 << _bits) - 1;
+        const uint16_t poly16 = poly << (16 - bits);
+        for (uint16_t i = 0; i < crclen; i++)
+        {
+            uint16_t crc = i << 8;
+            for (uint8_t j = 0; j < 8; j++)
+            {
+                crc = (crc << 1) ^ ((crc & 0x8000) ? poly16 : 0);
+            }
+            _crctab[0][i] = crc;
+        }
+        for (uint8_t k = 1; k < CRC_SLICES; k++)
+        {
+            for (uint16_t i = 0; i < crclen; i++)
+            {
+                const uint16_t crc = _crctab[k - 1][i];
+                _crctab[k][i] = (crc << 8) ^ _crctab[0][crc >> 8];
+            }
+        }
+    }
+
 public:
+    constexpr Crc2Byte() : _crctab{}, _bits(0), _bitmask(0), _poly(0) {}
+
+    /**
+     * @brief Build the tables, at compile time when the object is constexpr
+     */
+    constexpr Crc2Byte(uint8_t bits, uint16_t poly) : Crc2Byte()
+    {
+        build(bits, poly);
+    }
+
+    /**
+     * @brief (Re)build the tables at runtime, does nothing if they already are for `bits` and `poly`
+     * @param bits CRC width, 8 to 16
+     */
     void init(uint8_t bits, uint16_t poly);
-    uint16_t calc(uint8_t *data, uint8_t len, uint16_t crc);
+
+    /**
+     * @tparam SLICES bytes per step, the default is the fastest the tables allow
+     */
+    template <unsigned SLICES = CRC_SLICES>
+    ICACHE_RAM_ATTR uint16_t calc(const uint8_t *data, uint8_t len, uint16_t crc) const
+    {
+        static_assert(SLICES == 1 || SLICES == 4 || SLICES == 8, "SLICES must be 1, 4 or 8");
+        static_assert(SLICES <= CRC_SLICES, "not enough tables, raise CRC_SLICES");
+        const uint8_t shift = 16 - _bits;
+        uint16_t c = crc << shift;
+        if constexpr (SLICES == 8)
+        {
+            for (; len >= 8; len -= 8, data += 8)
+            {
+                c = _crctab[7][(c >> 8) ^ data[0]] ^ _crctab[6][(c & 0xFF) ^ data[1]] ^ _crctab[5][data[2]] ^
+                    _crctab[4][data[3]] ^ _crctab[3][data[4]] ^ _crctab[2][data[5]] ^ _crctab[1][data[6]] ^
+                    _crctab[0][data[7]];
+            }
+        }
+        if constexpr (SLICES >= 4)
+        {
+            for (; len >= 4; len -= 4, data += 4)
+            {
+                c = _crctab[3][(c >> 8) ^ data[0]] ^ _crctab[2][(c & 0xFF) ^ data[1]] ^ _crctab[1][data[2]] ^
+                    _crctab[0][data[3]];
+            }
+        }
+        while (len--)
+        {
+            c = (c << 8) ^ _crctab[0][(c >> 8) ^ *data++];
+        }
+        return (c >> shift) & _bitmask;
+    }
 };
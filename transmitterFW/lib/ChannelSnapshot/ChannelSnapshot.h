@@ -0,0 +1,101 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include "common.h"
+
+#define CHANNEL_SNAPSHOT_MAX_RETRIES 4 // reads of a snapshot being written before falling back to the last one read
+
+/**
+ * @brief The channels of the newest RC frame, handed from the handset input to the sender as a whole (seqlock).
+ *
+ * The writer makes the sequence number odd, writes the channels and makes it even again; a reader that sees
+ * an odd or changed sequence number around its copy has raced a write and reads again. A reader that cannot
+ * get a clean copy within CHANNEL_SNAPSHOT_MAX_RETRIES attempts (the writer was preempted by it mid-write on
+ * the same core, e.g. the timer ISR) returns its previous copy, so a frame never mixes two RC frames.
+ * One writer context and one reader context.
+ *
+ * @tparam N number of channels, even
+ */
+template <uint8_t N>
+class ChannelSnapshot
+{
+    static_assert(N % 2 == 0, "ChannelSnapshot needs an even number of channels");
+
+public:
+    /**
+     * @brief Publish a new set of channels, writer side
+     */
+    void ICACHE_RAM_ATTR publish(const volatile uint16_t *channels)
+    {
+        const uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (uint8_t i = 0; i < N / 2; i++)
+        {
+            words[i].store(channels[2 * i] | (uint32_t)channels[2 * i + 1] << 16, std::memory_order_relaxed);
+        }
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief Copy the newest channels, reader side
+     * @return false if the previous copy had to be returned
+     */
+    bool ICACHE_RAM_ATTR read(uint16_t *channels)
+    {
+        for (uint8_t attempt = 0; attempt < CHANNEL_SNAPSHOT_MAX_RETRIES; attempt++)
+        {
+            const uint32_t s = seq.load(std::memory_order_acquire);
+            if ((s & 1) == 0)
+            {
+                uint32_t copy[N / 2];
+                for (uint8_t i = 0; i < N / 2; i++)
+                {
+                    copy[i] = words[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq.load(std::memory_order_relaxed) == s)
+                {
+                    memcpy(last, copy, sizeof(last));
+                    memcpy(channels, last, sizeof(last));
+                    return true;
+                }
+            }
+            retries++;
+        }
+        fallbacks++;
+        memcpy(channels, last, sizeof(last));
+        return false;
+    }
+
+    uint32_t getRetries() const { return retries; }     // reads repeated because they raced a write
+    uint32_t getFallbacks() const { return fallbacks; } // reads that returned the previous copy
+
+private:
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint32_t> words[N / 2] = {};
+    uint16_t last[N] = {0}; // reader's last clean copy
+    volatile uint32_t retries = 0;
+    volatile uint32_t fallbacks = 0;
+};
@@ -0,0 +1,113 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+
+/* Packing and unpacking of LSB-first bit-packed channel values (CRSF: 16 channels of 11 bits).
+   Everything is resolved at compile time: every channel is moved from or to one or two 32-bit words
+   with fixed shifts and a mask, and the channel loop is fully unrolled.
+   The packed data is accessed as whole little-endian 32-bit words, so it must be word aligned and
+   cover the last word touched, see crsfUnpackWords().
+ */
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "crsfUnpackChannels() expects a little-endian CPU");
+
+/**
+ * @return the number of 32-bit words accessed when unpacking `count` values of `bits` each, starting at bit `firstBit`
+ */
+constexpr unsigned crsfUnpackWords(unsigned bits, unsigned count, unsigned firstBit = 0)
+{
+    return (firstBit + bits * count + 31) / 32;
+}
+
+template <unsigned BITS, unsigned FIRST_BIT, unsigned CH>
+static inline uint32_t crsfUnpackChannel(const uint32_t *words)
+{
+    static_assert(BITS > 0 && BITS <= 32, "channel width must fit into a 32-bit word");
+    constexpr unsigned bit = FIRST_BIT + CH * BITS;
+    constexpr unsigned word = bit / 32;
+    constexpr unsigned shift = bit % 32;
+    constexpr uint32_t mask = BITS == 32 ? 0xFFFFFFFFU : (1U << BITS) - 1;
+
+    if constexpr (shift + BITS <= 32)
+    {
+        return (words[word] >> shift) & mask;
+    }
+    else
+    {
+        // The value straddles two words
+        return ((words[word] >> shift) | (words[word + 1] << (32 - shift))) & mask;
+    }
+}
+
+template <unsigned BITS, unsigned FIRST_BIT, typename T, size_t... CH>
+static inline void crsfUnpackChannels(const uint32_t *words, T *channels, std::index_sequence<CH...>)
+{
+    ((channels[CH] = crsfUnpackChannel<BITS, FIRST_BIT, CH>(words)), ...);
+}
+
+/**
+ * @brief Unpack `COUNT` values of `BITS` bits each, stored LSB first starting at bit `FIRST_BIT` of `words`.
+ *
+ * @param words word aligned source, crsfUnpackWords(BITS, COUNT, FIRST_BIT) words are read
+ * @param channels destination, one element per value
+ */
+template <unsigned BITS, unsigned COUNT, unsigned FIRST_BIT = 0, typename T>
+static inline void crsfUnpackChannels(const uint32_t *words, T *channels)
+{
+    crsfUnpackChannels<BITS, FIRST_BIT>(words, channels, std::make_index_sequence<COUNT>{});
+}
+
+template <unsigned BITS, unsigned FIRST_BIT, unsigned CH>
+static inline void crsfPackChannel(uint32_t *words, uint32_t value)
+{
+    static_assert(BITS > 0 && BITS <= 32, "channel width must fit into a 32-bit word");
+    constexpr unsigned bit = FIRST_BIT + CH * BITS;
+    constexpr unsigned word = bit / 32;
+    constexpr unsigned shift = bit % 32;
+    constexpr uint32_t mask = BITS == 32 ? 0xFFFFFFFFU : (1U << BITS) - 1;
+
+    value &= mask;
+    words[word] |= value << shift;
+    if constexpr (shift + BITS > 32)
+    {
+        words[word + 1] |= value >> (32 - shift);
+    }
+}
+
+template <unsigned BITS, unsigned FIRST_BIT, typename T, size_t... CH>
+static inline void crsfPackChannels(uint32_t *words, const T *channels, std::index_sequence<CH...>)
+{
+    (crsfPackChannel<BITS, FIRST_BIT, CH>(words, channels[CH]), ...);
+}
+
+/**
+ * @brief Pack `COUNT` values of `BITS` bits each LSB first, starting at bit `FIRST_BIT` of `words`.
+ * The bits of the values are OR-ed in, the destination bits must be clear.
+ *
+ * @param words word aligned destination, crsfUnpackWords(BITS, COUNT, FIRST_BIT) words are written
+ * @param channels source, one element per value, bits above `BITS` are ignored
+ */
+template <unsigned BITS, unsigned COUNT, unsigned FIRST_BIT = 0, typename T>
+static inline void crsfPackChannels(uint32_t *words, const T *channels)
+{
+    crsfPackChannels<BITS, FIRST_BIT>(words, channels, std::make_index_sequence<COUNT>{});
+}
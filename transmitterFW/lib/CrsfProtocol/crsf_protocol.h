@@ -72,6 +72,9 @@ typedef enum : uint8_t
     // Extended Header Frames, range from 0x28 to 0x96
     CRSF_FRAMETYPE_DEVICE_PING = 0x28,
     CRSF_FRAMETYPE_DEVICE_INFO = 0x29,
+    CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY = 0x2B,
+    CRSF_FRAMETYPE_PARAMETER_READ = 0x2C,
+    CRSF_FRAMETYPE_PARAMETER_WRITE = 0x2D,
     CRSF_FRAMETYPE_COMMAND = 0x32,
     CRSF_FRAMETYPE_HANDSET = 0x3A
 } crsf_frame_type_e;
@@ -201,6 +204,7 @@ typedef struct deviceInformationPacket_s
 union inBuffer_U
 {
     uint8_t asUint8_t[CRSF_MAX_PACKET_LEN]; // max 64 bytes for CRSF packet serial buffer
+    uint32_t asUint32_t[CRSF_MAX_PACKET_LEN / 4]; // word view, also keeps the buffer word aligned for crsfUnpackChannels()
     rcPacket_t asRCPacket_t;    // access the memory as RC data
                                 // add other packet types here
 };
@@ -0,0 +1,149 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "crsf_protocol.h"
+#include "crsf_bitpack.h"
+
+/* Wire format of the ESP-NOW frames sent to the model receivers.
+   The reference decoder is receiverPY/espnow_rc.py, keep both in sync.
+
+   Version 2, 26 bytes:
+     uint8_t magic    ESPNOW_RC_MAGIC
+     uint8_t version  ESPNOW_RC_VERSION
+     uint16_t seq     little-endian, incremented for every frame handed to ESP-NOW, wraps around
+     22 bytes         16 channels of 11 bits, LSB first, same layout as the CRSF RC channels packed payload
+
+   Version 2 keepalive, 4 bytes: the header alone. Sent in send-on-change mode (ESPNOW_SEND_ON_CHANGE)
+   while the channels are unchanged, the receiver holds its outputs and its failsafe timer restarts.
+   Its sequence number counts like that of a channels frame.
+
+   Version 2 group (convoy) frame, 28 + 3 * slots bytes, broadcast (ESPNOW_CONVOY):
+     uint8_t magic    ESPNOW_RC_GROUP_MAGIC
+     uint8_t version  ESPNOW_RC_VERSION
+     uint16_t seq     as above
+     uint8_t slots    number of receivers driven by the frame, 1 to ESPNOW_RC_MAX_SLOTS
+     uint8_t width    channels per receiver, slots * width <= 16
+     22 bytes         the 16 channels as in the version 2 frame
+     slots * 3 bytes  last 3 bytes of the MAC address of the receiver of each slot
+   The receiver of slot n uses channels n * width to n * width + width - 1 as its channels 1 to width.
+
+   Version 1, 24 bytes: as version 2 without the sequence number.
+
+   Legacy (ESPNOW_LEGACY_PAYLOAD, or the Payload entry of the parameter menu), 32 bytes: the 16 channels as little-endian uint16_t, no header.
+   It is told apart from the versioned frames by its length.
+ */
+
+#define ESPNOW_RC_MAGIC   0xCB
+#define ESPNOW_RC_GROUP_MAGIC 0xCC
+#define ESPNOW_RC_VERSION 2
+
+#define ESPNOW_RC_NUM_CHANNELS 16
+#define ESPNOW_RC_CHANNEL_BITS 11
+#define ESPNOW_RC_CHANNELS_BYTES (ESPNOW_RC_NUM_CHANNELS * ESPNOW_RC_CHANNEL_BITS / 8)
+#define ESPNOW_RC_MAX_SLOTS 8
+#define ESPNOW_RC_MAC_TAIL_BYTES 3
+
+typedef struct espnowRcHeader_s
+{
+    uint8_t magic;
+    uint8_t version;
+    uint16_t seq;
+} PACKED espnowRcHeader_t;
+
+typedef struct espnowRcChannelsPacket_s
+{
+    espnowRcHeader_t header;
+    uint8_t channels[ESPNOW_RC_CHANNELS_BYTES];
+} PACKED espnowRcChannelsPacket_t;
+
+static_assert(sizeof(espnowRcChannelsPacket_t) == 26, "ESP-NOW RC frame layout changed");
+
+typedef struct espnowRcGroupPacket_s
+{
+    espnowRcHeader_t header;
+    uint8_t slots;
+    uint8_t width;
+    uint8_t channels[ESPNOW_RC_CHANNELS_BYTES];
+    uint8_t macTails[ESPNOW_RC_MAX_SLOTS][ESPNOW_RC_MAC_TAIL_BYTES]; // only `slots` entries are sent
+} PACKED espnowRcGroupPacket_t;
+
+static_assert(offsetof(espnowRcGroupPacket_t, macTails) == 28, "ESP-NOW RC group frame layout changed");
+
+/**
+ * @return the number of bytes to send of a group frame for `slots` receivers
+ */
+static constexpr size_t espnowRcGroupPacketSize(uint8_t slots)
+{
+    return offsetof(espnowRcGroupPacket_t, macTails) + slots * ESPNOW_RC_MAC_TAIL_BYTES;
+}
+
+/**
+ * @brief Fill the header every ESP-NOW RC frame starts with
+ */
+static inline void espnowRcInitHeader(espnowRcHeader_t *header, uint8_t magic, uint16_t seq)
+{
+    header->magic = magic;
+    header->version = ESPNOW_RC_VERSION;
+    header->seq = seq;
+}
+
+/**
+ * @brief Build a keepalive frame, tells the receiver the link is up while the channels have not changed
+ */
+static inline void espnowRcMakeKeepalive(espnowRcHeader_t *packet, uint16_t seq)
+{
+    espnowRcInitHeader(packet, ESPNOW_RC_MAGIC, seq);
+}
+
+/**
+ * @brief Build a versioned ESP-NOW RC frame from channel values in CRSF format
+ * @param seq sequence number of the frame, lets the receiver tell lost frames from frames never sent
+ */
+static inline void espnowRcPackChannels(espnowRcChannelsPacket_t *packet, const volatile uint16_t *channels, uint16_t seq)
+{
+    uint32_t words[crsfUnpackWords(ESPNOW_RC_CHANNEL_BITS, ESPNOW_RC_NUM_CHANNELS)] = {0};
+    crsfPackChannels<ESPNOW_RC_CHANNEL_BITS, ESPNOW_RC_NUM_CHANNELS>(words, channels);
+
+    espnowRcInitHeader(&packet->header, ESPNOW_RC_MAGIC, seq);
+    memcpy(packet->channels, words, sizeof(packet->channels));
+}
+
+/**
+ * @brief Build a group frame driving `slots` receivers with `ESPNOW_RC_NUM_CHANNELS / slots` channels each
+ * @param macs the receivers' MAC addresses in slot order
+ */
+static inline void espnowRcPackGroup(espnowRcGroupPacket_t *packet, const volatile uint16_t *channels, uint16_t seq,
+                                     uint8_t slots, const uint8_t (*macs)[6])
+{
+    uint32_t words[crsfUnpackWords(ESPNOW_RC_CHANNEL_BITS, ESPNOW_RC_NUM_CHANNELS)] = {0};
+    crsfPackChannels<ESPNOW_RC_CHANNEL_BITS, ESPNOW_RC_NUM_CHANNELS>(words, channels);
+
+    espnowRcInitHeader(&packet->header, ESPNOW_RC_GROUP_MAGIC, seq);
+    packet->slots = slots;
+    packet->width = ESPNOW_RC_NUM_CHANNELS / slots;
+    memcpy(packet->channels, words, sizeof(packet->channels));
+    for (uint8_t n = 0; n < slots; n++)
+    {
+        memcpy(packet->macTails[n], &macs[n][6 - ESPNOW_RC_MAC_TAIL_BYTES], ESPNOW_RC_MAC_TAIL_BYTES);
+    }
+}
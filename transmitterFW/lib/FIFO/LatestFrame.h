@@ -0,0 +1,92 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include "common.h"
+
+/**
+ * @brief The newest frame of a stream where only the newest one matters, handed from one producer context to one
+ * consumer context (seqlock, as ChannelSnapshot). A frame published before the previous one was taken replaces it.
+ *
+ * The producer makes the sequence number odd, writes the frame and makes it even again. take() returns nothing
+ * while a write is in progress or when it raced one (the producer was preempted by it on the same core), the
+ * next call takes the frame.
+ *
+ * @tparam SIZE largest frame in bytes, a multiple of 4
+ */
+template <uint8_t SIZE>
+class LatestFrame
+{
+    static_assert(SIZE % 4 == 0, "LatestFrame size must be a multiple of 4");
+
+public:
+    /**
+     * @brief Publish a frame, replacing one not taken yet, producer side
+     */
+    void ICACHE_RAM_ATTR publish(const uint8_t *frame, uint8_t len)
+    {
+        uint32_t copy[SIZE / 4] = {};
+        memcpy(copy, frame, std::min(len, SIZE));
+        const uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        length.store(std::min(len, SIZE), std::memory_order_relaxed);
+        for (uint8_t i = 0; i < SIZE / 4; i++)
+        {
+            words[i].store(copy[i], std::memory_order_relaxed);
+        }
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief Take the frame published since the last take, consumer side
+     * @param frame SIZE bytes
+     * @param replaced incremented by the frames that were published but replaced before they could be taken
+     * @return the length of the frame, 0 if there is none
+     */
+    uint8_t ICACHE_RAM_ATTR take(uint8_t *frame, uint32_t *replaced)
+    {
+        const uint32_t s = seq.load(std::memory_order_acquire);
+        if (s == taken || (s & 1))
+            return 0;
+        uint32_t copy[SIZE / 4];
+        const uint8_t len = length.load(std::memory_order_relaxed);
+        for (uint8_t i = 0; i < SIZE / 4; i++)
+        {
+            copy[i] = words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) != s)
+            return 0;
+        *replaced += (s - taken) / 2 - 1;
+        taken = s;
+        memcpy(frame, copy, len);
+        return len;
+    }
+
+private:
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint8_t> length{0};
+    std::atomic<uint32_t> words[SIZE / 4] = {};
+    uint32_t taken = 0; // seq of the last frame taken, consumer only
+};
@@ -0,0 +1,324 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string.h>
+#include "common.h"
+
+/**
+ * @brief A single-producer/single-consumer FIFO without locks, a drop-in replacement for `FIFO` where
+ * exactly one context pushes and exactly one context pops (they may be the same).
+ *
+ * The head and tail are free running counters, only the consumer writes the head and only the producer
+ * writes the tail, so neither side ever has to disable interrupts. Bulk pushes and pops are at most two
+ * memcpy()s. `lock`/`unlock` are kept for API compatibility and do nothing.
+ *
+ * Differences to `FIFO`, as the producer must never move the head:
+ * - push/pushBytes drop the new data when it does not fit, instead of flushing the FIFO
+ * - ensure() does not drop queued packets to make room, it only reports whether the data fits
+ * - flush() is a consumer operation
+ *
+ * Producer side: push, pushBytes, atomicPushBytes, pushSize, available, ensure, free
+ * Consumer side: pop, popBytes, popSize, peek, peekSize, span, operator[], set, skip, flush
+ *
+ * @tparam FIFO_SIZE size of the FIFO in bytes, a power of two
+ */
+template <uint32_t FIFO_SIZE>
+class LockFreeFIFO
+{
+    static_assert(FIFO_SIZE > 0 && (FIFO_SIZE & (FIFO_SIZE - 1)) == 0, "LockFreeFIFO size must be a power of two");
+    static constexpr uint32_t MASK = FIFO_SIZE - 1;
+
+private:
+    uint8_t buffer[FIFO_SIZE] = {0};
+    std::atomic<uint32_t> head{0}; // next byte to pop, written by the consumer only
+    std::atomic<uint32_t> tail{0}; // next byte to push, written by the producer only
+
+    // copy in/out of the ring, wrapping at most once
+    ICACHE_RAM_ATTR void inline copyIn(uint32_t pos, const uint8_t *data, uint32_t len)
+    {
+        const uint32_t idx = pos & MASK;
+        const uint32_t first = std::min(len, FIFO_SIZE - idx);
+        memcpy(&buffer[idx], data, first);
+        if (first < len)
+        {
+            memcpy(buffer, data + first, len - first);
+        }
+    }
+
+    ICACHE_RAM_ATTR void inline copyOut(uint32_t pos, uint8_t *data, uint32_t len) const
+    {
+        const uint32_t idx = pos & MASK;
+        const uint32_t first = std::min(len, FIFO_SIZE - idx);
+        memcpy(data, &buffer[idx], first);
+        if (first < len)
+        {
+            memcpy(data + first, buffer, len - first);
+        }
+    }
+
+public:
+    /**
+     * @brief No-op, the FIFO needs no locking as long as there is a single producer and a single consumer
+     */
+    ICACHE_RAM_ATTR void inline lock() {}
+
+    /**
+     * @brief No-op, see lock()
+     */
+    ICACHE_RAM_ATTR void inline unlock() {}
+
+    /**
+     * @brief Push a single byte to the FIFO, the byte is dropped if the FIFO is full
+     *
+     * @param data
+     */
+    ICACHE_RAM_ATTR void inline push(const uint8_t data)
+    {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == FIFO_SIZE)
+        {
+            return;
+        }
+        buffer[t & MASK] = data;
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Push all bytes to FIFO, if all the bytes will not fit then no bytes are pushed
+     *
+     * @param data pointer to the bytes to be pushed onto the FIFO
+     * @param len number of bytes in `data` to push
+     */
+    ICACHE_RAM_ATTR void inline pushBytes(const uint8_t *data, uint16_t len)
+    {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) + len > FIFO_SIZE)
+        {
+            return;
+        }
+        copyIn(t, data, len);
+        tail.store(t + len, std::memory_order_release);
+    }
+
+    /**
+     * @brief Same as pushBytes(), which already publishes all bytes at once
+     */
+    ICACHE_RAM_ATTR void inline atomicPushBytes(const uint8_t *data, uint16_t len)
+    {
+        pushBytes(data, len);
+    }
+
+    /**
+     * @brief Pop a single byte (returns 0 if no bytes left)
+     * @return the byte on the head of FIFO
+     */
+    ICACHE_RAM_ATTR uint8_t inline pop()
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h)
+        {
+            return 0;
+        }
+        uint8_t data = buffer[h & MASK];
+        head.store(h + 1, std::memory_order_release);
+        return data;
+    }
+
+    /**
+     * @brief Pops `len` bytes into the buffer pointed to by `data`.
+     * If there are not enough bytes in the FIFO then the FIFO is flushed and the bytes are not read
+     *
+     * @param data pointer to a buffer where the bytes are popped into
+     * @param len number of bytes to pop from the FIFO
+     */
+    ICACHE_RAM_ATTR void inline popBytes(uint8_t *data, uint16_t len)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) - h < len)
+        {
+            flush();
+            return;
+        }
+        copyOut(h, data, len);
+        head.store(h + len, std::memory_order_release);
+    }
+
+    /**
+     * @brief The bytes from `index` on that are contiguous in the ring, to work on them in place.
+     * Calling it again with `index` advanced by the returned length gives the part after the wrap.
+     *
+     * @param index The zero-based index relative to the head
+     * @param data set to the byte at `index`
+     * @return the number of contiguous bytes, at most the bytes in the FIFO after `index`
+     */
+    ICACHE_RAM_ATTR uint16_t inline span(uint16_t index, const uint8_t **data) const
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        const uint32_t used = tail.load(std::memory_order_acquire) - h;
+        const uint32_t idx = (h + index) & MASK;
+        *data = &buffer[idx];
+        return index < used ? std::min(used - index, FIFO_SIZE - idx) : 0;
+    }
+
+    /**
+     * @brief return the first byte in the FIFO without removing it from the FIFO
+     *
+     * @return uint8_t the fist byte in the FIFO
+     */
+    ICACHE_RAM_ATTR uint8_t inline peek()
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h)
+        {
+            return 0;
+        }
+        return buffer[h & MASK];
+    }
+
+    /**
+     * @brief return the number of bytes in the FIFO
+     * Exact for the consumer, a lower bound of the free space for the producer
+     *
+     * @return number of bytes in the FIFO
+     */
+    ICACHE_RAM_ATTR uint16_t inline size()
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief return the number of bytes free in the FIFO
+     *
+     * @return number of bytes free in the FIFO
+     */
+    ICACHE_RAM_ATTR uint16_t inline free()
+    {
+        return FIFO_SIZE - size();
+    }
+
+    /**
+     * @brief push a 16-bit size prefix onto the FIFO
+     *
+     * @param size the size prefix to be pushed to the FIFO
+     */
+    ICACHE_RAM_ATTR void inline pushSize(uint16_t size)
+    {
+        const uint8_t bytes[2] = {(uint8_t)(size & 0xFF), (uint8_t)((size >> 8) & 0xFF)};
+        pushBytes(bytes, sizeof(bytes));
+    }
+
+    /**
+     * @brief return the size prefix from the head of the FIFO, without removing it from the FIFO
+     *
+     * @param size the size prefix from the head of the FIFO
+     */
+    ICACHE_RAM_ATTR uint16_t inline peekSize()
+    {
+        if (size() > 1)
+        {
+            return (uint16_t)(*this)[0] + ((uint16_t)(*this)[1] << 8);
+        }
+        return 0;
+    }
+
+    /**
+     * @brief return the size prefix from the head of the FIFO, also removing it from the FIFO
+     *
+     * @param size the size prefix from the head of the FIFO
+     */
+    ICACHE_RAM_ATTR uint16_t inline popSize()
+    {
+        if (size() > 1)
+        {
+            uint8_t bytes[2];
+            popBytes(bytes, sizeof(bytes));
+            return (uint16_t)bytes[0] + ((uint16_t)bytes[1] << 8);
+        }
+        return 0;
+    }
+
+    /**
+     * @brief reset the FIFO back to empty, consumer side
+     */
+    ICACHE_RAM_ATTR void inline flush()
+    {
+        head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /**
+     * @brief Check to see if the FIFO can accept the number of bytes in the parameter
+     *
+     * @return true if the FIFO can accept the number of bytes requested
+     */
+    ICACHE_RAM_ATTR bool inline available(uint16_t requiredSize)
+    {
+        return (size() + requiredSize) < FIFO_SIZE;
+    }
+
+    /**
+     * @brief Check that there is enough room in the FIFO for the requestedSize in bytes.
+     * Unlike `FIFO::ensure()` no queued packets are dropped, the producer cannot move the head.
+     *
+     * @param requiredSize the number of bytes required to be available
+     * @return true if the required amount of bytes will fit in the FIFO
+     */
+    ICACHE_RAM_ATTR bool inline ensure(uint16_t requiredSize)
+    {
+        return requiredSize <= FIFO_SIZE && available(requiredSize);
+    }
+
+    /**
+     * @brief Access an element in the FIFO at the specified index without removing it.
+     * The index is calculated relative to the current `head` position.
+     *
+     * @param index The zero-based index of the element to access within the FIFO.
+     * @return The value of the element at the specified index in the FIFO.
+     */
+    ICACHE_RAM_ATTR uint8_t operator [](const uint16_t index) const
+    {
+        return buffer[(head.load(std::memory_order_relaxed) + index) & MASK];
+    }
+
+    /**
+     * @brief Sets a value at a specified index in the FIFO buffer.
+     * The index is calculated relative to the current `head` position.
+     *
+     * @param index The zero-based index of the element to access within the FIFO.
+     * @param value The value to be stored in the FIFO buffer at the specified index.
+     */
+    ICACHE_RAM_ATTR void set(const uint16_t index, const uint8_t value)
+    {
+        buffer[(head.load(std::memory_order_relaxed) + index) & MASK] = value;
+    }
+
+    /**
+     * @brief Skip a specified number of elements in the FIFO, adjusting the head index.
+     *
+     * @param len The number of elements to skip. The actual number skipped will not exceed
+     * the current number of elements in the FIFO.
+     */
+    ICACHE_RAM_ATTR void skip(const uint16_t len)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        const uint32_t n = std::min((uint32_t)len, tail.load(std::memory_order_acquire) - h);
+        head.store(h + n, std::memory_order_release);
+    }
+};
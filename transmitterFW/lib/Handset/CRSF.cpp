@@ -22,7 +22,10 @@
 #include "CRSF.h"
 #include "common.h"
 
-GENERIC_CRC8 crsf_crc(CRSF_CRC_POLY);
+// Tables generated by the compiler, kept in DRAM as the frame parser is in IRAM
+DRAM_ATTR constexpr GENERIC_CRC8 crsf_crc(CRSF_CRC_POLY);
+
+crsfLinkStatistics_t CRSF::LinkStatistics = {0};
 
 /***
  * @brief: Convert `version` (string) to a integer version representation
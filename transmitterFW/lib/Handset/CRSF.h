@@ -38,6 +38,6 @@ public:
     static uint32_t VersionStrToU32(const char *verStr);
 };
 
-extern GENERIC_CRC8 crsf_crc;
+extern const GENERIC_CRC8 crsf_crc;
 
 #endif
\ No newline at end of file
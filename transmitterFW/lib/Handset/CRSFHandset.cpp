@@ -21,50 +21,150 @@
 
 #include "CRSF.h"
 #include "CRSFHandset.h"
-#include "FIFO.h"
+#include "CRSFParameters.h"
+#include "LatestFrame.h"
+#include "LockFreeFIFO.h"
+#include <atomic>
+#include "crsf_bitpack.h"
 
 #include <hal/uart_ll.h>
 #include <soc/soc.h>
 #include <soc/uart_reg.h>
-#include <esp32/rom/gpio.h>
-
-#if (GPIO_PIN_RCSIGNAL_RX_IN == 16) && (GPIO_PIN_RCSIGNAL_TX_OUT == 17)
-HardwareSerial CRSFHandset::Port(1);
+#include <soc/gpio_reg.h>
+#include <soc/gpio_sig_map.h>
+#include <soc/gpio_periph.h>
+#include <soc/io_mux_reg.h>
+
+#if CRSF_UART_NUM == 1
+#define CRSF_UART_RXD_IN_IDX U1RXD_IN_IDX
+#define CRSF_UART_TXD_OUT_IDX U1TXD_OUT_IDX
 #else
-HardwareSerial CRSFHandset::Port(0);
+#define CRSF_UART_RXD_IN_IDX U0RXD_IN_IDX
+#define CRSF_UART_TXD_OUT_IDX U0TXD_OUT_IDX
 #endif
+HardwareSerial CRSFHandset::Port(CRSF_UART_NUM);
 
 RTC_DATA_ATTR int rtcModelId = 0;
 
 static constexpr int HANDSET_TELEMETRY_FIFO_SIZE = 128; // this is the smallest telemetry FIFO size in EdgeTX with CRSF defined
 
-/// Out FIFO to buffer messages ///
+/// Out FIFOs to buffer messages, one per crsfTelemetryClass_e ///
+// Drained by handleOutput() in the handset context (loop(), or the RX task). Every class has a single producer,
+// so they need no locking: the mixer sync, the device information and the parameter entries are queued by the
+// handset context, the link statistics and the other telemetry by loop() (sendTelemetryToTX()).
+// The mixer sync and the link statistics are outdated by the next one, they have a single slot instead: a new
+// frame replaces the one still waiting, which is then counted as dropped.
 static constexpr auto CRSF_SERIAL_OUT_FIFO_SIZE = 256U;
-static FIFO<CRSF_SERIAL_OUT_FIFO_SIZE> SerialOutFIFO;
+static LockFreeFIFO<CRSF_SERIAL_OUT_FIFO_SIZE> SerialOutFIFO[telemetryClassCount];
+static constexpr uint8_t latestClassCount = 2;
+static_assert(telemetryTiming < latestClassCount && telemetryLinkStats < latestClassCount, "the latest-only classes come first");
+static LatestFrame<CRSF_MAX_PACKET_LEN> LatestOut[latestClassCount];
+static uint8_t latestFrame[latestClassCount][CRSF_MAX_PACKET_LEN]; // taken from LatestOut, waiting for the budget
+static uint8_t latestLen[latestClassCount];
+
+// crsfTelemetryStats_t, counted by the producer and the consumer of the class and read from any context
+typedef struct
+{
+    std::atomic<uint32_t> queued;
+    std::atomic<uint32_t> sent;
+    std::atomic<uint32_t> deferred;
+    std::atomic<uint32_t> dropped;
+} telemetryCounters_t;
+static telemetryCounters_t telemetryStats[telemetryClassCount];
+
+/**
+ * Queue a length-prefixed frame, in up to three parts, for the handset. A frame that does not fit is dropped,
+ * the ones queued before it are kept, except in the latest-only classes where it replaces the waiting one.
+ * The frame is pushed in one go, the consumer never sees a part of it.
+ */
+static void queueTelemetry(crsfTelemetryClass_e cls, const uint8_t *head, uint8_t headLen,
+                           const uint8_t *data, uint8_t dataLen, const uint8_t *tail, uint8_t tailLen)
+{
+    auto &fifo = SerialOutFIFO[cls];
+    const uint8_t len = headLen + dataLen + tailLen;
+    if (len > CRSF_MAX_PACKET_LEN || (cls >= latestClassCount && !fifo.available(1 + len)))
+    {
+        telemetryStats[cls].dropped++;
+        return;
+    }
+
+    uint8_t frame[1 + CRSF_MAX_PACKET_LEN];
+    frame[0] = len;
+    memcpy(&frame[1], head, headLen);
+    if (dataLen) memcpy(&frame[1 + headLen], data, dataLen);
+    if (tailLen) memcpy(&frame[1 + headLen + dataLen], tail, tailLen);
+    if (cls < latestClassCount)
+        LatestOut[cls].publish(&frame[1], len);
+    else
+        fifo.atomicPushBytes(frame, 1 + len);
+    telemetryStats[cls].queued++;
+}
+
+/**
+ * Length of the next frame of the class for the handset, 0 if there is none. Consumer side, as popTelemetry().
+ */
+static uint8_t peekTelemetry(uint8_t cls)
+{
+    if (cls < latestClassCount)
+    {
+        uint32_t replaced = 0;
+        const uint8_t waiting = latestLen[cls];
+        const uint8_t len = LatestOut[cls].take(latestFrame[cls], &replaced);
+        if (len)
+        {
+            replaced += waiting ? 1 : 0; // outdated by the new one
+            latestLen[cls] = len;
+        }
+        if (replaced) telemetryStats[cls].dropped += replaced;
+        return latestLen[cls];
+    }
+    return SerialOutFIFO[cls].size() > 0 ? SerialOutFIFO[cls].peek() : 0;
+}
+
+/**
+ * Move the next frame of the class, of the length peekTelemetry() returned, to `buffer`
+ */
+static void popTelemetry(uint8_t cls, uint8_t *buffer, uint8_t len)
+{
+    if (cls < latestClassCount)
+    {
+        memcpy(buffer, latestFrame[cls], len);
+        latestLen[cls] = 0;
+        return;
+    }
+    SerialOutFIFO[cls].pop(); // the length
+    SerialOutFIFO[cls].popBytes(buffer, len);
+}
+
+/// In FIFO, holds the received bytes until they form a complete frame, filled and drained by handleInput() ///
+static constexpr auto CRSF_SERIAL_IN_FIFO_SIZE = 4 * CRSF_MAX_PACKET_LEN;
+static LockFreeFIFO<CRSF_SERIAL_IN_FIFO_SIZE> SerialInFIFO;
 
 uint8_t CRSFHandset::modelId = 0; // Initialize the model ID as received from the handset to first model
 bool CRSFHandset::halfDuplex = false;
 
 /// EdgeTX mixer sync ///
 static const int32_t EdgeTXsyncPacketInterval = 200; // in ms
-static const int32_t EdgeTXsyncOffsetSafeMargin = 1000; // 100us
 
 /// UART Handling ///
-static const int32_t TxToHandsetBauds[] = {400000, 115200, 5250000, 3750000, 1870000, 921600, 2250000};
 uint32_t CRSFHandset::UARTrequestedBaud = 5250000;
 
 // for the UART wdt, every 1000ms we change bauds when connect is lost
 static const int UARTwdtInterval = 1000;
 
+// added to the line time of a half duplex telemetry burst before its TX-done interrupt is given up on
+static const uint32_t halfDuplexTxDoneMarginMS = 2;
+
 void CRSFHandset::Begin()
 {
-    UARTwdtLastChecked = millis() + UARTwdtInterval; // allows a delay before the first time the UARTwdt() function is called
+    startAutobaud(); // the handset is searched for from the start, at the current baud rate and by measurement
 	
     #if not defined(GPIO_PIN_RCSIGNAL_RX_IN) || not defined(GPIO_PIN_RCSIGNAL_TX_OUT)
         #error "GPIO_PIN_RCSIGNAL_RX_IN and GPIO_PIN_RCSIGNAL_TX_OUT must be defined for the RF module to be able to talk to the handset"
     #endif
     halfDuplex = (GPIO_PIN_RCSIGNAL_TX_OUT == GPIO_PIN_RCSIGNAL_RX_IN);
 
+    CRSFHandset::Port.setRxBufferSize(CRSF_RX_BUFFER_SIZE); // only takes effect before begin()
     portDISABLE_INTERRUPTS();
     UARTinverted = halfDuplex; // on a half duplex UART, go with inverted
     CRSFHandset::Port.begin(UARTrequestedBaud, SERIAL_8N1,
@@ -72,14 +172,20 @@ void CRSFHandset::Begin()
                      false, 0);
     // Arduino defaults every ESP32 stream to a 1000ms timeout, need to explicitly override this
     CRSFHandset::Port.setTimeout(0);
+    CRSFHandset::Port.setRxFIFOFull(CRSF_RX_FIFO_FULL);
+    CRSFHandset::Port.setRxTimeout(CRSF_RX_TIMEOUT_SYMBOLS);
     if (halfDuplex)
     {
+        duplex_prepare();
         duplex_set_RX();
     }
     portENABLE_INTERRUPTS();
+    // Starts the UART event task of the Arduino core, which reports the errors
+    CRSFHandset::Port.onReceiveError([this](hardwareSerial_error_t error) { countUARTerror(error); });
     flush_port_input();
     if (esp_reset_reason() != ESP_RST_POWERON)
     {
+        if (ModelSelect) ModelSelect(rtcModelId);
         modelId = rtcModelId;
         if (RecvModelUpdate) RecvModelUpdate();
     }    
@@ -94,6 +200,12 @@ void CRSFHandset::flush_port_input()
     }
 }
 
+void CRSFHandset::flush_input()
+{
+    flush_port_input();
+    SerialInFIFO.flush();
+}
+
 void CRSFHandset::makeLinkStatisticsPacket(uint8_t *buffer)
 {
     constexpr uint8_t payloadLen = sizeof(crsfLinkStatistics_t);
@@ -106,13 +218,12 @@ void CRSFHandset::makeLinkStatisticsPacket(uint8_t *buffer)
 }
 
 /**
- * Build a an extended type packet and queue it in the SerialOutFIFO
+ * Build a an extended type packet and queue it in the SerialOutFIFO of its class
  * This is just a regular packet with 2 extra bytes with the sub src and target
  **/
 void CRSFHandset::packetQueueExtended(uint8_t type, void *data, uint8_t len)
 {
-    uint8_t buf[6] = {
-        (uint8_t)(len + 6),
+    uint8_t buf[5] = {
         CRSF_ADDRESS_RADIO_TRANSMITTER,
         (uint8_t)(len + 4),
         type,
@@ -121,17 +232,13 @@ void CRSFHandset::packetQueueExtended(uint8_t type, void *data, uint8_t len)
     };
 
     // CRC - Starts at type, ends before CRC
-    uint8_t crc = crsf_crc.calc(&buf[3], sizeof(buf)-3);
+    uint8_t crc = crsf_crc.calc(&buf[2], sizeof(buf)-2);
     crc = crsf_crc.calc((byte *)data, len, crc);
 
-    SerialOutFIFO.lock();
-    if (SerialOutFIFO.ensure(buf[0] + 1))
-    {
-        SerialOutFIFO.pushBytes(buf, sizeof(buf));
-        SerialOutFIFO.pushBytes((byte *)data, len);
-        SerialOutFIFO.push(crc);
-    }
-    SerialOutFIFO.unlock();
+    const crsfTelemetryClass_e cls = type == CRSF_FRAMETYPE_HANDSET ? telemetryTiming
+                                   : type == CRSF_FRAMETYPE_DEVICE_INFO || type == CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY ? telemetryDeviceInfo
+                                   : telemetryForwarded;
+    queueTelemetry(cls, buf, sizeof(buf), (byte *)data, len, &crc, 1);
 }
 
 void CRSFHandset::sendTelemetryToTX(uint8_t *data)
@@ -146,36 +253,19 @@ void CRSFHandset::sendTelemetryToTX(uint8_t *data)
         }
 
         data[0] = CRSF_ADDRESS_RADIO_TRANSMITTER;
-        SerialOutFIFO.lock();
-        if (SerialOutFIFO.ensure(size + 1))
-        {
-            SerialOutFIFO.push(size); // length
-            SerialOutFIFO.pushBytes(data, size);
-        }
-        SerialOutFIFO.unlock();
+        const crsfTelemetryClass_e cls = data[CRSF_TELEMETRY_TYPE_INDEX] == CRSF_FRAMETYPE_LINK_STATISTICS ? telemetryLinkStats : telemetryForwarded;
+        queueTelemetry(cls, data, size, nullptr, 0, nullptr, 0);
     }
 }
 
 void ICACHE_RAM_ATTR CRSFHandset::JustSentRFpacket()
 {
-    // read them in this order to prevent a potential race condition
-    uint32_t last = dataLastRecv;
-    uint32_t m = micros();
-    auto delta = (int32_t)(m - last);
+    if (sendOnArrival)
+        return; // the RF packets follow the RC frames, there is no phase to measure
 
-    if (delta >= (int32_t)RequestedRCpacketIntervalUS)
-    {
-        // missing/late packet, force resync
-        EdgeTXsyncOffset = -(delta % RequestedRCpacketIntervalUS) * 10;
-        EdgeTXsyncWindow = 0;
-        EdgeTXsyncLastSent -= EdgeTXsyncPacketInterval;
-    }
-    else
-    {
-        // The number of packets in the sync window is how many will fit in 20ms.
-        EdgeTXsyncWindow = std::min(EdgeTXsyncWindow + 1, (int32_t)EdgeTXsyncWindowSize);
-        EdgeTXsyncOffset = ((EdgeTXsyncOffset * (EdgeTXsyncWindow-1)) + delta * 10) / EdgeTXsyncWindow;
-    }
+    // read them in this order to prevent a potential race condition
+    uint32_t last = RCdataLastRecv;
+    mixerSync.rfPacketSent(micros(), last);
 }
 
 void CRSFHandset::sendSyncPacketToTX() // in values in us.
@@ -184,7 +274,9 @@ void CRSFHandset::sendSyncPacketToTX() // in values in us.
     if (controllerConnected && (now - EdgeTXsyncLastSent) >= EdgeTXsyncPacketInterval)
     {
         int32_t packetRate = RequestedRCpacketIntervalUS * 10; //convert from us to right format
-        int32_t offset = EdgeTXsyncOffset - EdgeTXsyncOffsetSafeMargin; // offset so that opentx always has some headroom
+        int32_t offset = 0; // with sendOnArrival only announce the rate, any phase is right
+        if (!sendOnArrival)
+            mixerSync.update(&offset);
 
         struct etxSyncData {
             uint8_t subType; // CRSF_HANDSET_SUBCMD_TIMING
@@ -207,31 +299,15 @@ void CRSFHandset::sendSyncPacketToTX() // in values in us.
 
 void CRSFHandset::RcPacketToChannelsData() // data is packed as 11 bits per channel
 {
-    auto payload = (uint8_t const * const)&inBuffer.asRCPacket_t.channels;
-    constexpr unsigned srcBits = 11;
-    constexpr unsigned dstBits = 11;
-    constexpr unsigned inputChannelMask = (1 << srcBits) - 1;
-    constexpr unsigned precisionShift = dstBits - srcBits;
-
-    // code from BetaFlight rx/crsf.cpp / bitpacker_unpack
-    uint8_t bitsMerged = 0;
-    uint32_t readValue = 0;
-    unsigned readByteIndex = 0;
-    for (volatile uint16_t & n : ChannelData)
-    {
-        while (bitsMerged < srcBits)
-        {
-            uint8_t readByte = payload[readByteIndex++];
-            readValue |= ((uint32_t) readByte) << bitsMerged;
-            bitsMerged += 8;
-        }
-        //printf("rv=%x(%x) bm=%u\n", readValue, (readValue & inputChannelMask), bitsMerged);
-        n = (uint16_t)((readValue & inputChannelMask) << precisionShift);
-        readValue >>= srcBits;
-        bitsMerged -= srcBits;
-    }
-
-    // Call the registered RCdataCallback, if there is one, so it can modify the channel data if it needs to.
+    // The channels follow the frame header, the word aligned inBuffer is read as whole 32-bit words
+    constexpr unsigned channelBits = 11;
+    constexpr unsigned firstBit = offsetof(rcPacket_t, channels) * 8;
+    static_assert(crsfUnpackWords(channelBits, CRSF_NUM_CHANNELS, firstBit) <= sizeof(inBuffer.asUint32_t) / sizeof(uint32_t),
+                  "RC channel unpacking reads past inBuffer");
+    crsfUnpackChannels<channelBits, CRSF_NUM_CHANNELS, firstBit>(inBuffer.asUint32_t, ChannelData);
+    channelSnapshot.publish(ChannelData);
+
+    // Call the registered RCdataCallback, if there is one, the new channels are already published to the sender.
     if (RCdataCallback) RCdataCallback();
 }
 
@@ -260,10 +336,33 @@ bool CRSFHandset::processInternalCrsfPackage(uint8_t *package)
     {
         if (packetType == CRSF_FRAMETYPE_COMMAND && header->payload[0] == CRSF_COMMAND_SUBCMD_RX && header->payload[1] == CRSF_COMMAND_MODEL_SELECT_ID)
         {
+            if (ModelSelect) ModelSelect(header->payload[2]);
             modelId = header->payload[2];
             rtcModelId = modelId;
             if (RecvModelUpdate) RecvModelUpdate();
         }
+        else if (packetType == CRSF_FRAMETYPE_PARAMETER_READ && header->dest_addr == CRSF_ADDRESS_CRSF_TRANSMITTER &&
+                 header->frame_size >= CRSF_EXT_FRAME_SIZE(2))
+        {
+            // Reply with one chunk of the field's entry, sized to go out in one telemetry window
+            const int chunkSize = (int)maxPacketBytes - CRSF_PARAMETER_CHUNK_OVERHEAD;
+            uint8_t entry[CRSF_MAX_PACKET_LEN];
+            const uint8_t len = chunkSize > 0 ? CRSFParameters::readChunk(header->payload[0], header->payload[1], chunkSize, entry) : 0;
+            if (len) packetQueueExtended(CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, entry, len);
+        }
+        else if (packetType == CRSF_FRAMETYPE_PARAMETER_WRITE && header->dest_addr == CRSF_ADDRESS_CRSF_TRANSMITTER &&
+                 header->frame_size >= CRSF_EXT_FRAME_SIZE(2))
+        {
+            // the radio reads the field back to show the value that took effect, a command's state is sent back right away
+            CRSFParameters::write(header->payload[0], &header->payload[1], header->frame_size - CRSF_EXT_FRAME_SIZE(1));
+            const int chunkSize = (int)maxPacketBytes - CRSF_PARAMETER_CHUNK_OVERHEAD;
+            if (CRSFParameters::isCommand(header->payload[0]) && chunkSize > 0)
+            {
+                uint8_t entry[CRSF_MAX_PACKET_LEN];
+                const uint8_t len = CRSFParameters::readChunk(header->payload[0], 0, chunkSize, entry);
+                if (len) packetQueueExtended(CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, entry, len);
+            }
+        }
         return true;
     }
     return false;
@@ -273,8 +372,6 @@ bool CRSFHandset::ProcessPacket()
 {
     bool packetReceived = false;
 
-    CRSFHandset::dataLastRecv = micros();
-
     if (!controllerConnected)
     {
         // CRSF UART Connected
@@ -288,8 +385,27 @@ bool CRSFHandset::ProcessPacket()
     if (packetType == CRSF_FRAMETYPE_RC_CHANNELS_PACKED)
     {
         RCdataLastRecv = micros();
+#if defined(CRSF_RX_TASK)
+        RCdataArrival = rxEventUS;
+#else
+        RCdataArrival = inputReadUS;
+#endif
+        inputLatency.add(RCdataLastRecv - RCdataArrival);
+        // Arrival jitter, frames after a gap of several intervals (reconnect, EdgeTX busy) do not count
+        const int32_t spacing = RCdataArrival - previousArrival;
+        if (previousArrival && spacing < 4 * RequestedRCpacketIntervalUS)
+            rxJitter.add(abs(spacing - RequestedRCpacketIntervalUS));
+        previousArrival = RCdataArrival;
         RcPacketToChannelsData();
         packetReceived = true;
+
+#if defined(CRSF_RX_TASK)
+        uint32_t latency = micros() - rxEventUS;
+        rxFrames++;
+        rxLatencySumUS += latency;
+        rxLatencyMinUS = std::min(rxLatencyMinUS, latency);
+        rxLatencyMaxUS = std::max(rxLatencyMaxUS, latency);
+#endif
     }
     // check for all extended frames that are a broadcast or a message to the FC
     else if (packetType >= CRSF_FRAMETYPE_DEVICE_PING &&
@@ -299,7 +415,7 @@ bool CRSFHandset::ProcessPacket()
 		{
 			// Reply with device information
 			uint8_t deviceInformation[DEVICE_INFORMATION_LENGTH];
-			CRSF::GetDeviceInformation(deviceInformation, 0);
+			CRSF::GetDeviceInformation(deviceInformation, CRSFParameters::count());
 			// does append header + crc again so subtract size from length
 			CRSFHandset::packetQueueExtended(CRSF_FRAMETYPE_DEVICE_INFO, deviceInformation + sizeof(crsf_ext_header_t), DEVICE_INFORMATION_PAYLOAD_LENGTH);
 		}
@@ -311,29 +427,79 @@ bool CRSFHandset::ProcessPacket()
 	return packetReceived;
 }
 
-void CRSFHandset::alignBufferToSync(uint8_t startIdx)
+void CRSFHandset::processInputFIFO()
 {
+    // Dispatch every complete frame in the input ring. Frames are validated in place, over the one or two
+    // contiguous spans of the ring, and only those that pass are copied out to the inBuffer the packet handlers
+    // work on.
     uint8_t *SerialInBuffer = inBuffer.asUint8_t;
 
-    for (unsigned int i=startIdx ; i<SerialInPacketPtr ; i++)
+    while (!transmitting)
     {
-        // If we find a header byte then move that and trailing bytes to the head of the buffer and let's go!
-        if (SerialInBuffer[i] == CRSF_ADDRESS_CRSF_TRANSMITTER || SerialInBuffer[i] == CRSF_SYNC_BYTE)
+        // Discard bytes until we start with a header byte
+        while (SerialInFIFO.size() > 0 && SerialInFIFO[0] != CRSF_ADDRESS_CRSF_TRANSMITTER && SerialInFIFO[0] != CRSF_SYNC_BYTE)
+        {
+            SerialInFIFO.skip(1);
+        }
+
+        // Make sure we have at least a packet header and a length byte
+        if (SerialInFIFO.size() < 2)
+            return;
+
+        // Sanity check: A total packet must be at least [sync][len][type][crc] (if no payload) and at most CRSF_MAX_PACKET_LEN
+        const uint32_t totalLen = SerialInFIFO[1] + 2;
+        if (totalLen < 4 || totalLen > CRSF_MAX_PACKET_LEN)
         {
-            SerialInPacketPtr -= i;
-            memmove(SerialInBuffer, &SerialInBuffer[i], SerialInPacketPtr);
+            // Start looking for another packet after this start byte
+            SerialInFIFO.skip(1);
+            continue;
+        }
+
+        // Only proceed once there are enough bytes in the buffer for the entire packet
+        if (SerialInFIFO.size() < totalLen)
             return;
+
+        // CRC from the type to the byte before the CRC
+        const uint8_t *span;
+        uint16_t spanLen = SerialInFIFO.span(2, &span);
+        spanLen = std::min(spanLen, (uint16_t)(totalLen - 3));
+        uint8_t CalculatedCRC = crsf_crc.calc(span, spanLen);
+        if (spanLen < totalLen - 3)
+        {
+            const uint16_t rest = totalLen - 3 - spanLen;
+            SerialInFIFO.span(2 + spanLen, &span); // the part after the wrap
+            CalculatedCRC = crsf_crc.calc(span, rest, CalculatedCRC);
+        }
+        if (CalculatedCRC != SerialInFIFO[totalLen - 1])
+        {
+            // UART CRC failure, resynchronise on the next header byte
+            BadPktsCount++;
+            SerialInFIFO.skip(1);
+            continue;
         }
-    }
 
-    // If no header found then discard this entire buffer
-    SerialInPacketPtr = 0;
+        SerialInFIFO.popBytes(SerialInBuffer, totalLen);
+        GoodPktsCount++;
+        goodFrameMS = millis();
+        if (!autobaudFound)
+        {
+            // First good frame of a handset search
+            uint32_t found = autobaudActive ? micros() - autobaudActivityUS : 0;
+            autobaudFound = true;
+            autobaudStats.found++;
+            autobaudStats.lastUS = found;
+            autobaudStats.minUS = autobaudStats.found > 1 ? std::min(autobaudStats.minUS, found) : found;
+            autobaudStats.maxUS = std::max(autobaudStats.maxUS, found);
+        }
+        if (ProcessPacket())
+        {
+            handleOutput(totalLen);
+        }
+    }
 }
 
 void CRSFHandset::handleInput()
 {
-    uint8_t *SerialInBuffer = inBuffer.asUint8_t;
-	
 	if (UARTwdt())
     {
         return;
@@ -341,158 +507,353 @@ void CRSFHandset::handleInput()
 	
     if (transmitting)
     {
-        // if currently transmitting in half-duplex mode then check if the TX buffers are empty.
+        // The TX-done interrupt did not end the last half-duplex burst in time, check if the TX FIFO is empty.
         // If there is still data in the transmit buffers then exit, and we'll check next go round.
-        if (!uart_ll_is_tx_idle(UART_LL_GET_HW(0)))
+        if (!uart_ll_is_tx_idle(UART_LL_GET_HW(CRSF_UART_NUM)))
         {
             return;
         }
-        // All done transmitting; go back to receive mode
-        transmitting = false;
-        duplex_set_RX();
-        flush_port_input();
+        endBurst();
     }
 
-    // Add new data, and then discard bytes until we start with header byte
-    auto toRead = std::min(CRSFHandset::Port.available(), CRSF_MAX_PACKET_LEN - SerialInPacketPtr);
-    SerialInPacketPtr += CRSFHandset::Port.readBytes(&SerialInBuffer[SerialInPacketPtr], toRead);
-    alignBufferToSync(0);
+    // Move everything the UART has into the input ring and handle all complete frames on the way,
+    // stop early only when a half-duplex reply has taken over the line
+    uint8_t chunk[CRSF_MAX_PACKET_LEN];
+    do
+    {
+        auto toRead = std::min(CRSFHandset::Port.available(), (int)std::min(SerialInFIFO.free(), (uint16_t)sizeof(chunk)));
+        if (toRead > 0)
+        {
+            inputReadUS = micros();
+            SerialInFIFO.pushBytes(chunk, CRSFHandset::Port.readBytes(chunk, toRead));
+        }
+        processInputFIFO();
+    } while (!transmitting && CRSFHandset::Port.available() > 0);
+}
 
-    // Make sure we have at least a packet header and a length byte
-    if (SerialInPacketPtr < 3)
-        return;
+#if defined(CRSF_RX_TASK)
+static TaskHandle_t rxTaskHandle = nullptr;
+static CRSFHandset *rxTaskHandset = nullptr;
 
-    // Sanity check: A total packet must be at least [sync][len][type][crc] (if no payload) and at most CRSF_MAX_PACKET_LEN
-    const uint32_t totalLen = SerialInBuffer[1] + 2;
-    if (totalLen < 4 || totalLen > CRSF_MAX_PACKET_LEN)
+void CRSFHandset::onUartReceive()
+{
+    // Runs in the UART event task of HardwareSerial, which is woken by the UART driver event queue
+    // on RX FIFO-full and RX-timeout events
+    rxTaskHandset->rxEventUS = micros();
+    xTaskNotifyGive(rxTaskHandle);
+}
+
+void CRSFHandset::rxTask(void *param)
+{
+    auto *self = (CRSFHandset *)param;
+    for (;;)
     {
-        // Start looking for another packet after this start byte
-        alignBufferToSync(1);
-        return;
+        // Also wake up without UART events, so that the UART watchdog can detect a lost handset
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CRSF_RX_TASK_IDLE_MS)) != 0)
+        {
+            self->rxWakeups++;
+        }
+        self->rxTaskLoad.start();
+        self->handleInput();
+        self->rxTaskLoad.stop();
     }
+}
 
-    // Only proceed one there are enough bytes in the buffer for the entire packet
-    if (SerialInPacketPtr < totalLen)
-        return;
+void CRSFHandset::startRxTask()
+{
+    rxTaskHandset = this;
+    xTaskCreatePinnedToCore(rxTask, "CRSFrx", 4096, this, CRSF_RX_TASK_PRIORITY, &rxTaskHandle, CRSF_RX_TASK_CORE);
+    CRSFHandset::Port.onReceive(onUartReceive, false);
+}
+
+TaskHandle_t CRSFHandset::GetRxTask() const
+{
+    return rxTaskHandle;
+}
+#endif
 
-    uint8_t CalculatedCRC = crsf_crc.calc(&SerialInBuffer[2], totalLen - 3);
-    if (CalculatedCRC == SerialInBuffer[totalLen - 1])
+void CRSFHandset::countUARTerror(hardwareSerial_error_t error)
+{
+    switch (error)
     {
-        GoodPktsCount++;
-        if (ProcessPacket())
-        {
-            handleOutput(totalLen);
-            if (RCdataCallback)
-            {
-                RCdataCallback();
-            }
-        }
+    case UART_FIFO_OVF_ERROR:
+        UARTfifoOverflows++;
+        break;
+    case UART_BUFFER_FULL_ERROR:
+        UARTbufferFull++;
+        break;
+    case UART_BREAK_ERROR:
+    case UART_FRAME_ERROR:
+    case UART_PARITY_ERROR:
+        UARTframeErrors++;
+        break;
+    default:
+        break;
     }
-    else
+}
+
+void CRSFHandset::GetUartErrorStats(crsfUartErrorStats_t *stats, bool reset)
+{
+    stats->fifoOverflows = UARTfifoOverflows;
+    stats->bufferFull = UARTbufferFull;
+    stats->frameErrors = UARTframeErrors;
+    if (reset)
     {
-        // UART CRC failure
-        BadPktsCount++;
+        UARTfifoOverflows = 0;
+        UARTbufferFull = 0;
+        UARTframeErrors = 0;
     }
+}
+
+void CRSFHandset::GetHalfDuplexStats(crsfHalfDuplexStats_t *stats, bool reset)
+{
+    stats->bursts = halfDuplexBursts;
+    stats->txDoneTimeouts = txDoneTimeouts;
+    stats->windowAvgPermille = halfDuplexBursts ? (uint32_t)(windowSumPermille / halfDuplexBursts) : 0;
+    stats->windowMaxPermille = windowMaxPermille;
+    if (reset)
+    {
+        halfDuplexBursts = 0;
+        txDoneTimeouts = 0;
+        windowSumPermille = 0;
+        windowMaxPermille = 0;
+    }
+}
+
+void CRSFHandset::GetRxTaskStats(crsfRxTaskStats_t *stats, bool reset)
+{
+    stats->wakeups = rxWakeups;
+    stats->frames = rxFrames;
+    stats->latencyMinUS = rxFrames ? rxLatencyMinUS : 0;
+    stats->latencyMaxUS = rxLatencyMaxUS;
+    stats->latencyAvgUS = rxFrames ? (uint32_t)(rxLatencySumUS / rxFrames) : 0;
+    if (reset)
+    {
+        rxWakeups = 0;
+        rxFrames = 0;
+        rxLatencyMinUS = UINT32_MAX;
+        rxLatencyMaxUS = 0;
+        rxLatencySumUS = 0;
+    }
+}
 
-    SerialInPacketPtr -= totalLen;
-    memmove(SerialInBuffer, &SerialInBuffer[totalLen], SerialInPacketPtr);
+void CRSFHandset::GetTelemetryStats(crsfTelemetryStats_t *stats, bool reset)
+{
+    for (uint8_t cls = 0; cls < telemetryClassCount; cls++)
+    {
+        telemetryCounters_t &counters = telemetryStats[cls];
+        stats[cls].queued = reset ? counters.queued.exchange(0) : counters.queued.load();
+        stats[cls].sent = reset ? counters.sent.exchange(0) : counters.sent.load();
+        stats[cls].deferred = reset ? counters.deferred.exchange(0) : counters.deferred.load();
+        stats[cls].dropped = reset ? counters.dropped.exchange(0) : counters.dropped.load();
+    }
 }
 
+void CRSFHandset::flushOutput()
+{
+    for (uint8_t cls = 0; cls < telemetryClassCount; cls++)
+    {
+        uint8_t frame[CRSF_MAX_PACKET_LEN];
+        while (const uint8_t length = peekTelemetry(cls))
+        {
+            popTelemetry(cls, frame, length);
+            telemetryStats[cls].dropped++;
+        }
+    }
+}
+
+/**
+ * Token bucket of a full duplex line: filled with maxPeriodBytes per packet interval, the line rate less some
+ * margin, up to the smallest telemetry FIFO of EdgeTX, so that the handset is never sent more than it can take.
+ * @return the bytes that can be sent now
+ */
+uint8_t CRSFHandset::refillOutputBudget()
+{
+    const uint32_t now = micros();
+    const uint64_t full = (uint64_t)HANDSET_TELEMETRY_FIFO_SIZE * RequestedRCpacketIntervalUS;
+    outputCredit = std::min(full, outputCredit + (uint64_t)(now - outputCreditUS) * maxPeriodBytes);
+    outputCreditUS = now;
+    return outputCredit / RequestedRCpacketIntervalUS;
+}
+
+/**
+ * Sends the queued frames to the handset, called after every RC frame. On a half duplex line the bytes are
+ * limited to the window until the next RC frame, on a full duplex one by refillOutputBudget(). The classes of
+ * crsfTelemetryClass_e are served in order, a frame that does not fit into what is left waits for the next call
+ * and lets those of the following classes go ahead. Only frames larger than the window are split.
+ */
 void CRSFHandset::handleOutput(int receivedBytes)
 {
     static uint8_t CRSFoutBuffer[CRSF_MAX_PACKET_LEN] = {0};
-    // both static to split up larger packages
+    // static to split up larger packages
     static uint8_t packageLengthRemaining = 0;
     static uint8_t sendingOffset = 0;
+    static uint8_t packageClass = 0;
 
     if (!controllerConnected)
     {
-        SerialOutFIFO.lock();
-        SerialOutFIFO.flush();
-        SerialOutFIFO.unlock();
+        flushOutput();
+        packageLengthRemaining = 0;
         return;
     }
 
-    if (packageLengthRemaining == 0 && SerialOutFIFO.size() == 0)
+    uint8_t window = HANDSET_TELEMETRY_FIFO_SIZE;
+    uint8_t budget;
+    if (halfDuplex)
     {
-        sendSyncPacketToTX(); // calculate mixer sync packet if needed
+        window = std::min((maxPeriodBytes - receivedBytes % maxPeriodBytes), (int)maxPacketBytes);
+        window = std::max(window, (uint8_t)10);
+        budget = window;
     }
+    else
+    {
+        budget = refillOutputBudget();
+    }
+    const uint8_t budgetStart = budget;
 
-    // if partial package remaining, or data in the output FIFO that needs to be written
-    if (packageLengthRemaining > 0 || SerialOutFIFO.size() > 0) {
-        uint8_t periodBytesRemaining = HANDSET_TELEMETRY_FIFO_SIZE;
-        if (halfDuplex)
+    auto write = [&](uint8_t length) {
+        if (halfDuplex && !transmitting)
         {
-            periodBytesRemaining = std::min((maxPeriodBytes - receivedBytes % maxPeriodBytes), (int)maxPacketBytes);
-            periodBytesRemaining = std::max(periodBytesRemaining, (uint8_t)10);
-            if (!transmitting)
-            {
-                transmitting = true;
-                duplex_set_TX();
-            }
+            transmitting = true;
+            burstFrameArrival = RCdataArrival;
+            burstBytes = 0;
+            duplex_set_TX();
         }
+        // write the packet out, if it's a large package the offset holds the starting position
+        CRSFHandset::Port.write(CRSFoutBuffer + sendingOffset, length);
+        sendingOffset += length;
+        packageLengthRemaining -= length;
+        budget -= length;
+        burstBytes += length;
+        if (packageLengthRemaining == 0)
+        {
+            telemetryStats[packageClass].sent++;
+        }
+    };
 
-        do
+    // The rest of a split package goes first, the handset reassembles the byte stream
+    if (packageLengthRemaining > 0 && budget > 0)
+    {
+        write(std::min(packageLengthRemaining, budget));
+    }
+    // The mixer sync packet is built when it can go out at once, its offset is then up to date
+    if (packageLengthRemaining == 0)
+    {
+        sendSyncPacketToTX();
+    }
+
+    for (uint8_t cls = 0; cls < telemetryClassCount && packageLengthRemaining == 0; cls++)
+    {
+        while (packageLengthRemaining == 0)
         {
-            SerialOutFIFO.lock();
-            // no package is in transit so get new data from the fifo
-            if (packageLengthRemaining == 0)
+            const uint8_t length = peekTelemetry(cls);
+            bool fits = length <= budget;
+            if (length > window && budget > 0)
+            {
+                // A package larger than the window holds the line for the windows it is split over, it is not
+                // started when the mixer sync falls due before its end
+                const uint32_t splitMS = (length - budget + window - 1) / window * RequestedRCpacketIntervalUS / 1000 + 1;
+                fits = millis() + splitMS - EdgeTXsyncLastSent < (uint32_t)EdgeTXsyncPacketInterval;
+            }
+            if (length > 0 && fits)
             {
-                packageLengthRemaining = SerialOutFIFO.pop();
-                SerialOutFIFO.popBytes(CRSFoutBuffer, packageLengthRemaining);
+                // no package is in transit so get new data from the queue
+                packageLengthRemaining = length;
+                popTelemetry(cls, CRSFoutBuffer, length);
                 sendingOffset = 0;
+                packageClass = cls;
+            }
+            else if (length > 0)
+            {
+                telemetryStats[cls].deferred++;
+            }
+            if (packageLengthRemaining == 0)
+            {
+                break;
             }
-            SerialOutFIFO.unlock();
-
             // if the package is long we need to split it, so it fits in the sending interval
-            uint8_t writeLength = std::min(packageLengthRemaining, periodBytesRemaining);
-
-            // write the packet out, if it's a large package the offset holds the starting position
-            CRSFHandset::Port.write(CRSFoutBuffer + sendingOffset, writeLength);
-            sendingOffset += writeLength;
-            packageLengthRemaining -= writeLength;
-            periodBytesRemaining -= writeLength;
-        } while(periodBytesRemaining != 0 && SerialOutFIFO.size() != 0);
+            write(std::min(packageLengthRemaining, budget));
+        }
     }
-}
 
-void CRSFHandset::duplex_set_RX() const
-{
-    ESP_ERROR_CHECK(gpio_set_direction((gpio_num_t)GPIO_PIN_RCSIGNAL_RX_IN, GPIO_MODE_INPUT));
-    if (UARTinverted)
+    if (!halfDuplex)
     {
-        gpio_matrix_in((gpio_num_t)GPIO_PIN_RCSIGNAL_RX_IN, U0RXD_IN_IDX, true);
-        gpio_pulldown_en((gpio_num_t)GPIO_PIN_RCSIGNAL_RX_IN);
-        gpio_pullup_dis((gpio_num_t)GPIO_PIN_RCSIGNAL_RX_IN);
+        outputCredit -= (uint64_t)(budgetStart - budget) * RequestedRCpacketIntervalUS;
     }
-    else
+
+    if (transmitting)
     {
-        gpio_matrix_in((gpio_num_t)GPIO_PIN_RCSIGNAL_RX_IN, U0RXD_IN_IDX, false);
-        gpio_pullup_en((gpio_num_t)GPIO_PIN_RCSIGNAL_RX_IN);
-        gpio_pulldown_dis((gpio_num_t)GPIO_PIN_RCSIGNAL_RX_IN);
+        // Sleep until the TX-done interrupt of the UART driver, the handset waits for the end of the burst
+        // anyway. Without it in time, handleInput() polls for the end instead.
+        const uint32_t timeoutMS = burstBytes * 10000 / UARTrequestedBaud + halfDuplexTxDoneMarginMS;
+        if (uart_wait_tx_done(CRSF_UART_NUM, pdMS_TO_TICKS(timeoutMS)) == ESP_OK)
+        {
+            endBurst();
+        }
+        else
+        {
+            txDoneTimeouts++;
+        }
     }
 }
 
+void CRSFHandset::endBurst()
+{
+    // All done transmitting; go back to receive mode
+    transmitting = false;
+    duplex_set_RX();
+    flush_port_input();
+
+    const uint32_t turnaroundUS = micros() - burstFrameArrival;
+    const uint32_t permille = (uint64_t)turnaroundUS * 1000 / RequestedRCpacketIntervalUS;
+    turnaround.add(turnaroundUS);
+    halfDuplexBursts++;
+    windowSumPermille += permille;
+    windowMaxPermille = std::max(windowMaxPermille, permille);
+}
+
+/**
+ * Precomputes the register writes of duplex_set_RX() and duplex_set_TX() for the pin, the UART in use and the
+ * polarity, switching the line then takes a few register writes instead of a series of GPIO driver calls.
+ * To be called again whenever UARTinverted changes.
+ */
+void CRSFHandset::duplex_prepare()
+{
+    constexpr uint32_t pin = GPIO_PIN_RCSIGNAL_RX_IN;
+    constexpr uint8_t MATRIX_DETACH_IN_LOW = 0x30;  // routes 0 to matrix slot
+    constexpr uint8_t MATRIX_DETACH_IN_HIGH = 0x38; // routes 1 to matrix slot
+
+    // The pad input stays enabled in both directions, the UART RX signal is detached from it while transmitting
+    ESP_ERROR_CHECK(gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT));
+    const uint32_t mux = REG_READ(GPIO_PIN_MUX_REG[pin]) & ~(FUN_PU | FUN_PD);
+
+    duplexRegs.muxReg = GPIO_PIN_MUX_REG[pin];
+    duplexRegs.muxRX = mux | (UARTinverted ? FUN_PD : FUN_PU); // pulled to the idle level
+    duplexRegs.muxTX = mux;                                    // floating
+    duplexRegs.inSelReg = GPIO_FUNC0_IN_SEL_CFG_REG + CRSF_UART_RXD_IN_IDX * 4;
+    duplexRegs.inSelRX = GPIO_SIG0_IN_SEL | (UARTinverted ? GPIO_FUNC0_IN_INV_SEL : 0) | pin;
+    duplexRegs.inSelTX = GPIO_SIG0_IN_SEL | (UARTinverted ? MATRIX_DETACH_IN_LOW : MATRIX_DETACH_IN_HIGH);
+    duplexRegs.outSelReg = GPIO_FUNC0_OUT_SEL_CFG_REG + pin * 4;
+    duplexRegs.outSelTX = CRSF_UART_TXD_OUT_IDX | (UARTinverted ? GPIO_FUNC0_OUT_INV_SEL : 0);
+    duplexRegs.enableSetReg = pin < 32 ? GPIO_ENABLE_W1TS_REG : GPIO_ENABLE1_W1TS_REG;
+    duplexRegs.enableClrReg = pin < 32 ? GPIO_ENABLE_W1TC_REG : GPIO_ENABLE1_W1TC_REG;
+    duplexRegs.enableMask = 1U << (pin % 32);
+}
+
+void CRSFHandset::duplex_set_RX() const
+{
+    REG_WRITE(duplexRegs.enableClrReg, duplexRegs.enableMask); // release the line
+    REG_WRITE(duplexRegs.outSelReg, SIG_GPIO_OUT_IDX);
+    REG_WRITE(duplexRegs.inSelReg, duplexRegs.inSelRX);
+    REG_WRITE(duplexRegs.muxReg, duplexRegs.muxRX);
+}
+
 void CRSFHandset::duplex_set_TX() const
 {
-    ESP_ERROR_CHECK(gpio_set_pull_mode((gpio_num_t)GPIO_PIN_RCSIGNAL_TX_OUT, GPIO_FLOATING));
-    ESP_ERROR_CHECK(gpio_set_pull_mode((gpio_num_t)GPIO_PIN_RCSIGNAL_RX_IN, GPIO_FLOATING));
-    if (UARTinverted)
-    {
-        ESP_ERROR_CHECK(gpio_set_level((gpio_num_t)GPIO_PIN_RCSIGNAL_TX_OUT, 0));
-        ESP_ERROR_CHECK(gpio_set_direction((gpio_num_t)GPIO_PIN_RCSIGNAL_TX_OUT, GPIO_MODE_OUTPUT));
-        constexpr uint8_t MATRIX_DETACH_IN_LOW = 0x30; // routes 0 to matrix slot
-        gpio_matrix_in(MATRIX_DETACH_IN_LOW, U0RXD_IN_IDX, false); // Disconnect RX from all pads
-        gpio_matrix_out((gpio_num_t)GPIO_PIN_RCSIGNAL_TX_OUT, U0TXD_OUT_IDX, true, false);
-    }
-    else
-    {
-        ESP_ERROR_CHECK(gpio_set_level((gpio_num_t)GPIO_PIN_RCSIGNAL_TX_OUT, 1));
-        ESP_ERROR_CHECK(gpio_set_direction((gpio_num_t)GPIO_PIN_RCSIGNAL_TX_OUT, GPIO_MODE_OUTPUT));
-        constexpr uint8_t MATRIX_DETACH_IN_HIGH = 0x38; // routes 1 to matrix slot
-        gpio_matrix_in(MATRIX_DETACH_IN_HIGH, U0RXD_IN_IDX, false); // Disconnect RX from all pads
-        gpio_matrix_out((gpio_num_t)GPIO_PIN_RCSIGNAL_TX_OUT, U0TXD_OUT_IDX, false, false);
-    }
+    REG_WRITE(duplexRegs.muxReg, duplexRegs.muxTX);
+    REG_WRITE(duplexRegs.inSelReg, duplexRegs.inSelTX); // Disconnect RX from all pads
+    REG_WRITE(duplexRegs.outSelReg, duplexRegs.outSelTX);
+    REG_WRITE(duplexRegs.enableSetReg, duplexRegs.enableMask); // the UART TX signal drives the line from here
 }
 
 int CRSFHandset::getMinPacketInterval() const
@@ -512,6 +873,16 @@ int CRSFHandset::getMinPacketInterval() const
     return 1;   // 1-million Hz!
 }
 
+void CRSFHandset::setPacketInterval(int32_t PacketInterval)
+{
+    RequestedRCpacketIntervalUS = PacketInterval;
+    // Lock the EdgeTX mixer anew at the new rate
+    mixerSync.begin(PacketInterval);
+    // Announce the new rate to EdgeTX with the next sync packet instead of up to EdgeTXsyncPacketInterval later
+    EdgeTXsyncLastSent -= EdgeTXsyncPacketInterval;
+    adjustMaxPacketSize();
+}
+
 void ICACHE_RAM_ATTR CRSFHandset::adjustMaxPacketSize()
 {
     const int LUA_CHUNK_QUERY_SIZE = 26;
@@ -526,34 +897,31 @@ void ICACHE_RAM_ATTR CRSFHandset::adjustMaxPacketSize()
     maxPacketBytes = std::min(maxPeriodBytes - max(maxPeriodBytes / 2, LUA_CHUNK_QUERY_SIZE), CRSF_MAX_PACKET_LEN);
 }
 
-uint32_t CRSFHandset::autobaud()
+void CRSFHandset::startAutobaud()
 {
-    static enum { INIT, MEASURED, INVERTED } state;
-
-    if (state == MEASURED) {
-        UARTinverted = !UARTinverted;
-        state = INVERTED;
-        return UARTrequestedBaud;
-    }
-    if (state == INVERTED) {
-        UARTinverted = !UARTinverted;
-        state = INIT;
-    }
+    autobaudState = AUTOBAUD_MEASURE;
+    autobaudActive = false;
+    autobaudFound = false;
+    autobaudStats.searches++;
+    REG_CLR_BIT(UART_AUTOBAUD_REG(CRSF_UART_NUM), UART_AUTOBAUD_EN); // measure anew
+    BadPktsCount = 0;
+    GoodPktsCount = 0;
+}
 
-    if (REG_GET_BIT(UART_AUTOBAUD_REG(0), UART_AUTOBAUD_EN) == 0) {
-        REG_WRITE(UART_AUTOBAUD_REG(0), 4 << UART_GLITCH_FILT_S | UART_AUTOBAUD_EN);    // enable, glitch filter 4
-        return 400000;
+int32_t CRSFHandset::measureBaud()
+{
+    if (REG_GET_BIT(UART_AUTOBAUD_REG(CRSF_UART_NUM), UART_AUTOBAUD_EN) == 0) {
+        REG_WRITE(UART_AUTOBAUD_REG(CRSF_UART_NUM), 4 << UART_GLITCH_FILT_S | UART_AUTOBAUD_EN);    // enable, glitch filter 4
+        return 0;
     }
-    if (REG_GET_BIT(UART_AUTOBAUD_REG(0), UART_AUTOBAUD_EN) && REG_READ(UART_RXD_CNT_REG(0)) < 300)
+    if (REG_READ(UART_RXD_CNT_REG(CRSF_UART_NUM)) < CRSF_AUTOBAUD_MIN_EDGES)
     {
-        return 400000;
+        return 0;
     }
 
-    state = MEASURED;
-
-    auto low_period  = (int32_t)REG_READ(UART_LOWPULSE_REG(0));
-    auto high_period = (int32_t)REG_READ(UART_HIGHPULSE_REG(0));
-    REG_CLR_BIT(UART_AUTOBAUD_REG(0), UART_AUTOBAUD_EN);   // disable autobaud
+    auto low_period  = (int32_t)REG_READ(UART_LOWPULSE_REG(CRSF_UART_NUM));
+    auto high_period = (int32_t)REG_READ(UART_HIGHPULSE_REG(CRSF_UART_NUM));
+    REG_CLR_BIT(UART_AUTOBAUD_REG(CRSF_UART_NUM), UART_AUTOBAUD_EN);   // disable autobaud, the next call measures anew
 
     // sample code at https://github.com/espressif/esp-idf/issues/3336
     // says baud rate = 80000000/min(UART_LOWPULSE_REG, UART_HIGHPULSE_REG);
@@ -567,53 +935,139 @@ uint32_t CRSFHandset::autobaud()
             bestBaud = (int32_t)TxToHandsetBaud;
         }
     }
+    // Glitches (e.g. while the handset is plugged in) measure as pulses shorter than a bit
+    if (abs(calculatedBaud - bestBaud) > bestBaud / 100 * CRSF_AUTOBAUD_TOLERANCE_PERCENT)
+    {
+        return 0;
+    }
     return bestBaud;
 }
 
+void CRSFHandset::switchBaud(uint32_t baud)
+{
+    if (baud != UARTrequestedBaud)
+    {
+        UARTrequestedBaud = baud;
+        adjustMaxPacketSize();
+
+        flushOutput();
+        CRSFHandset::Port.flush();
+        CRSFHandset::Port.updateBaudRate(UARTrequestedBaud);
+        if (halfDuplex)
+        {
+            duplex_set_RX();
+        }
+        // cleanup input buffer
+        flush_input();
+        autobaudStats.baudSwitches++;
+        GoodPktsCount = 0;
+    }
+    autobaudState = AUTOBAUD_VERIFY;
+    autobaudVerifyStart = millis();
+    BadPktsCount = 0; // garbage received at the previous baud rate
+}
+
+/**
+ * Searches for the handset while none is locked: the pulse widths on the RX line are measured continuously
+ * and the UART is switched to the nearest of TxToHandsetBauds as soon as enough edges were seen. A baud rate
+ * is locked once CRSF_AUTOBAUD_LOCK_FRAMES frames passed the CRC check, within CRSF_AUTOBAUD_VERIFY_MS.
+ * Frames are parsed throughout, a good frame at the current baud rate starts its verification right away.
+ * @return true if the input is to be skipped in this call
+ */
+bool CRSFHandset::autobaud(uint32_t now)
+{
+    if (!autobaudActive && (REG_READ(UART_RXD_CNT_REG(CRSF_UART_NUM)) > 0 || CRSFHandset::Port.available() > 0))
+    {
+        autobaudActive = true;
+        autobaudActivityUS = micros();
+    }
+
+    if (autobaudState == AUTOBAUD_MEASURE)
+    {
+        if (GoodPktsCount > 0)
+        {
+            switchBaud(UARTrequestedBaud);
+            return false;
+        }
+        int32_t baud = measureBaud();
+        if (baud != 0)
+        {
+            switchBaud(baud);
+            return true;
+        }
+        return false;
+    }
+
+    // AUTOBAUD_VERIFY
+    if (GoodPktsCount >= CRSF_AUTOBAUD_LOCK_FRAMES && GoodPktsCount > BadPktsCount)
+    {
+        autobaudState = AUTOBAUD_LOCKED;
+        UARTwdtLastChecked = now;
+        BadPktsCount = 0;
+        GoodPktsCount = 0;
+        return false;
+    }
+    if (now - autobaudVerifyStart > CRSF_AUTOBAUD_VERIFY_MS || BadPktsCount > GoodPktsCount + CRSF_AUTOBAUD_LOCK_FRAMES)
+    {
+        // Wrong baud rate, or on a half duplex line the wrong polarity: try the other one with the next measurement
+        autobaudStats.falseLocks++;
+        if (controllerConnected)
+        {
+            if (disconnected) disconnected();
+            controllerConnected = false;
+        }
+        if (halfDuplex)
+        {
+            UARTinverted = !UARTinverted;
+            duplex_prepare();
+            duplex_set_RX();
+        }
+        autobaudState = AUTOBAUD_MEASURE;
+        BadPktsCount = 0;
+        GoodPktsCount = 0;
+        return true;
+    }
+    return false;
+}
+
 bool CRSFHandset::UARTwdt()
 {
     bool retval = false;
     uint32_t now = millis();
-    if (now - UARTwdtLastChecked > UARTwdtInterval)
+    if (autobaudState != AUTOBAUD_LOCKED)
+    {
+        return autobaud(now);
+    }
+    // Bytes without good frames: the handset changed its baud rate or came back from a reboot at another one
+    const bool garbage = now - goodFrameMS > CRSF_AUTOBAUD_GARBAGE_MS && CRSFHandset::Port.available() > 0;
+    if (garbage || now - UARTwdtLastChecked > UARTwdtInterval)
     {
-        // If no packets or more bad than good packets, rate cycle/autobaud the UART but
+        // If no packets or more bad than good packets, search for the handset anew but
         // do not adjust the parameters while in wifi mode. If a firmware is being
         // uploaded, it will cause tons of serial errors during the flash writes
-        if (BadPktsCount >= GoodPktsCount || !controllerConnected)
+        if (garbage || BadPktsCount >= GoodPktsCount || !controllerConnected)
         {
             if (controllerConnected)
             {
                 if (disconnected) disconnected();
                 controllerConnected = false;
             }
-
-            UARTrequestedBaud = autobaud();
-            if (UARTrequestedBaud != 0)
-            {
-                adjustMaxPacketSize();
-
-                SerialOutFIFO.flush();
-                CRSFHandset::Port.flush();
-                CRSFHandset::Port.updateBaudRate(UARTrequestedBaud);
-                if (halfDuplex)
-                {
-                    duplex_set_RX();
-                }
-                // cleanup input buffer
-                flush_port_input();
-            }
+            startAutobaud();
             retval = true;
         }
 
         UARTwdtLastChecked = now;
-        if (retval)
-        {
-            // Speed up the cycling
-            UARTwdtLastChecked -= 3 * (UARTwdtInterval >> 2);
-        }
-
         BadPktsCount = 0;
         GoodPktsCount = 0;
     }
     return retval;
 }
+
+void CRSFHandset::GetAutobaudStats(crsfAutobaudStats_t *stats, bool reset)
+{
+    *stats = autobaudStats;
+    if (reset)
+    {
+        autobaudStats = {};
+    }
+}
@@ -24,8 +24,113 @@
 #include "crsf_protocol.h"
 #include "HardwareSerial.h"
 #include "common.h"
+#include "LatencyHistogram.h"
+#include "MixerSync.h"
+#include "TaskLoad.h"
+#include "ChannelSnapshot.h"
 #include "driver/uart.h"
 
+// Build with -D CRSF_RX_TASK to handle the handset input in a dedicated task, woken by UART RX events,
+// instead of polling it from loop().
+#if defined(CRSF_RX_TASK)
+#ifndef CRSF_RX_TASK_PRIORITY
+#define CRSF_RX_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#endif
+#ifndef CRSF_RX_TASK_CORE
+#define CRSF_RX_TASK_CORE 1 // the handset I/O stays off the core of the WiFi stack, on the one of loop()
+#endif
+#define CRSF_RX_TASK_IDLE_MS 10 // wake-up period without UART events, keeps the UART watchdog running
+#endif
+
+// The UART of the handset: UART 1 on the pins of the ESP32 DevKit, UART 0 otherwise
+#if (GPIO_PIN_RCSIGNAL_RX_IN == 16) && (GPIO_PIN_RCSIGNAL_TX_OUT == 17)
+#define CRSF_UART_NUM 1
+#else
+#define CRSF_UART_NUM 0
+#endif
+
+// UART RX buffering, see "Build options" in the README for the settings per baud rate
+#ifndef CRSF_RX_BUFFER_SIZE
+#define CRSF_RX_BUFFER_SIZE 256 // bytes of the RX ring buffer of the UART driver
+#endif
+#ifndef CRSF_RX_FIFO_FULL
+#define CRSF_RX_FIFO_FULL 64 // bytes in the UART RX FIFO (of 128) that move them to the RX buffer (and wake the RX task)
+#endif
+#ifndef CRSF_RX_TIMEOUT_SYMBOLS
+#define CRSF_RX_TIMEOUT_SYMBOLS 2 // idle line time in UART symbols that moves the RX FIFO to the RX buffer
+#endif
+
+typedef struct
+{
+    uint32_t fifoOverflows; // the UART RX FIFO overflowed before the driver emptied it, bytes lost
+    uint32_t bufferFull;    // the RX buffer was full, bytes dropped by the driver
+    uint32_t frameErrors;   // framing and parity errors, breaks (e.g. while autobauding)
+} crsfUartErrorStats_t;
+
+// Handset search (autobaud), runs on every input call while no handset is locked
+#ifndef CRSF_AUTOBAUD_MIN_EDGES
+#define CRSF_AUTOBAUD_MIN_EDGES 100 // RX edges measured before the pulse widths are used, about one RC frame
+#endif
+#ifndef CRSF_AUTOBAUD_TOLERANCE_PERCENT
+#define CRSF_AUTOBAUD_TOLERANCE_PERCENT 8 // largest distance of the measured baud rate from one of TxToHandsetBauds
+#endif
+#ifndef CRSF_AUTOBAUD_LOCK_FRAMES
+#define CRSF_AUTOBAUD_LOCK_FRAMES 3 // frames with a good CRC that confirm a baud rate
+#endif
+#ifndef CRSF_AUTOBAUD_VERIFY_MS
+#define CRSF_AUTOBAUD_VERIFY_MS 100 // time a new baud rate has to deliver them
+#endif
+#ifndef CRSF_AUTOBAUD_GARBAGE_MS
+#define CRSF_AUTOBAUD_GARBAGE_MS 50 // the handset is searched anew when bytes but no good frames arrive for this long
+#endif
+
+typedef struct
+{
+    uint32_t searches;      // times the handset was searched for: start, link lost
+    uint32_t found;         // searches that ended with a good frame
+    uint32_t lastUS;        // time from the first RX activity of a search to its first good frame
+    uint32_t minUS;
+    uint32_t maxUS;
+    uint32_t baudSwitches;  // baud rates tried
+    uint32_t falseLocks;    // baud rates that did not confirm by CRC
+} crsfAutobaudStats_t;
+
+// Classes of the frames sent to the handset, in the order they are sent in
+typedef enum
+{
+    telemetryTiming,     // EdgeTX mixer sync
+    telemetryLinkStats,  // link statistics
+    telemetryDeviceInfo, // device information and parameter menu entries
+    telemetryForwarded,  // all other telemetry
+    telemetryClassCount
+} crsfTelemetryClass_e;
+
+typedef struct
+{
+    uint32_t queued;   // frames queued for the handset
+    uint32_t sent;     // frames whose last byte was written to the UART
+    uint32_t deferred; // times the first frame of the class waited for a later window, the byte budget used up
+    uint32_t dropped;  // frames not queued as the queue was full, replaced by a newer one (timing and link statistics),
+                       // or discarded while no handset was connected
+} crsfTelemetryStats_t;
+
+typedef struct
+{
+    uint32_t bursts;            // telemetry bursts sent in the reply window of an RC frame, half duplex only
+    uint32_t txDoneTimeouts;    // bursts the TX-done interrupt did not end in time, handleInput() polled for their end
+    uint32_t windowAvgPermille; // the turnaround (see GetTurnaround()) in permille of the packet interval
+    uint32_t windowMaxPermille;
+} crsfHalfDuplexStats_t;
+
+typedef struct
+{
+    uint32_t wakeups;      // RX task wake-ups caused by a UART event
+    uint32_t frames;       // RC frames parsed after a UART event
+    uint32_t latencyMinUS; // time from the UART event to the RC frame reaching ChannelData
+    uint32_t latencyMaxUS;
+    uint32_t latencyAvgUS;
+} crsfRxTaskStats_t;
+
 class CRSFHandset final
 {
 public:
@@ -39,6 +144,13 @@ public:
      * @param callback
      */
     void setRCDataCallback(void (*callback)()) { RCdataCallback = callback; }
+    void (*getRCDataCallback() const)() { return RCdataCallback; }
+
+    /**
+     * @brief register a function to be called with the model number the handset selects, before getModelID() returns it
+     * @param callback
+     */
+    void setModelSelectCallback(void (*callback)(uint8_t modelId)) { ModelSelect = callback; }
 
     /**
      * Register callback functions for state information about the connection or handset
@@ -58,6 +170,62 @@ public:
      */
     void handleInput();
 
+#if defined(CRSF_RX_TASK)
+    /**
+     * @brief Hand the input processing over to a dedicated task, woken by UART RX FIFO-full and RX-timeout events.
+     * handleInput() must not be called from anywhere else afterwards.
+     */
+    void startRxTask();
+
+    /**
+     * @return the RX task, nullptr before startRxTask()
+     */
+    TaskHandle_t GetRxTask() const;
+#endif
+
+    /**
+     * @brief CPU load of the RX task (CRSF_RX_TASK), its busy time per wake-up
+     */
+    TaskLoad &GetRxTaskLoad() { return rxTaskLoad; }
+
+    /**
+     * @brief Read the wake-to-parse latency statistics of the RX task (all zero when polling from loop())
+     * @param reset start a new measurement window after reading
+     */
+    void GetRxTaskStats(crsfRxTaskStats_t *stats, bool reset);
+
+    /**
+     * @brief Read the UART RX error counters, bytes lost between the handset and the parser show up here
+     * @param reset start counting from zero
+     */
+    void GetUartErrorStats(crsfUartErrorStats_t *stats, bool reset);
+
+    /**
+     * @brief Read the handset search statistics, the time to the first good frame after a start or a lost link
+     * @param reset start counting from zero
+     */
+    void GetAutobaudStats(crsfAutobaudStats_t *stats, bool reset);
+
+    /**
+     * @brief Read the counters of the frames sent to the handset, per crsfTelemetryClass_e
+     * @param stats telemetryClassCount entries
+     * @param reset start counting from zero
+     */
+    void GetTelemetryStats(crsfTelemetryStats_t *stats, bool reset);
+
+    /**
+     * @brief Read the telemetry burst statistics of a half duplex line (all zero on a full duplex one)
+     * @param reset start counting from zero
+     */
+    void GetHalfDuplexStats(crsfHalfDuplexStats_t *stats, bool reset);
+
+    /**
+     * @brief Read the histogram of the half duplex turnaround RX -> TX -> RX: from the arrival of an RC frame
+     * to the line back in RX after the telemetry burst replying to it
+     * @param reset start over with the next burst
+     */
+    void GetTurnaround(latencyHistogram_t *histogram, bool reset) { turnaround.read(histogram, reset); }
+
 	void handleOutput(int receivedBytes);
 
 	static HardwareSerial Port;
@@ -66,7 +234,7 @@ public:
 	
     static void makeLinkStatisticsPacket(uint8_t *buffer);
 
-    static void packetQueueExtended(uint8_t type, void *data, uint8_t len);
+    static void packetQueueExtended(uint8_t type, void *data, uint8_t len); // from the handset context only
 	
     /**
      * @return the maximum number of bytes that the protocol can send to the handset in a single message
@@ -80,6 +248,18 @@ public:
      */
     int getMinPacketInterval() const;
 
+    /**
+     * @brief Set the RC packet interval EdgeTX is synchronised to, and the telemetry window size that follows from it.
+     * The caller checks the interval against getMinPacketInterval() and moves the hwTimer along.
+     * @param PacketInterval in microseconds
+     */
+    void setPacketInterval(int32_t PacketInterval);
+
+    /**
+     * @return the RC packet interval in microseconds
+     */
+    int32_t getPacketInterval() const { return RequestedRCpacketIntervalUS; }
+
     /**
      * @brief Called to indicate to the protocol that a packet has just been sent over-the-air
      * This is used to synchronise the packets from the handset to the OTA protocol to minimise latency
@@ -87,7 +267,18 @@ public:
     void JustSentRFpacket();
 
     /**
-     * Send a telemetry packet back to the handset
+     * @brief Tell the protocol that the RF packets are sent as the RC frames arrive instead of on a timer.
+     * The sync packets then only announce the packet rate to EdgeTX, with a zero offset.
+     */
+    void setSendOnArrival(bool enable) { sendOnArrival = enable; }
+
+    /**
+     * @brief Read the state of the EdgeTX mixer sync: phase and period error, lock
+     */
+    void GetMixerSyncStats(mixerSyncStats_t *stats) const { mixerSync.getStats(stats); }
+
+    /**
+     * Send a telemetry packet back to the handset, from loop() only: its queues have a single producer each
      * @param data
      */
 	void sendTelemetryToTX(uint8_t *data);
@@ -99,7 +290,37 @@ public:
      */
     uint32_t GetRCdataLastRecv() const { return RCdataLastRecv; }
 
+    /**
+     * @return the time in microseconds when the last RC packet arrived at the UART: the UART event that woke
+     * the RX task, or when polling from loop(), when its last bytes were read from the UART
+     */
+    uint32_t GetRCdataArrival() const { return RCdataArrival; }
+
+    /**
+     * @brief Read the histogram of the time from the arrival of an RC packet to RcPacketToChannelsData()
+     * @param reset start over with the next RC packet
+     */
+    void GetInputLatency(latencyHistogram_t *histogram, bool reset) { inputLatency.read(histogram, reset); }
+
+    /**
+     * @brief Read the histogram of how far the time between two RC packet arrivals is off the packet interval,
+     * reception stalls (e.g. interrupts masked for long) show up here
+     * @param reset start over with the next RC packet
+     */
+    void GetRxJitter(latencyHistogram_t *histogram, bool reset) { rxJitter.read(histogram, reset); }
+
+    /**
+     * @brief Copy the channels of the newest RC packet, never mixing two packets. One reader context only.
+     * @return false if a packet was being unpacked and the channels of the one before were copied
+     */
+    bool ReadChannels(uint16_t *channels) { return channelSnapshot.read(channels); }
+    uint32_t GetChannelReadRetries() const { return channelSnapshot.getRetries(); }
+    uint32_t GetChannelReadFallbacks() const { return channelSnapshot.getFallbacks(); }
+
 	static uint32_t GetCurrentBaudRate() { return UARTrequestedBaud; }
+
+    // Baud rates selectable in EdgeTX
+    static constexpr int32_t TxToHandsetBauds[] = {400000, 115200, 5250000, 3750000, 1870000, 921600, 2250000};
     static bool isHalfDuplex() { return halfDuplex; }
 	
 private:
@@ -108,41 +329,102 @@ private:
     void (*disconnected)() = nullptr;    // called when RC packet stream is lost
     void (*connected)() = nullptr;       // called when RC packet stream is regained
     void (*RecvModelUpdate)() = nullptr; // called when model id changes, ie command from Radio
+    void (*ModelSelect)(uint8_t) = nullptr; // called with the new model id before it changes
 
     volatile uint32_t RCdataLastRecv = 0;
-    int32_t RequestedRCpacketIntervalUS = RF_FRAME_RATE_US;
+    volatile uint32_t RCdataArrival = 0;
+    uint32_t inputReadUS = 0; // time of the last read from the UART
+    LatencyHistogram inputLatency;
+    uint32_t previousArrival = 0; // RCdataArrival of the RC packet before
+    LatencyHistogram rxJitter;
+    volatile int32_t RequestedRCpacketIntervalUS = RF_FRAME_RATE_US;
 
     inBuffer_U inBuffer = {};
+    ChannelSnapshot<CRSF_NUM_CHANNELS> channelSnapshot; // ChannelData as a whole, for the sender
 
     /// EdgeTX mixer sync ///
-    volatile uint32_t dataLastRecv = 0;
-    volatile int32_t EdgeTXsyncOffset = 0;
-    volatile int32_t EdgeTXsyncWindow = 0;
-    volatile int32_t EdgeTXsyncWindowSize = 1;
+    MixerSync mixerSync;
+    bool sendOnArrival = false;
     uint32_t EdgeTXsyncLastSent = 0;
 
     /// UART Handling ///
-    uint8_t SerialInPacketPtr = 0; // index where we are reading/writing
     static bool halfDuplex;
     bool transmitting = false;
+    struct
+    {
+        uint32_t muxReg;        // IO_MUX pad register of the pin: pulls
+        uint32_t muxRX;
+        uint32_t muxTX;
+        uint32_t inSelReg;      // GPIO matrix input of the UART RX signal
+        uint32_t inSelRX;
+        uint32_t inSelTX;
+        uint32_t outSelReg;     // GPIO matrix output of the pin
+        uint32_t outSelTX;
+        uint32_t enableSetReg;  // output enable of the pin
+        uint32_t enableClrReg;
+        uint32_t enableMask;
+    } duplexRegs = {};          // precomputed by duplex_prepare()
+    uint32_t burstFrameArrival = 0; // RCdataArrival of the RC frame the burst replies to
+    uint8_t burstBytes = 0;
+    uint32_t halfDuplexBursts = 0;
+    uint32_t txDoneTimeouts = 0;
+    uint64_t windowSumPermille = 0;
+    uint32_t windowMaxPermille = 0;
+    LatencyHistogram turnaround;
     uint32_t GoodPktsCount = 0;
     uint32_t BadPktsCount = 0;
+    volatile uint32_t UARTfifoOverflows = 0; // counted by the UART event task
+    volatile uint32_t UARTbufferFull = 0;
+    volatile uint32_t UARTframeErrors = 0;
     uint32_t UARTwdtLastChecked = 0;
     uint8_t maxPacketBytes = CRSF_MAX_PACKET_LEN;
     uint8_t maxPeriodBytes = CRSF_MAX_PACKET_LEN;
+    uint64_t outputCredit = 0;  // token bucket of a full duplex line in bytes * RequestedRCpacketIntervalUS
+    uint32_t outputCreditUS = 0; // last refill
 
     static uint32_t UARTrequestedBaud;
     bool UARTinverted = false;
+
+    /// Autobaud ///
+    enum { AUTOBAUD_MEASURE, AUTOBAUD_VERIFY, AUTOBAUD_LOCKED } autobaudState = AUTOBAUD_MEASURE;
+    uint32_t autobaudVerifyStart = 0; // ms, when the baud rate being verified was set
+    uint32_t goodFrameMS = 0;         // last frame with a good CRC
+    uint32_t autobaudActivityUS = 0;  // first RX activity of the search
+    bool autobaudActive = false;      // autobaudActivityUS is set
+    bool autobaudFound = false;       // the search has seen a good frame
+    crsfAutobaudStats_t autobaudStats = {};
     void sendSyncPacketToTX();
+    uint8_t refillOutputBudget();
+    void flushOutput();
     void adjustMaxPacketSize();
+    void duplex_prepare();
     void duplex_set_RX() const;
     void duplex_set_TX() const;
+    void endBurst();
     void RcPacketToChannelsData();
+    void countUARTerror(hardwareSerial_error_t error);
     bool processInternalCrsfPackage(uint8_t *package);
-    void alignBufferToSync(uint8_t startIdx);
+    void processInputFIFO();
     bool ProcessPacket();
     bool UARTwdt();
-    uint32_t autobaud();	
+    void startAutobaud();
+    bool autobaud(uint32_t now);
+    int32_t measureBaud();
+    void switchBaud(uint32_t baud);
     void flush_port_input();
+    void flush_input();
+
+    /// RX task ///
+    volatile uint32_t rxEventUS = 0; // time of the UART event that woke the RX task
+    uint32_t rxWakeups = 0;
+    uint32_t rxFrames = 0;
+    uint32_t rxLatencyMinUS = UINT32_MAX;
+    uint32_t rxLatencyMaxUS = 0;
+    uint64_t rxLatencySumUS = 0;
+    TaskLoad rxTaskLoad;
+#if defined(CRSF_RX_TASK)
+    static void rxTask(void *param);
+    static void onUartReceive();
+#endif
 };
 
@@ -0,0 +1,153 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * Large parts of the code are based on the wonderful ExpressLRS project:
+ * https://github.com/ExpressLRS/ExpressLRS
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "CRSFParameters.h"
+
+const crsfParameter_t *CRSFParameters::fields = nullptr;
+uint8_t CRSFParameters::fieldCount = 0;
+uint8_t CRSFParameters::cached[CRSF_PARAMETER_ENTRY_MAX];
+uint8_t CRSFParameters::cachedId = 0;
+uint8_t CRSFParameters::cachedLen = 0;
+
+void CRSFParameters::begin(const crsfParameter_t *table, uint8_t count)
+{
+    fields = table;
+    fieldCount = count;
+}
+
+// Copy a string with its terminating zero, cut short to fit before `end`
+static uint8_t *putString(uint8_t *pos, const uint8_t *end, const char *str)
+{
+    if (pos >= end)
+        return pos;
+    const size_t len = std::min(str ? strlen(str) : 0, (size_t)(end - pos - 1));
+    memcpy(pos, str, len);
+    pos[len] = 0;
+    return pos + len + 1;
+}
+
+// The highest index of a ';' separated selection
+static uint8_t selectionMax(const char *options)
+{
+    uint8_t max = 0;
+    for (const char *c = options; c && *c; c++)
+    {
+        if (*c == ';') max++;
+    }
+    return max;
+}
+
+/***
+ * @brief: Lay out the entry of a field as the ExpressLRS Lua script reads it:
+ * [parent folder][type][name\0] followed by
+ *   CRSF_UINT8:          [value][min][max][default][units\0]
+ *   CRSF_TEXT_SELECTION: [options\0][value][min][max][default][units\0]
+ *   CRSF_INFO:           [text\0]
+ *   CRSF_COMMAND:        [status][poll interval][text\0]
+ * @return the length of the entry
+ ***/
+uint8_t CRSFParameters::serialize(const crsfParameter_t &field, uint8_t *entry)
+{
+    const uint8_t *end = entry + CRSF_PARAMETER_ENTRY_MAX;
+    uint8_t *pos = entry;
+    *pos++ = 0; // root folder
+    *pos++ = field.type;
+    pos = putString(pos, end - 6, field.name); // room left for the values
+
+    switch (field.type)
+    {
+    case CRSF_UINT8:
+        *pos++ = field.get();
+        *pos++ = field.min;
+        *pos++ = field.max;
+        *pos++ = field.get(); // default, as for CRSF_TEXT_SELECTION
+        pos = putString(pos, end, field.units);
+        break;
+    case CRSF_TEXT_SELECTION:
+        pos = putString(pos, end - 5, field.options);
+        *pos++ = field.get();
+        *pos++ = 0;
+        *pos++ = selectionMax(field.options);
+        *pos++ = field.get(); // the current value doubles as the default, no field has another one
+        pos = putString(pos, end, field.units);
+        break;
+    case CRSF_COMMAND:
+        *pos++ = field.get();
+        *pos++ = field.min;
+        pos = putString(pos, end, field.info ? field.info() : field.options);
+        break;
+    default:
+        pos = putString(pos, end, field.info ? field.info() : field.options);
+        break;
+    }
+    return pos - entry;
+}
+
+uint8_t CRSFParameters::readChunk(uint8_t id, uint8_t chunk, uint8_t chunkSize, uint8_t *payload)
+{
+    if (id == 0 || id > fieldCount || chunkSize == 0)
+        return 0;
+
+    if (chunk == 0 || id != cachedId)
+    {
+        cachedId = id;
+        cachedLen = serialize(fields[id - 1], cached);
+    }
+    const uint8_t len = cachedLen;
+    const uint8_t chunks = (len + chunkSize - 1) / chunkSize;
+    if (chunk >= chunks)
+        return 0;
+
+    const uint8_t offset = chunk * chunkSize;
+    const uint8_t size = std::min((uint8_t)(len - offset), chunkSize);
+    payload[0] = id;
+    payload[1] = chunks - chunk - 1;
+    memcpy(&payload[2], &cached[offset], size);
+    return size + 2;
+}
+
+bool CRSFParameters::write(uint8_t id, const uint8_t *value, uint8_t len)
+{
+    if (id == 0 || id > fieldCount || len < 1)
+        return false;
+
+    const crsfParameter_t &field = fields[id - 1];
+    switch (field.type)
+    {
+    case CRSF_UINT8:
+        if (value[0] < field.min || value[0] > field.max)
+            return false;
+        break;
+    case CRSF_TEXT_SELECTION:
+        if (value[0] > selectionMax(field.options))
+            return false;
+        break;
+    case CRSF_COMMAND:
+        if (value[0] > crsfCommandQuery)
+            return false;
+        break;
+    default:
+        return false; // read only
+    }
+    return field.set && field.set(value[0]);
+}
@@ -0,0 +1,111 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * Large parts of the code are based on the wonderful ExpressLRS project:
+ * https://github.com/ExpressLRS/ExpressLRS
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "crsf_protocol.h"
+
+// Frame bytes around the data of a parameter entry chunk: header, destination and origin, field id,
+// chunks remaining and CRC. A chunk of GetMaxPacketBytes() - CRSF_PARAMETER_CHUNK_OVERHEAD data bytes
+// fills the largest frame the handset takes in one window.
+#define CRSF_PARAMETER_CHUNK_OVERHEAD (CRSF_EXT_FRAME_SIZE(2) + CRSF_FRAME_NOT_COUNTED_BYTES)
+#define CRSF_PARAMETER_ENTRY_MAX 96 // bytes of an entry before it is chunked
+
+// State of a CRSF_COMMAND field, as the ExpressLRS Lua script writes and reads it
+typedef enum : uint8_t
+{
+    crsfCommandIdle = 0,       // read: not running
+    crsfCommandClick = 1,      // written: start
+    crsfCommandExecuting = 2,  // read: running, the radio polls it every `min` * 10 ms and shows the info text
+    crsfCommandAskConfirm = 3, // read: the radio shows the info text and writes crsfCommandConfirmed or crsfCommandCancel
+    crsfCommandConfirmed = 4,  // written
+    crsfCommandCancel = 5,     // written
+    crsfCommandQuery = 6,      // written: poll, the radio expects the entry back
+} crsfCommandStatus_e;
+
+/**
+ * @brief A field of the parameter menu the radio shows for the module (the ExpressLRS Lua script, or the
+ * EdgeTX device configuration)
+ */
+typedef struct
+{
+    const char *name;
+    crsf_value_type_e type;      // CRSF_UINT8, CRSF_TEXT_SELECTION, CRSF_INFO or CRSF_COMMAND
+    const char *options;         // CRSF_TEXT_SELECTION: the choices separated by ';', CRSF_INFO and CRSF_COMMAND: the text
+    const char *units;           // shown after the value, nullptr for none
+    uint8_t min;                 // CRSF_UINT8: the range of the value, CRSF_COMMAND: the poll interval in 10 ms
+    uint8_t max;
+    uint8_t (*get)();            // the current value, for CRSF_TEXT_SELECTION the index of the choice, for CRSF_COMMAND its crsfCommandStatus_e
+    bool (*set)(uint8_t value);  // apply and persist a value written by the radio, false if it was rejected
+    const char *(*info)();       // CRSF_INFO and CRSF_COMMAND: builds the text when the entry is read, instead of `options`
+} crsfParameter_t;
+
+/**
+ * @brief The CRSF parameter read/write protocol (PARAMETER_READ, PARAMETER_WRITE and the
+ * PARAMETER_SETTINGS_ENTRY replies) over a table of fields. The fields are numbered from 1 in table order,
+ * all of them in the root folder. An entry is built when its first chunk is read and kept for its other
+ * chunks, so a CRSF_INFO text changing meanwhile still reassembles.
+ * Not thread safe, used from the handset input only.
+ */
+class CRSFParameters
+{
+public:
+    /**
+     * @param fields the table, must stay valid
+     */
+    static void begin(const crsfParameter_t *fields, uint8_t count);
+
+    /**
+     * @return the number of fields, the parametersCnt of the device information
+     */
+    static uint8_t count() { return fieldCount; }
+
+    /**
+     * @brief Build the payload of a PARAMETER_SETTINGS_ENTRY frame: field id, chunks remaining and the
+     * `chunk`th piece of the entry
+     * @param chunkSize data bytes per chunk
+     * @param payload receives 2 + chunkSize bytes at most
+     * @return the payload length, 0 if there is no such field or chunk
+     */
+    static uint8_t readChunk(uint8_t id, uint8_t chunk, uint8_t chunkSize, uint8_t *payload);
+
+    /**
+     * @brief Handle a PARAMETER_WRITE: check the value against the field and hand it to its set()
+     * @param value the bytes following the field id
+     * @return false if the field does not exist, cannot be written or rejected the value
+     */
+    static bool write(uint8_t id, const uint8_t *value, uint8_t len);
+
+    /**
+     * @return true if the field is a CRSF_COMMAND, the radio expects its entry back after writing it
+     */
+    static bool isCommand(uint8_t id) { return id > 0 && id <= fieldCount && fields[id - 1].type == CRSF_COMMAND; }
+
+private:
+    static const crsfParameter_t *fields;
+    static uint8_t fieldCount;
+    static uint8_t cached[CRSF_PARAMETER_ENTRY_MAX]; // the entry of the field last read
+    static uint8_t cachedId;
+    static uint8_t cachedLen;
+
+    static uint8_t serialize(const crsfParameter_t &field, uint8_t *entry);
+};
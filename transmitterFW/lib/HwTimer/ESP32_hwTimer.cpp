@@ -28,7 +28,9 @@ volatile uint32_t hwTimer::HWtimerIntervalUS = TimerIntervalUSDefault;
 
 // Internal implementation specific variables
 static hw_timer_t *timer = NULL;
+#if defined(ESPNOW_SEND_FROM_ISR)
 static portMUX_TYPE isrMutex = portMUX_INITIALIZER_UNLOCKED;
+#endif
 
 #define HWTIMER_FREQUENCY 1000000 // 1 MHz
 
@@ -63,6 +65,14 @@ void ICACHE_RAM_ATTR hwTimer::resume()
     }
 }
 
+void ICACHE_RAM_ATTR hwTimer::restart()
+{
+    if (timer && running)
+    {
+        timerRestart(timer);
+    }
+}
+
 void ICACHE_RAM_ATTR hwTimer::updateIntervalUS(uint32_t timeUS)
 {
     // timer should not be running when updateIntervalUS() is called
@@ -77,8 +87,15 @@ void ICACHE_RAM_ATTR hwTimer::callback(void)
 {
     if (running)
     {
+#if defined(ESPNOW_SEND_FROM_ISR)
+        // The callback sends the ESP-NOW frame. The critical section guards nothing: the ISR is the only sender, or with
+        // ESPNOW_SEND_ON_ARRIVAL sendBusy in main.cpp keeps the handset out. It masks the interrupts of this core around
+        // esp_now_send() as the original firmware did, so the latency measurements compare against its timing.
         portENTER_CRITICAL_ISR(&isrMutex);
         callbackFunc();
         portEXIT_CRITICAL_ISR(&isrMutex);
+#else
+        callbackFunc(); // only wakes the sender task, the handset interrupts on this core are not held off
+#endif
     }
 }
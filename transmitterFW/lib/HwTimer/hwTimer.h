@@ -56,6 +56,14 @@ public:
      */
     static void resume();
 
+    /**
+     * @brief Restart the current interval from this instant.
+     *
+     * The next callback comes one interval after this call, the timer then acts as a watchdog
+     * that only fires when it is not restarted in time.
+     */
+    static void restart();
+
     /**
      * @brief Change the interval between callbacks.
      * The timer should not be running when updateIntervalUS() is called.
@@ -0,0 +1,103 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "common.h"
+
+#ifndef LATENCY_HISTOGRAM_BUCKETS
+#define LATENCY_HISTOGRAM_BUCKETS 24 // bucket 0: 0 us, bucket n: 2^(n-1) to 2^n - 1 us, the last one also everything above
+#endif
+
+typedef struct latencyHistogram_s
+{
+    uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint32_t maxUS;
+    uint64_t sumUS;
+} latencyHistogram_t;
+
+/**
+ * @return the smallest latency counted in the bucket
+ */
+static inline uint32_t latencyBucketMinUS(uint8_t bucket)
+{
+    return bucket ? 1U << (bucket - 1) : 0;
+}
+
+/**
+ * @return an upper bound of the latency below which `percent` of the samples fall: the upper end of
+ * the bucket the percentile falls into, but no more than the largest sample
+ */
+static inline uint32_t latencyPercentileUS(const latencyHistogram_t *histogram, uint8_t percent)
+{
+    const uint64_t rank = ((uint64_t)histogram->count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (uint8_t n = 0; n < LATENCY_HISTOGRAM_BUCKETS - 1; n++)
+    {
+        seen += histogram->buckets[n];
+        if (seen >= rank && seen > 0)
+        {
+            const uint32_t upper = (1U << n) - 1;
+            return upper < histogram->maxUS ? upper : histogram->maxUS;
+        }
+    }
+    return histogram->maxUS;
+}
+
+/**
+ * Latency distribution in power-of-two buckets, a sample costs a count-leading-zeros and three adds.
+ * add() must only be called from one context, it may be an ISR. read() may be called from any other one: a copy taken
+ * while a sample is added can be off by that sample, a reset is carried out by the next add().
+ */
+class LatencyHistogram
+{
+public:
+    void ICACHE_RAM_ATTR add(uint32_t us)
+    {
+        if (resetRequested)
+        {
+            memset(&data, 0, sizeof(data));
+            resetRequested = false;
+        }
+        const uint8_t bucket = us ? 32 - __builtin_clz(us) : 0;
+        data.buckets[bucket < LATENCY_HISTOGRAM_BUCKETS ? bucket : LATENCY_HISTOGRAM_BUCKETS - 1]++;
+        data.count++;
+        data.sumUS += us;
+        if (us > data.maxUS) data.maxUS = us;
+    }
+
+    /**
+     * @param reset start over with the next sample
+     */
+    void read(latencyHistogram_t *histogram, bool reset)
+    {
+        if (resetRequested)
+            memset(histogram, 0, sizeof(*histogram)); // nothing added since the last reset
+        else
+            memcpy(histogram, (const void *)&data, sizeof(*histogram));
+        if (reset)
+            resetRequested = true;
+    }
+
+private:
+    latencyHistogram_t data = {};
+    volatile bool resetRequested = false;
+};
@@ -0,0 +1,87 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Success ratio over the last N transmissions, kept as a ring of result bits.
+ * Not thread safe, callers adding from different contexts must serialize add().
+ */
+template <uint8_t N>
+class LinkQuality
+{
+public:
+    /**
+     * @brief Record the result of one transmission, the oldest result falls out once the window is full
+     */
+    void add(bool success)
+    {
+        uint32_t &word = window[pos / 32];
+        const uint32_t bit = 1U << (pos % 32);
+
+        if (count == N)
+        {
+            if (word & bit) successes--;
+        }
+        else
+        {
+            count++;
+        }
+
+        if (success)
+        {
+            word |= bit;
+            successes++;
+        }
+        else
+        {
+            word &= ~bit;
+        }
+
+        pos = (pos + 1) % N;
+    }
+
+    /**
+     * @return the success ratio in percent over the window, 0 before the first transmission
+     */
+    uint8_t getLQ() const
+    {
+        return count ? (uint16_t)successes * 100 / count : 0;
+    }
+
+    /**
+     * @return the number of transmissions in the window, up to N
+     */
+    uint8_t getCount() const { return count; }
+
+    void reset()
+    {
+        for (uint32_t &word : window) word = 0;
+        pos = 0;
+        count = 0;
+        successes = 0;
+    }
+
+private:
+    uint32_t window[(N + 31) / 32] = {0};
+    uint8_t pos = 0;
+    volatile uint8_t count = 0;
+    volatile uint8_t successes = 0;
+};
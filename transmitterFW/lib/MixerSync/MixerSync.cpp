@@ -0,0 +1,152 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "MixerSync.h"
+
+// Gains per sync window, the closed loop has a double pole at 0.5: the phase error halves every window
+#define MIXER_SYNC_KP_NUM 3
+#define MIXER_SYNC_KP_DEN 4
+#define MIXER_SYNC_KI_DEN 4
+#define MIXER_SYNC_SPREAD_DEN 4 // the spread follows its measurement by 1/4 per window
+#define MIXER_SYNC_GUARD_STEP_US (2 * MIXER_SYNC_MARGIN_US)
+#define MIXER_SYNC_GUARD_DEN 64 // the guard fades by 1/64 per window, 13 s at 200 ms
+
+void MixerSync::begin(uint32_t intervalUS)
+{
+    portENTER_CRITICAL(&mux);
+    interval = intervalUS;
+    windowSum = 0;
+    windowCount = 0;
+    windowLate = 0;
+    settle = 0;
+    packets = 0;
+    portEXIT_CRITICAL(&mux);
+    integral = 0;
+    spread = 0;
+    guard = 0;
+    phaseError = 0;
+    lastOffset = 0;
+    locked = false;
+}
+
+void ICACHE_RAM_ATTR MixerSync::rfPacketSent(uint32_t nowUS, uint32_t frameUS)
+{
+    const uint32_t wait = nowUS - frameUS;
+
+    portENTER_CRITICAL_ISR(&mux);
+    packets++;
+    if (settle > 0)
+    {
+        settle--;
+    }
+    else if (wait >= 4 * (uint32_t)interval)
+    {
+        skipped++; // the handset stalled, this says nothing about the phase
+    }
+    else
+    {
+        // A frame from an earlier interval: the one for this packet came too late (or EdgeTX skipped it),
+        // count it as arrived with the RF packet so that the window minimum sees it
+        int32_t error = -MIXER_SYNC_MARGIN_US;
+        if (wait < (uint32_t)interval)
+            error += wait;
+        else
+            windowLate++;
+        // Unwrap to within half an interval of the first error of the window, so that errors
+        // around +-interval/2 do not average out to 0
+        const int32_t ref = windowCount ? windowRef : 0;
+        if (error - ref >= interval / 2)
+            error -= interval;
+        else if (error - ref < -interval / 2)
+            error += interval;
+        if (windowCount == 0 || error < windowMin)
+            windowMin = error;
+        if (windowCount == 0)
+            windowRef = error;
+        windowSum += error;
+        windowCount++;
+        samples++;
+    }
+    portEXIT_CRITICAL_ISR(&mux);
+}
+
+void MixerSync::update(int32_t *offset)
+{
+    portENTER_CRITICAL(&mux);
+    const int64_t sum = windowSum;
+    const uint32_t count = windowCount;
+    const int32_t min = windowMin;
+    const uint32_t late = windowLate;
+    windowPackets = packets;
+    windowSum = 0;
+    windowCount = 0;
+    windowLate = 0;
+    packets = 0;
+    portEXIT_CRITICAL(&mux);
+
+    int32_t out = 0;
+    if (count > 0)
+    {
+        // Aim the mean so that the earliest RF packet of the window still finds its frame (the minimum error
+        // at 0): keep the mean above the margin by the spread of the errors, averaged over a few windows
+        const int32_t mean = sum / (int32_t)count;
+        spread += (mean - min - spread) / MIXER_SYNC_SPREAD_DEN;
+        phaseError = mean - spread - guard;
+        if (phaseError > interval / 4 || phaseError < -interval / 4)
+        {
+            // Far off, move the mixer in one step and keep the drift estimate
+            out = phaseError;
+            acquisitions++;
+            locked = false;
+        }
+        else
+        {
+            integral += phaseError / MIXER_SYNC_KI_DEN;
+            integral = std::max(-interval / 4, std::min(interval / 4, integral));
+            out = phaseError * MIXER_SYNC_KP_NUM / MIXER_SYNC_KP_DEN + integral;
+            locked = phaseError <= interval / 8 && phaseError >= -interval / 8;
+        }
+        // Late RC frames (stale RF packets) in a locked window add to the guard, for the tail of the jitter
+        // that the spread of a window misses, it fades out over the following windows
+        guard -= guard / MIXER_SYNC_GUARD_DEN;
+        if (late > 0 && locked)
+            guard = std::min(interval / 8, guard + MIXER_SYNC_GUARD_STEP_US);
+        out = std::max(-interval / 2, std::min(interval / 2, out));
+    }
+
+    lastOffset = out;
+    if (out != 0)
+    {
+        portENTER_CRITICAL(&mux);
+        settle = MIXER_SYNC_SETTLE_PACKETS;
+        portEXIT_CRITICAL(&mux);
+    }
+    *offset = out * 10;
+}
+
+void MixerSync::getStats(mixerSyncStats_t *stats) const
+{
+    stats->phaseErrorUS = phaseError;
+    stats->periodErrorNS = windowPackets ? -(int64_t)integral * 1000 / (int32_t)windowPackets : 0;
+    stats->spreadUS = spread;
+    stats->offsetUS = lastOffset;
+    stats->samples = samples;
+    stats->skipped = skipped;
+    stats->acquisitions = acquisitions;
+    stats->locked = locked;
+}
@@ -0,0 +1,100 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "common.h"
+
+#ifndef MIXER_SYNC_MARGIN_US
+#define MIXER_SYNC_MARGIN_US 100     // how long before the RF packet the RC frame should arrive at least
+#endif
+#define MIXER_SYNC_SETTLE_PACKETS 2  // RF packets not measured after a sync packet, until EdgeTX has applied its offset
+
+typedef struct
+{
+    int32_t phaseErrorUS;  // mean wait of the RC frames for their RF packet minus margin and spread, last sync window (positive: EdgeTX early)
+    int32_t spreadUS;      // how much the wait varies below its mean (EdgeTX jitter, UART polling)
+    int32_t periodErrorNS; // estimated EdgeTX mixer period minus the packet interval
+    int32_t offsetUS;      // offset sent with the last sync packet
+    uint32_t samples;      // RF packets measured since begin()
+    uint32_t skipped;      // RF packets without an RC frame in the last 4 intervals
+    uint32_t acquisitions; // windows off by more than a quarter interval, corrected in one step
+    bool locked;           // the last window was within an eighth of an interval
+} mixerSyncStats_t;
+
+/**
+ * @brief Phase-locks the EdgeTX mixer to the RF packets, through the offset of the CRSF timing packets.
+ *
+ * Every RF packet measures how long the newest RC frame waited for it, the error to MIXER_SYNC_MARGIN_US
+ * is averaged over a sync window (one timing packet, 200 ms). EdgeTX adds the offset it receives to its
+ * next mixer period once, so the controller is a PI on the phase error per window: the proportional
+ * part corrects the phase, the integral part the steady drift of a mixer period that differs from the
+ * packet interval (crystal tolerance), which is reported as the period error.
+ * The target is not the mean wait but its low end: the spread of the waits below their mean (EdgeTX jitter,
+ * UART polling) is added to the margin, and an RC frame that misses its RF packet adds a guard that fades out.
+ * Phase errors beyond a quarter interval (startup, rate change, a stalled handset) are corrected in one step.
+ */
+class MixerSync
+{
+public:
+    /**
+     * @brief Start over at a new packet interval
+     */
+    void begin(uint32_t intervalUS);
+
+    /**
+     * @brief Measure the phase of an RF packet, called when it has been sent
+     * @param nowUS time of the RF packet
+     * @param frameUS time the newest RC frame arrived
+     */
+    void rfPacketSent(uint32_t nowUS, uint32_t frameUS);
+
+    /**
+     * @brief Run the controller on the RF packets measured since the last call, once per timing packet
+     * @param offset receives the offset for the timing packet, in 0.1 us
+     */
+    void update(int32_t *offset);
+
+    void getStats(mixerSyncStats_t *stats) const;
+
+private:
+    int32_t interval = 20000;   // us
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+    // sync window, filled by rfPacketSent()
+    int64_t windowSum = 0;      // us
+    uint32_t windowCount = 0;
+    int32_t windowRef = 0;      // first error of the window, the others are unwrapped around it
+    int32_t windowMin = 0;
+    uint32_t windowLate = 0;
+    uint32_t settle = 0;
+    uint32_t samples = 0;
+    uint32_t skipped = 0;
+
+    // controller, us
+    int32_t integral = 0;       // offset per window that compensates the drift
+    int32_t spread = 0;         // mean minus earliest error of a window, smoothed
+    int32_t guard = 0;          // extra lead after late RC frames
+    int32_t phaseError = 0;
+    int32_t lastOffset = 0;
+    uint32_t windowPackets = 0; // RF packets in the last window, measured or not
+    uint32_t packets = 0;
+    uint32_t acquisitions = 0;
+    bool locked = false;
+};
@@ -0,0 +1,132 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "ModelTable.h"
+#include <Preferences.h>
+
+static_assert(MODEL_TABLE_SIZE <= 64, "the stored entries are tracked in a 64-bit mask");
+
+static constexpr const char *nvsNamespace = "models";
+
+uint8_t ModelTable::macs[MODEL_TABLE_SIZE][6] = {};
+bool ModelTable::valid[MODEL_TABLE_SIZE] = {};
+const uint8_t (*ModelTable::defaults)[6] = nullptr;
+uint8_t ModelTable::defaultCount = 0;
+uint64_t ModelTable::stored = 0;
+uint8_t ModelTable::storedMacs[MODEL_TABLE_SIZE][6] = {};
+volatile bool ModelTable::dirty = false;
+
+static bool isZero(const uint8_t *mac)
+{
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        if (mac[i]) return false;
+    }
+    return true;
+}
+
+void ModelTable::begin(const uint8_t (*compiled)[6], uint8_t count)
+{
+    defaults = compiled;
+    defaultCount = count < MODEL_TABLE_SIZE ? count : MODEL_TABLE_SIZE;
+
+    Preferences prefs;
+    if (prefs.begin(nvsNamespace, true))
+    {
+        stored = prefs.getULong64("stored", 0);
+        if (prefs.getBytesLength("macs") != sizeof(storedMacs) || prefs.getBytes("macs", storedMacs, sizeof(storedMacs)) != sizeof(storedMacs))
+        {
+            stored = 0; // table size changed, start over from the compiled entries
+        }
+        prefs.end();
+    }
+
+    for (uint8_t n = 0; n < MODEL_TABLE_SIZE; n++)
+    {
+        apply(n);
+    }
+}
+
+void ModelTable::apply(uint8_t modelid)
+{
+    const uint8_t *mac = nullptr;
+    if (stored & (1ULL << modelid))
+    {
+        mac = storedMacs[modelid];
+    }
+    else if (modelid < defaultCount)
+    {
+        mac = defaults[modelid];
+    }
+
+    if (mac && !isZero(mac))
+    {
+        memcpy(macs[modelid], mac, 6);
+        valid[modelid] = true;
+    }
+    else
+    {
+        memset(macs[modelid], 0, 6);
+        valid[modelid] = false;
+    }
+}
+
+int ModelTable::find(const uint8_t *mac)
+{
+    for (uint8_t n = 0; n < MODEL_TABLE_SIZE; n++)
+    {
+        if (valid[n] && memcmp(macs[n], mac, 6) == 0)
+            return n;
+    }
+    return -1;
+}
+
+bool ModelTable::setMAC(uint8_t modelid, const uint8_t *mac)
+{
+    if (modelid >= MODEL_TABLE_SIZE)
+        return false;
+
+    if (mac && !isZero(mac))
+    {
+        memcpy(storedMacs[modelid], mac, 6);
+        stored |= 1ULL << modelid;
+    }
+    else
+    {
+        memset(storedMacs[modelid], 0, 6);
+        stored &= ~(1ULL << modelid);
+    }
+    apply(modelid);
+    dirty = true;
+    return true;
+}
+
+bool ModelTable::commit()
+{
+    if (!dirty)
+        return true;
+    dirty = false; // cleared before the copy, a setMAC() racing with it is written by the next commit()
+
+    Preferences prefs;
+    if (!prefs.begin(nvsNamespace, false))
+        return false;
+    bool ok = prefs.putBytes("macs", storedMacs, sizeof(storedMacs)) == sizeof(storedMacs) &&
+              prefs.putULong64("stored", stored) == sizeof(stored);
+    prefs.end();
+    return ok;
+}
@@ -0,0 +1,86 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "common.h"
+
+#ifndef MODEL_TABLE_SIZE
+#define MODEL_TABLE_SIZE 64 // EdgeTX receiver numbers 0 to 63
+#endif
+
+/**
+ * @brief The receiver MAC address of every model number, independent of the ESP-NOW peer table.
+ *
+ * Starts out as the list compiled into the firmware (cyberbrickRxMAC). Entries set at runtime (bind from
+ * the parameter menu) are stored in NVS and take precedence over the compiled ones after a reboot,
+ * clearing such an entry brings the compiled one back.
+ * setMAC() and commit() are called from one context each, commit() from loop(): a flash write stalls both cores.
+ */
+class ModelTable
+{
+public:
+    /**
+     * @brief Load the table: the compiled entries, overlaid by the ones stored in NVS
+     * @param defaults the compiled receiver MAC addresses of models 0 to count - 1
+     */
+    static void begin(const uint8_t (*defaults)[6], uint8_t count);
+
+    /**
+     * @return the receiver MAC address of the model, nullptr if the model has none
+     */
+    static ICACHE_RAM_ATTR const uint8_t *getMAC(uint8_t modelid)
+    {
+        return modelid < MODEL_TABLE_SIZE && valid[modelid] ? macs[modelid] : nullptr;
+    }
+
+    /**
+     * @return all entries, an entry without a receiver is all zero
+     */
+    static const uint8_t (*getMACs())[6] { return macs; }
+
+    /**
+     * @return the model number of the receiver with the MAC address, -1 if there is none
+     */
+    static int find(const uint8_t *mac);
+
+    /**
+     * @brief Set the receiver of a model, a nullptr or all zero `mac` clears the stored entry.
+     * Takes effect at once, persisted by the next commit().
+     * @return false if the model number is out of range
+     */
+    static bool setMAC(uint8_t modelid, const uint8_t *mac);
+
+    /**
+     * @brief Persist the entries changed by setMAC()
+     * @return false if NVS could not be written
+     */
+    static bool commit();
+
+private:
+    static uint8_t macs[MODEL_TABLE_SIZE][6];
+    static bool valid[MODEL_TABLE_SIZE];
+    static const uint8_t (*defaults)[6];
+    static uint8_t defaultCount;
+    static uint64_t stored; // bit n: model n is stored in NVS
+    static uint8_t storedMacs[MODEL_TABLE_SIZE][6];
+    static volatile bool dirty;
+
+    static void apply(uint8_t modelid);
+};
@@ -0,0 +1,442 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "Settings.h"
+#include "ParameterMenu.h"
+#include <algorithm>
+#include <stdio.h>
+#include <WiFi.h>
+#include "CRSF.h"
+#include "CRSFParameters.h"
+#include "EspNowPhyRates.h"
+#include "LatencyHistogram.h"
+#include "ModelTable.h"
+
+// The TX power levels of the menu, and the CRSF power index reported in the link statistics for each
+static const struct
+{
+    wifi_power_t power;
+    uint8_t crsfPower; // 1: 10 mW, 2: 25 mW, 8: 50 mW, 3: 100 mW
+} txPowerLevels[] = {
+    {WIFI_POWER_2dBm, 1}, {WIFI_POWER_5dBm, 1}, {WIFI_POWER_7dBm, 1}, {WIFI_POWER_8_5dBm, 1},
+    {WIFI_POWER_11dBm, 1}, {WIFI_POWER_13dBm, 2}, {WIFI_POWER_15dBm, 2}, {WIFI_POWER_17dBm, 8},
+    {WIFI_POWER_18_5dBm, 8}, {WIFI_POWER_19dBm, 3}, {WIFI_POWER_19_5dBm, 3}
+};
+static constexpr uint8_t wifiChannelMax = 11;
+static constexpr unsigned txPowerCount = sizeof(txPowerLevels) / sizeof(txPowerLevels[0]);
+static constexpr unsigned packetRateCount = sizeof(RFpacketIntervalsUS) / sizeof(RFpacketIntervalsUS[0]);
+static char packetRateOptions[8 * packetRateCount]; // the packet rates in Hz, filled in from RFpacketIntervalsUS
+static char phyRateOptions[8 * (espnowPhyRateCount + 1)]; // "Auto" and the rates of espnowPhyRates
+
+static CRSFHandset *handset = nullptr;
+static parameterMenuHooks_t hooks = {};
+
+static portMUX_TYPE bindMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool bindListening = false; // onReceive() takes the first bind frame until bindDeadline
+static volatile bool bindReceived = false;
+static uint8_t bindMAC[6];                  // the receiver that sent it
+static uint32_t bindDeadline = 0;           // millis()
+static uint8_t bindModel = 0;               // the model the receiver is bound to
+static crsfCommandStatus_e bindStatus = crsfCommandIdle;
+static char bindText[40];                   // the result shown until the user confirms it
+
+static uint8_t getPacketRate();
+static bool setPacketRate(uint8_t index);
+static uint8_t getWifiChannel();
+static bool setWifiChannel(uint8_t channel);
+static uint8_t getTxPower();
+static bool setTxPower(uint8_t index);
+static uint8_t getPayload();
+static bool setPayload(uint8_t legacy);
+static uint8_t getPhyRate();
+static bool setPhyRate(uint8_t index);
+static uint8_t getBind();
+static bool setBind(uint8_t status);
+static const char *infoBind();
+static const char *infoLatency();
+static const char *infoTiming();
+static const char *infoUart();
+static const char *infoHandsetSearch();
+static const char *infoHalfDuplex();
+static const char *infoTelemetry();
+static const char *infoPhyRate();
+static const char *infoTasks();
+static const char *infoModelSwitch();
+
+static const crsfParameter_t parameters[] = {
+    {"Packet Rate", CRSF_TEXT_SELECTION, packetRateOptions, "Hz", 0, 0, getPacketRate, setPacketRate, nullptr},
+    {"WiFi Channel", CRSF_UINT8, nullptr, nullptr, 1, wifiChannelMax, getWifiChannel, setWifiChannel, nullptr},
+    {"TX Power", CRSF_TEXT_SELECTION, "2;5;7;8.5;11;13;15;17;18.5;19;19.5", "dBm", 0, 0, getTxPower, setTxPower, nullptr},
+    {"Payload", CRSF_TEXT_SELECTION, "Versioned;Legacy", nullptr, 0, 0, getPayload, setPayload, nullptr},
+    {"PHY Rate", CRSF_TEXT_SELECTION, phyRateOptions, nullptr, 0, 0, getPhyRate, setPhyRate, nullptr},
+    {"Bind", CRSF_COMMAND, nullptr, nullptr, 20, 0, getBind, setBind, infoBind}, // polled every 200 ms
+    {"Version", CRSF_INFO, versionID, nullptr, 0, 0, nullptr, nullptr, nullptr},
+    // Read-only statistics since boot, built when the radio reads the field (reopen the menu to refresh)
+    {"Latency", CRSF_INFO, nullptr, nullptr, 0, 0, nullptr, nullptr, infoLatency},
+    {"Timing", CRSF_INFO, nullptr, nullptr, 0, 0, nullptr, nullptr, infoTiming},
+    {"UART", CRSF_INFO, nullptr, nullptr, 0, 0, nullptr, nullptr, infoUart},
+    {"Handset Search", CRSF_INFO, nullptr, nullptr, 0, 0, nullptr, nullptr, infoHandsetSearch},
+    {"Half Duplex", CRSF_INFO, nullptr, nullptr, 0, 0, nullptr, nullptr, infoHalfDuplex},
+    {"Telemetry", CRSF_INFO, nullptr, nullptr, 0, 0, nullptr, nullptr, infoTelemetry},
+    {"PHY Stats", CRSF_INFO, nullptr, nullptr, 0, 0, nullptr, nullptr, infoPhyRate},
+    {"Tasks", CRSF_INFO, nullptr, nullptr, 0, 0, nullptr, nullptr, infoTasks},
+    {"Model Switch", CRSF_INFO, nullptr, nullptr, 0, 0, nullptr, nullptr, infoModelSwitch},
+};
+
+const txSettings_t &ParameterMenu::begin(CRSFHandset *handsetIn, const parameterMenuHooks_t &hooksIn, const txSettings_t &defaults)
+{
+    handset = handsetIn;
+    hooks = hooksIn;
+
+    txSettings_t settings = Settings::begin(defaults);
+    bool changed = false;
+    const auto end = RFpacketIntervalsUS + packetRateCount;
+    if (std::find(RFpacketIntervalsUS, end, settings.packetIntervalUS) == end)
+    {
+        settings.packetIntervalUS = defaults.packetIntervalUS;
+        changed = true;
+    }
+    if (settings.wifiChannel < 1 || settings.wifiChannel > wifiChannelMax)
+    {
+        settings.wifiChannel = defaults.wifiChannel;
+        changed = true;
+    }
+    if (std::none_of(txPowerLevels, txPowerLevels + txPowerCount, [&](const auto &level) { return level.power == settings.txPower; }))
+    {
+        settings.txPower = defaults.txPower;
+        changed = true;
+    }
+    if (settings.legacyPayload > 1)
+    {
+        settings.legacyPayload = defaults.legacyPayload;
+        changed = true;
+    }
+    if (settings.phyRate > espnowPhyRateCount)
+    {
+        settings.phyRate = defaults.phyRate;
+        changed = true;
+    }
+    if (changed)
+        Settings::save(settings);
+
+    char *pos = packetRateOptions;
+    for (unsigned n = 0; n < packetRateCount; n++)
+        pos += sprintf(pos, n ? ";%u" : "%u", (unsigned)(1000000 / RFpacketIntervalsUS[n]));
+    pos = phyRateOptions + sprintf(phyRateOptions, "Auto");
+    for (const espnowPhyRate_t &rate : espnowPhyRates)
+    {
+        if (rate.mode == WIFI_PHY_MODE_LR)
+            pos += sprintf(pos, ";LR %uk", rate.kbps);
+        else
+            pos += sprintf(pos, ";%uM", rate.kbps / 1000);
+    }
+
+    CRSFParameters::begin(parameters, sizeof(parameters) / sizeof(parameters[0]));
+    return Settings::get();
+}
+
+uint8_t ParameterMenu::getCrsfTxPower()
+{
+    return txPowerLevels[getTxPower()].crsfPower;
+}
+
+static uint8_t getPacketRate()
+{
+    return std::find(RFpacketIntervalsUS, RFpacketIntervalsUS + packetRateCount, getPacketInterval()) - RFpacketIntervalsUS;
+}
+
+static bool setPacketRate(uint8_t index)
+{
+    if (!setPacketInterval(RFpacketIntervalsUS[index]))
+        return false;
+    txSettings_t settings = Settings::get();
+    settings.packetIntervalUS = getPacketInterval();
+    Settings::update(settings);
+    return true;
+}
+
+static uint8_t getWifiChannel()
+{
+    return Settings::get().wifiChannel;
+}
+
+// The radio changes channel at once, the registered receivers follow it
+static bool setWifiChannel(uint8_t channel)
+{
+    if (!hooks.setWifiChannel(channel))
+        return false;
+    txSettings_t settings = Settings::get();
+    settings.wifiChannel = channel;
+    Settings::update(settings);
+    return true;
+}
+
+static uint8_t getTxPower()
+{
+    uint8_t index = 0;
+    for (uint8_t n = 0; n < txPowerCount; n++)
+    {
+        if (txPowerLevels[n].power <= Settings::get().txPower)
+            index = n;
+    }
+    return index;
+}
+
+static bool setTxPower(uint8_t index)
+{
+    if (!WiFi.setTxPower(txPowerLevels[index].power))
+        return false;
+    txSettings_t settings = Settings::get();
+    settings.txPower = txPowerLevels[index].power;
+    Settings::update(settings);
+    return true;
+}
+
+static uint8_t getPayload()
+{
+    return Settings::get().legacyPayload;
+}
+
+// Single models only, convoy frames stay versioned: the legacy format cannot address the convoy's receivers
+static bool setPayload(uint8_t legacy)
+{
+    hooks.setPayload(legacy);
+    txSettings_t settings = Settings::get();
+    settings.legacyPayload = legacy;
+    Settings::update(settings);
+    return true;
+}
+
+static uint8_t getPhyRate()
+{
+    return Settings::get().phyRate;
+}
+
+static bool setPhyRate(uint8_t index)
+{
+    hooks.setPhyRate(index);
+    txSettings_t settings = Settings::get();
+    settings.phyRate = index;
+    Settings::update(settings);
+    return true;
+}
+
+/// Bind. Runs in the handset context, as the model selection and the other menu fields ///
+
+void ParameterMenu::onReceive(const uint8_t *mac, const uint8_t *data, int len)
+{
+    if (!bindListening || len != 6 || memcmp(data, mac, 6) != 0)
+        return;
+    portENTER_CRITICAL(&bindMux);
+    if (bindListening && !bindReceived && (int32_t)(millis() - bindDeadline) < 0)
+    {
+        memcpy(bindMAC, data, 6);
+        bindReceived = true;
+    }
+    portEXIT_CRITICAL(&bindMux);
+}
+
+void ParameterMenu::applyBind()
+{
+    if (bindStatus != crsfCommandExecuting)
+        return;
+    uint8_t mac[6];
+    portENTER_CRITICAL(&bindMux);
+    const bool received = bindReceived;
+    memcpy(mac, bindMAC, 6);
+    if (received || (int32_t)(millis() - bindDeadline) >= 0)
+        bindListening = false;
+    portEXIT_CRITICAL(&bindMux);
+
+    if (!received)
+    {
+        if (bindListening)
+            return;
+        snprintf(bindText, sizeof(bindText), "No receiver found");
+    }
+    else if (ModelTable::find(mac) >= 0 && ModelTable::find(mac) != bindModel)
+    {
+        snprintf(bindText, sizeof(bindText), "Receiver is model %d", ModelTable::find(mac));
+    }
+    else
+    {
+        hooks.bindReceiver(bindModel, mac);
+        snprintf(bindText, sizeof(bindText), "Model %u %02x:%02x:%02x:%02x:%02x:%02x", bindModel, mac[0], mac[1], mac[2], mac[3],
+                 mac[4], mac[5]);
+    }
+    bindStatus = crsfCommandAskConfirm; // the radio shows the result until the user confirms it
+}
+
+static uint8_t getBind()
+{
+    ParameterMenu::applyBind();
+    return bindStatus;
+}
+
+static bool setBind(uint8_t status)
+{
+    if (status == crsfCommandClick && bindStatus == crsfCommandIdle)
+    {
+        const uint8_t modelid = handset->getModelID();
+        if (hooks.isConvoy(modelid) || modelid >= MODEL_TABLE_SIZE)
+        {
+            snprintf(bindText, sizeof(bindText), "Select a single model");
+            bindStatus = crsfCommandAskConfirm;
+            return true;
+        }
+        bindModel = modelid;
+        portENTER_CRITICAL(&bindMux);
+        bindReceived = false;
+        bindDeadline = millis() + BIND_TIMEOUT_MS;
+        bindListening = true;
+        portEXIT_CRITICAL(&bindMux);
+        bindStatus = crsfCommandExecuting;
+    }
+    else if (status == crsfCommandConfirmed || status == crsfCommandCancel)
+    {
+        portENTER_CRITICAL(&bindMux);
+        bindListening = false;
+        portEXIT_CRITICAL(&bindMux);
+        bindStatus = crsfCommandIdle;
+    }
+    return true; // crsfCommandQuery: the entry is read back, getBind() applies the result
+}
+
+static const char *infoBind()
+{
+    if (bindStatus == crsfCommandExecuting)
+        return "Hold the receiver's button";
+    if (bindStatus == crsfCommandAskConfirm)
+        return bindText;
+    return "";
+}
+
+/// Statistics shown as CRSF_INFO fields, counted since boot ///
+
+static char infoText[CRSF_PARAMETER_ENTRY_MAX]; // copied into the entry right away, one buffer serves all fields
+
+static uint32_t p99US(latencyStage_e stage)
+{
+    latencyHistogram_t histogram;
+    getLatencyHistogram(stage, &histogram, false);
+    return latencyPercentileUS(&histogram, 99);
+}
+
+static const char *infoLatency()
+{
+    snprintf(infoText, sizeof(infoText), "p99 in %u sched %u air %u total %uus", (unsigned)p99US(latencyInput),
+             (unsigned)p99US(latencySchedule), (unsigned)p99US(latencyAir), (unsigned)p99US(latencyTotal));
+    return infoText;
+}
+
+static const char *infoTiming()
+{
+#if defined(CRSF_RX_TASK)
+    // and the RX task's time from the UART event to the RC frame in ChannelData
+    crsfRxTaskStats_t rx;
+    handset->GetRxTaskStats(&rx, false);
+    snprintf(infoText, sizeof(infoText), "p99 ISR %u wake %u RX jitter %uus, RX task %u-%u avg %uus",
+             (unsigned)p99US(latencyTimerIsr), (unsigned)p99US(latencyWakeup), (unsigned)p99US(latencyRxJitter),
+             (unsigned)rx.latencyMinUS, (unsigned)rx.latencyMaxUS, (unsigned)rx.latencyAvgUS);
+#else
+    snprintf(infoText, sizeof(infoText), "p99 ISR %u wake %u RX jitter %uus", (unsigned)p99US(latencyTimerIsr),
+             (unsigned)p99US(latencyWakeup), (unsigned)p99US(latencyRxJitter));
+#endif
+    return infoText;
+}
+
+static const char *infoUart()
+{
+    crsfUartErrorStats_t stats;
+    handset->GetUartErrorStats(&stats, false);
+    snprintf(infoText, sizeof(infoText), "%u FIFO ovf %u buf full %u errors", (unsigned)stats.fifoOverflows,
+             (unsigned)stats.bufferFull, (unsigned)stats.frameErrors);
+    return infoText;
+}
+
+static const char *infoHandsetSearch()
+{
+    crsfAutobaudStats_t stats;
+    handset->GetAutobaudStats(&stats, false);
+    snprintf(infoText, sizeof(infoText), "%u/%u found, 1st frame %ums (%u-%u) %u bauds %u false", (unsigned)stats.found,
+             (unsigned)stats.searches, (unsigned)(stats.lastUS / 1000), (unsigned)(stats.minUS / 1000),
+             (unsigned)(stats.maxUS / 1000), (unsigned)stats.baudSwitches, (unsigned)stats.falseLocks);
+    return infoText;
+}
+
+static const char *infoHalfDuplex()
+{
+    if (!CRSFHandset::isHalfDuplex())
+        return "full duplex";
+    crsfHalfDuplexStats_t stats;
+    handset->GetHalfDuplexStats(&stats, false);
+    snprintf(infoText, sizeof(infoText), "%u bursts %u TX-done t/o, window %u.%u%% max %u.%u%%, p99 %uus",
+             (unsigned)stats.bursts, (unsigned)stats.txDoneTimeouts, (unsigned)(stats.windowAvgPermille / 10),
+             (unsigned)(stats.windowAvgPermille % 10), (unsigned)(stats.windowMaxPermille / 10),
+             (unsigned)(stats.windowMaxPermille % 10), (unsigned)p99US(latencyTurnaround));
+    return infoText;
+}
+
+static const char *infoTelemetry()
+{
+    crsfTelemetryStats_t stats[telemetryClassCount];
+    handset->GetTelemetryStats(stats, false);
+    snprintf(infoText, sizeof(infoText), "sent/dropped sync %u/%u link %u/%u info %u/%u fwd %u/%u",
+             (unsigned)stats[telemetryTiming].sent, (unsigned)stats[telemetryTiming].dropped,
+             (unsigned)stats[telemetryLinkStats].sent, (unsigned)stats[telemetryLinkStats].dropped,
+             (unsigned)stats[telemetryDeviceInfo].sent, (unsigned)stats[telemetryDeviceInfo].dropped,
+             (unsigned)stats[telemetryForwarded].sent, (unsigned)stats[telemetryForwarded].dropped);
+    return infoText;
+}
+
+static const char *infoPhyRate()
+{
+    phyRateStats_t stats;
+    getPhyRateStats(&stats, false);
+    snprintf(infoText, sizeof(infoText), "%ukbit/s %s, %u down %u up %u failed", stats.kbps, stats.adaptive ? "auto" : "fixed",
+             (unsigned)stats.stepsDown, (unsigned)stats.stepsUp, (unsigned)stats.failedProbes);
+    return infoText;
+}
+
+static const char *infoModelSwitch()
+{
+    modelSwitchStats_t stats;
+    getModelSwitchStats(&stats, false);
+    snprintf(infoText, sizeof(infoText), "%u switches last %u avg %u max %uus, peers %u hit %u miss %u evicted",
+             (unsigned)stats.switches, (unsigned)stats.lastUS, (unsigned)stats.avgUS, (unsigned)stats.maxUS,
+             (unsigned)stats.peerHits, (unsigned)stats.peerMisses, (unsigned)stats.peerEvictions);
+    return infoText;
+}
+
+// CPU load since the previous read of the field, so the window stays short; free stack since boot
+static const char *infoTasks()
+{
+    taskStats_t stats[4];
+    const uint8_t count = getTaskStats(stats, 4, true);
+    char *pos = infoText;
+    const char *end = infoText + sizeof(infoText);
+    *pos = 0;
+    for (uint8_t n = 0; n < count && pos < end; n++)
+    {
+        pos += snprintf(pos, end - pos, n ? ", %s %u.%u%%" : "%s %u.%u%%", stats[n].name, stats[n].loadPermille / 10, stats[n].loadPermille % 10);
+        if (stats[n].stackFreeBytes && pos < end)
+            pos += snprintf(pos, end - pos, " %uB", (unsigned)stats[n].stackFreeBytes);
+    }
+    return infoText;
+}
@@ -0,0 +1,72 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#pragma once
+#pragma once
+
+#include <stdint.h>
+#include "CRSFHandset.h"
+#include "Settings.h"
+
+/**
+ * @brief What a menu change needs from the firmware outside of the settings: main.cpp owns the radio channel,
+ * the ESP-NOW peers and the send path, and applies the values the menu stores
+ */
+typedef struct
+{
+    bool (*setWifiChannel)(uint8_t channel);                  // move the radio and the registered receivers, false if the radio did not
+    void (*setPayload)(bool legacy);                          // txSettings_t::legacyPayload
+    void (*setPhyRate)(uint8_t phyRate);                      // txSettings_t::phyRate
+    bool (*isConvoy)(uint8_t modelid);                        // the model number selects the convoy, Bind needs a single model
+    void (*bindReceiver)(uint8_t modelid, const uint8_t *mac); // store the receiver Bind heard for the model, register it as a peer
+} parameterMenuHooks_t;
+
+/**
+ * @brief The module's parameter menu on the radio: the link settings, Bind and the statistics since boot.
+ *
+ * Every change takes effect at once and is saved from loop() shortly after (Settings::commit()). The fields are read
+ * and written in the handset context, as the model selection.
+ */
+class ParameterMenu
+{
+public:
+    /**
+     * @brief Load the settings last saved from the menu, values not (or no longer) supported fall back to the defaults,
+     * and register the menu with CRSFParameters
+     * @return the settings to start with
+     */
+    static const txSettings_t &begin(CRSFHandset *handset, const parameterMenuHooks_t &hooks, const txSettings_t &defaults);
+
+    /**
+     * @return the CRSF power index of the TX power set, reported in the link statistics
+     */
+    static uint8_t getCrsfTxPower();
+
+    /**
+     * @brief Take a frame from a receiver, called from the ESP-NOW receive callback (the WiFi task).
+     * A receiver in bind mode broadcasts its own MAC address, the first one heard while Bind runs is kept.
+     */
+    static void onReceive(const uint8_t *mac, const uint8_t *data, int len);
+
+    /**
+     * @brief Store the receiver heard by Bind once its frame arrived or the time ran out, for the model selected when
+     * Bind started. Polled by the radio through the Bind field, called as well when the handset selected another model.
+     */
+    static void applyBind();
+};
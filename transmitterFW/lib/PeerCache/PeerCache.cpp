@@ -0,0 +1,131 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "PeerCache.h"
+
+// Holds the mutex of a PeerCache until the end of the scope
+class PeerCacheLock
+{
+public:
+    explicit PeerCacheLock(SemaphoreHandle_t mutex) : mutex(mutex) { xSemaphoreTake(mutex, portMAX_DELAY); }
+    ~PeerCacheLock() { xSemaphoreGive(mutex); }
+
+private:
+    SemaphoreHandle_t mutex;
+};
+
+void PeerCache::begin(uint8_t channel)
+{
+    if (!lock)
+        lock = xSemaphoreCreateMutex();
+    PeerCacheLock guard(lock);
+    wifiChannel = channel;
+}
+
+bool PeerCache::contains(const uint8_t *mac)
+{
+    PeerCacheLock guard(lock);
+    return find(mac) >= 0;
+}
+
+int PeerCache::find(const uint8_t *mac) const
+{
+    for (int i = 0; i < ESPNOW_PEER_CACHE_SIZE; i++)
+    {
+        if (entries[i].lastUsed && memcmp(entries[i].mac, mac, 6) == 0)
+            return i;
+    }
+    return -1;
+}
+
+bool PeerCache::use(const uint8_t *mac)
+{
+    PeerCacheLock guard(lock);
+    int i = find(mac);
+    if (i >= 0)
+    {
+        stats.hits++;
+        entries[i].lastUsed = ++useCounter;
+        return true;
+    }
+    stats.misses++;
+
+    // A free entry, else the least recently used one
+    i = 0;
+    for (int n = 1; n < ESPNOW_PEER_CACHE_SIZE; n++)
+    {
+        if (entries[n].lastUsed < entries[i].lastUsed)
+            i = n;
+    }
+    if (entries[i].lastUsed)
+    {
+        esp_now_del_peer(entries[i].mac);
+        entries[i].lastUsed = 0;
+        stats.evictions++;
+    }
+
+    esp_now_peer_info_t peerInfo;
+    memset(&peerInfo, 0, sizeof(esp_now_peer_info_t));
+    peerInfo.channel = wifiChannel;
+    peerInfo.encrypt = false;
+    memcpy(peerInfo.peer_addr, mac, 6);
+    if (esp_now_add_peer(&peerInfo) != ESP_OK)
+    {
+        stats.errors++;
+        return false;
+    }
+    memcpy(entries[i].mac, mac, 6);
+    entries[i].lastUsed = ++useCounter;
+    return true;
+}
+
+bool PeerCache::remove(const uint8_t *mac)
+{
+    PeerCacheLock guard(lock);
+    int i = find(mac);
+    if (i < 0)
+        return false;
+    esp_now_del_peer(entries[i].mac);
+    entries[i].lastUsed = 0;
+    return true;
+}
+
+bool PeerCache::setChannel(uint8_t channel)
+{
+    PeerCacheLock guard(lock);
+    wifiChannel = channel;
+    bool ok = true;
+    for (entry_t &entry : entries)
+    {
+        if (!entry.lastUsed)
+            continue;
+        esp_now_peer_info_t peerInfo;
+        memset(&peerInfo, 0, sizeof(esp_now_peer_info_t));
+        peerInfo.channel = wifiChannel;
+        peerInfo.encrypt = false;
+        memcpy(peerInfo.peer_addr, entry.mac, 6);
+        if (esp_now_mod_peer(&peerInfo) != ESP_OK)
+        {
+            esp_now_del_peer(entry.mac); // registered again when next used
+            entry.lastUsed = 0;
+            stats.errors++;
+            ok = false;
+        }
+    }
+    return ok;
+}
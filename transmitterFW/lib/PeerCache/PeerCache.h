@@ -0,0 +1,93 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <esp_now.h>
+#include "common.h"
+
+#ifndef ESPNOW_PEER_CACHE_SIZE
+#define ESPNOW_PEER_CACHE_SIZE 16 // receivers registered with ESP-NOW at a time
+#endif
+
+static_assert(ESPNOW_PEER_CACHE_SIZE >= 1 && ESPNOW_PEER_CACHE_SIZE < ESP_NOW_MAX_TOTAL_PEER_NUM,
+              "the peer cache must leave room for the broadcast peer");
+
+typedef struct
+{
+    uint32_t hits;      // the receiver was still registered
+    uint32_t misses;    // the receiver had to be registered
+    uint32_t evictions; // the least recently used receiver was removed to make room
+    uint32_t errors;    // esp_now_add_peer() failed
+} peerCacheStats_t;
+
+/**
+ * @brief Keeps the most recently used receivers registered as ESP-NOW peers, so the model table is
+ * not limited by the size of the ESP-NOW peer table.
+ * The methods serialize on a mutex, for the model selection in the handset context and the retries from loop().
+ * Not to be used from an ISR.
+ */
+class PeerCache
+{
+public:
+    /**
+     * @param channel the WiFi channel of the peers
+     */
+    void begin(uint8_t channel);
+
+    /**
+     * @brief Move the registered receivers to another WiFi channel, after the radio changed to it
+     * @return false if a receiver could not be moved, it is unregistered then
+     */
+    bool setChannel(uint8_t channel);
+
+    /**
+     * @brief Make the receiver a registered ESP-NOW peer, evicting the least recently used one if the cache is full
+     * @return true if the receiver is registered
+     */
+    bool use(const uint8_t *mac);
+
+    /**
+     * @brief Unregister the receiver, after the model table no longer refers to it
+     * @return true if the receiver was registered
+     */
+    bool remove(const uint8_t *mac);
+
+    /**
+     * @return true if the receiver is currently registered
+     */
+    bool contains(const uint8_t *mac);
+
+    const peerCacheStats_t &getStats() const { return stats; }
+
+private:
+    struct entry_t
+    {
+        uint8_t mac[6];
+        uint32_t lastUsed; // value of useCounter at the last use, 0 for a free entry
+    };
+
+    entry_t entries[ESPNOW_PEER_CACHE_SIZE] = {};
+    uint32_t useCounter = 0;
+    uint8_t wifiChannel = 1;
+    peerCacheStats_t stats = {};
+    SemaphoreHandle_t lock = nullptr;
+
+    int find(const uint8_t *mac) const;
+};
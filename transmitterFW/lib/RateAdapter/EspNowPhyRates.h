@@ -0,0 +1,55 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <esp_wifi.h>
+#include <esp_now.h>
+
+/* The ESP-NOW PHY rates, ordered from the most robust to the fastest: the ladder of RateAdapter.
+   802.11 LR (250 and 500 kbit/s) is an Espressif mode, the receivers must have it enabled to hear it. */
+
+typedef struct
+{
+    uint16_t kbps;
+    wifi_phy_mode_t mode;
+    wifi_phy_rate_t rate;
+} espnowPhyRate_t;
+
+static constexpr espnowPhyRate_t espnowPhyRates[] = {
+    {250, WIFI_PHY_MODE_LR, WIFI_PHY_RATE_LORA_250K},
+    {500, WIFI_PHY_MODE_LR, WIFI_PHY_RATE_LORA_500K},
+    {1000, WIFI_PHY_MODE_11B, WIFI_PHY_RATE_1M_L}, // the ESP-NOW default
+    {2000, WIFI_PHY_MODE_11B, WIFI_PHY_RATE_2M_L},
+    {6000, WIFI_PHY_MODE_11G, WIFI_PHY_RATE_6M},
+    {12000, WIFI_PHY_MODE_11G, WIFI_PHY_RATE_12M},
+    {24000, WIFI_PHY_MODE_11G, WIFI_PHY_RATE_24M},
+    {54000, WIFI_PHY_MODE_11G, WIFI_PHY_RATE_54M},
+};
+
+static constexpr uint8_t espnowPhyRateCount = sizeof(espnowPhyRates) / sizeof(espnowPhyRates[0]);
+
+/**
+ * @return the index of the rate of `kbps` in espnowPhyRates, -1 if there is none
+ */
+static constexpr int espnowPhyRateIndex(uint16_t kbps, uint8_t n = 0)
+{
+    return n == espnowPhyRateCount ? -1 : espnowPhyRates[n].kbps == kbps ? n : espnowPhyRateIndex(kbps, n + 1);
+}
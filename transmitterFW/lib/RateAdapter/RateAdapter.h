@@ -0,0 +1,167 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef ESPNOW_RATE_WINDOW
+#define ESPNOW_RATE_WINDOW 20 // send results per decision
+#endif
+#ifndef ESPNOW_RATE_DOWN_PERCENT
+#define ESPNOW_RATE_DOWN_PERCENT 10 // lost frames in a window that move down to the next more robust rate
+#endif
+#ifndef ESPNOW_RATE_DOWN_BURST
+#define ESPNOW_RATE_DOWN_BURST 3 // consecutive lost frames that move down at once, without waiting for the window to end
+#endif
+#ifndef ESPNOW_RATE_UP_WINDOWS
+#define ESPNOW_RATE_UP_WINDOWS 5 // windows without a lost frame before the next faster rate is tried
+#endif
+#ifndef ESPNOW_RATE_UP_BACKOFF
+#define ESPNOW_RATE_UP_BACKOFF 8 // a faster rate that failed right away is tried again after up to this many times as many windows
+#endif
+
+typedef struct
+{
+    uint32_t stepsDown;    // moves to a more robust rate
+    uint32_t stepsUp;      // moves to a faster rate
+    uint32_t failedProbes; // moves up that were taken back within their first window
+} rateAdapterStats_t;
+
+/**
+ * @brief Picks the PHY rate from the ESP-NOW send results (acknowledged or not) of the frames sent at it,
+ * along a ladder of rates ordered from the most robust to the fastest. Works on ladder indices only, the
+ * caller maps them to PHY rates.
+ *
+ * Moves down on ESPNOW_RATE_DOWN_BURST lost frames in a row or ESPNOW_RATE_DOWN_PERCENT lost frames in a
+ * window, moves up after ESPNOW_RATE_UP_WINDOWS windows without a lost frame. A move up that is taken back
+ * within its first window doubles the clean windows needed before the next try (AARF), any other move down
+ * resets them.
+ * Not thread safe, add() is called from one context (the send callback), getRate() may be read from any.
+ */
+class RateAdapter
+{
+public:
+    /**
+     * @param lowest the most robust rate to use, an index into the caller's ladder
+     * @param highest the fastest rate to use
+     * @param start the rate to start at
+     */
+    void begin(uint8_t lowest, uint8_t highest, uint8_t start)
+    {
+        low = lowest;
+        high = highest < lowest ? lowest : highest;
+        rate = start < low ? low : start > high ? high : start;
+        upWindows = ESPNOW_RATE_UP_WINDOWS;
+        restart();
+    }
+
+    /**
+     * @brief Record the result of a frame sent at getRate()
+     */
+    void add(bool success)
+    {
+        results++;
+        if (success)
+        {
+            burst = 0;
+        }
+        else
+        {
+            losses++;
+            burst++;
+        }
+
+        if (rate > low && burst >= ESPNOW_RATE_DOWN_BURST)
+        {
+            stepDown();
+            return;
+        }
+        if (results < ESPNOW_RATE_WINDOW)
+            return;
+
+        if (rate > low && losses * 100 >= ESPNOW_RATE_DOWN_PERCENT * results)
+        {
+            stepDown();
+            return;
+        }
+        cleanWindows = losses ? 0 : cleanWindows + 1;
+        probing = false; // a move up survived its first window
+        if (rate < high && cleanWindows >= upWindows)
+        {
+            rate++;
+            stats.stepsUp++;
+            restart();
+            probing = true;
+            return;
+        }
+        results = 0;
+        losses = 0;
+    }
+
+    /**
+     * @return the ladder index of the rate to send at
+     */
+    uint8_t getRate() const { return rate; }
+
+    void getStats(rateAdapterStats_t *out, bool reset)
+    {
+        *out = stats;
+        if (reset)
+            stats = {};
+    }
+
+private:
+    uint8_t low = 0;
+    uint8_t high = 0;
+    volatile uint8_t rate = 0;
+    uint8_t results = 0;      // in the current window
+    uint8_t losses = 0;
+    uint8_t burst = 0;        // lost frames in a row
+    uint16_t cleanWindows = 0; // windows in a row without a lost frame
+    uint16_t upWindows = ESPNOW_RATE_UP_WINDOWS;
+    bool probing = false;     // within the first window after a move up
+    rateAdapterStats_t stats = {};
+
+    void stepDown()
+    {
+        if (probing)
+        {
+            stats.failedProbes++;
+            if (upWindows < ESPNOW_RATE_UP_WINDOWS * ESPNOW_RATE_UP_BACKOFF)
+                upWindows *= 2;
+        }
+        else
+        {
+            upWindows = ESPNOW_RATE_UP_WINDOWS;
+        }
+        rate--;
+        stats.stepsDown++;
+        restart();
+    }
+
+    void restart()
+    {
+        results = 0;
+        losses = 0;
+        burst = 0;
+        cleanWindows = 0;
+        probing = false;
+    }
+};
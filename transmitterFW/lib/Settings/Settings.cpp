@@ -0,0 +1,74 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "Settings.h"
+#include <Arduino.h>
+#include <Preferences.h>
+
+static constexpr const char *nvsNamespace = "settings";
+
+txSettings_t Settings::settings = {};
+volatile bool Settings::dirty = false;
+volatile uint32_t Settings::changedMS = 0;
+
+const txSettings_t &Settings::begin(const txSettings_t &defaults)
+{
+    settings = defaults;
+
+    Preferences prefs;
+    if (prefs.begin(nvsNamespace, true))
+    {
+        txSettings_t stored;
+        if (prefs.getBytesLength("tx") == sizeof(stored) && prefs.getBytes("tx", &stored, sizeof(stored)) == sizeof(stored))
+        {
+            settings = stored;
+        }
+        prefs.end();
+    }
+    return settings;
+}
+
+bool Settings::save(const txSettings_t &changed)
+{
+    settings = changed;
+
+    Preferences prefs;
+    if (!prefs.begin(nvsNamespace, false))
+        return false;
+    bool ok = prefs.putBytes("tx", &settings, sizeof(settings)) == sizeof(settings);
+    prefs.end();
+    return ok;
+}
+
+void Settings::update(const txSettings_t &changed)
+{
+    settings = changed;
+    changedMS = millis();
+    dirty = true;
+}
+
+bool Settings::commit()
+{
+    if (!dirty || millis() - changedMS < SETTINGS_COMMIT_DELAY_MS)
+        return false;
+    // Cleared before the copy: an update() racing with it marks the settings dirty again and they are written once more
+    dirty = false;
+    const txSettings_t changed = settings;
+    return save(changed);
+}
@@ -0,0 +1,80 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef SETTINGS_COMMIT_DELAY_MS
+#define SETTINGS_COMMIT_DELAY_MS 1000 // settings changed from the radio are written to flash after this long without another change
+#endif
+
+/**
+ * @brief The link settings that can be changed at runtime from the radio's parameter menu
+ */
+typedef struct
+{
+    uint32_t packetIntervalUS; // one of RFpacketIntervalsUS
+    uint8_t wifiChannel;
+    int8_t txPower;            // wifi_power_t, in 0.25 dBm
+    uint8_t legacyPayload;     // send the legacy 32-byte frames instead of the versioned ones
+    uint8_t phyRate;           // ESP-NOW PHY rate, the index into espnowPhyRates + 1, 0 to adapt it to the link
+} txSettings_t;
+
+/**
+ * @brief The link settings, the compiled defaults overlaid by the ones last saved to NVS.
+ * The caller checks the values, the settings are stored as they are given.
+ *
+ * A flash write stalls the cache of both cores, so changes made while RC frames arrive go through update(),
+ * which only marks the settings dirty, and are written by commit() from loop() once the radio is quiet.
+ */
+class Settings
+{
+public:
+    /**
+     * @brief Load the settings saved to NVS, the defaults if there are none (or of an older layout)
+     */
+    static const txSettings_t &begin(const txSettings_t &defaults);
+
+    static const txSettings_t &get() { return settings; }
+
+    /**
+     * @brief Replace and persist the settings
+     * @return false if NVS could not be written, the settings are in use nonetheless
+     */
+    static bool save(const txSettings_t &changed);
+
+    /**
+     * @brief Replace the settings at once, persist them later with commit()
+     * May be called from another context than commit() (the handset RX task).
+     */
+    static void update(const txSettings_t &changed);
+
+    /**
+     * @brief Persist the settings changed by update() once SETTINGS_COMMIT_DELAY_MS passed without another change,
+     * called from loop()
+     * @return true if the settings were written
+     */
+    static bool commit();
+
+private:
+    static txSettings_t settings;
+    static volatile bool dirty;
+    static volatile uint32_t changedMS;
+};
@@ -0,0 +1,74 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include "common.h"
+
+/**
+ * CPU load of one task (or ISR): the time it was busy, between start() and stop(), over a measurement window.
+ * start() and stop() must only be called from the task itself. read() may be called from any other context,
+ * a reset is carried out by the next stop().
+ * The busy time is a 32-bit count, read in one access on any core: it holds a window of up to 71 minutes of
+ * busy time, so windows (the time between two resets) should be kept below that at full load.
+ */
+class TaskLoad
+{
+public:
+    void ICACHE_RAM_ATTR start() { startUS = micros(); }
+
+    void ICACHE_RAM_ATTR stop()
+    {
+        if (resetRequested)
+        {
+            busyUS = 0;
+            runs = 0;
+            resetRequested = false;
+        }
+        busyUS += micros() - startUS;
+        runs++;
+    }
+
+    /**
+     * @return the busy share of the window in 0.1 %
+     * @param runsOut receives the number of runs in the window
+     * @param reset start a new window
+     */
+    uint16_t read(uint32_t *runsOut, bool reset)
+    {
+        const uint32_t now = millis();
+        const uint64_t windowUS = (uint64_t)(now - windowStartMS) * 1000;
+        const uint32_t busy = resetRequested ? 0 : busyUS;
+        *runsOut = resetRequested ? 0 : runs;
+        if (reset)
+        {
+            windowStartMS = now;
+            resetRequested = true;
+        }
+        return windowUS ? (uint16_t)std::min((uint64_t)1000, (uint64_t)busy * 1000 / windowUS) : 0;
+    }
+
+private:
+    uint32_t startUS = 0;
+    volatile uint32_t busyUS = 0; // in the window, 32 bits so the other core never reads half an update
+    volatile uint32_t runs = 0;
+    uint32_t windowStartMS = 0;
+    volatile bool resetRequested = false;
+};
@@ -0,0 +1,93 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+/// Helpers shared by the host benchmarks ///
+
+typedef std::chrono::steady_clock benchClock;
+
+static inline double benchSecondsSince(benchClock::time_point start)
+{
+    return std::chrono::duration<double>(benchClock::now() - start).count();
+}
+
+// Finer grained than benchClock where available, for timing short calls
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t benchCycles() { return __rdtsc(); }
+static constexpr const char *benchCycleUnit = "TSC ticks";
+#else
+static inline uint64_t benchCycles() { return std::chrono::duration_cast<std::chrono::nanoseconds>(benchClock::now().time_since_epoch()).count(); }
+static constexpr const char *benchCycleUnit = "ns";
+#endif
+
+/**
+ * @brief Build a CRSF RC channels frame as sent by EdgeTX to the module.
+ * @param channels 16 channel values, 11 bits each
+ */
+void benchMakeRcFrame(std::vector<uint8_t> &stream, const uint16_t *channels);
+
+/**
+ * @brief Build the CRSF command EdgeTX sends to select the receiver (model) number.
+ */
+void benchMakeModelSelect(std::vector<uint8_t> &stream, uint8_t modelid);
+
+/**
+ * @brief Build a synthetic handset stream of RC frames with an occasional device ping.
+ * Channel 1 carries a rolling sequence number (CRSF_CHANNEL_VALUE_MIN + n % benchSeqSpan) so
+ * lost frames can be detected by the consumer, channel 16 the number of completed spans, see benchFrameIndex().
+ * @param frameEnds if given, receives the stream offset just past every RC frame
+ */
+std::vector<uint8_t> benchMakeHandsetStream(uint32_t frames, std::vector<uint32_t> *frameEnds = nullptr);
+static constexpr uint16_t benchSeqSpan = 1640;
+
+/**
+ * @return the index of a synthetic stream frame from its channel values, -1 if the channels do not hold one
+ */
+static inline int32_t benchFrameIndex(uint16_t ch1, uint16_t ch16)
+{
+    if (ch1 < 172 || ch16 < 172)
+        return -1;
+    return (ch16 - 172) * benchSeqSpan + (ch1 - 172);
+}
+
+/**
+ * @brief Read a recorded raw CRSF byte stream (e.g. a logic analyser export), returns false on error.
+ */
+bool benchLoadStream(const char *path, std::vector<uint8_t> &stream);
+
+/// Benchmarks, each invoked as `bench <name> [args]` ///
+
+int benchHandset(int argc, char **argv);
+int benchParser(int argc, char **argv);
+int benchUnpack(int argc, char **argv);
+int benchFifo(int argc, char **argv);
+int benchCrc(int argc, char **argv);
+int benchModels(int argc, char **argv);
+int benchLatency(int argc, char **argv);
+int benchSync(int argc, char **argv);
+int benchSnapshot(int argc, char **argv);
+int benchReconnect(int argc, char **argv);
+int benchTelemetry(int argc, char **argv);
+int benchParams(int argc, char **argv);
+int benchPhyRate(int argc, char **argv);
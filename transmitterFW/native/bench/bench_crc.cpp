@@ -0,0 +1,245 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* GENERIC_CRC8 and Crc2Byte: byte-wise vs. slice-by-4 and slice-by-8.
+   All paths are first checked against a bit-by-bit CRC (and Crc2Byte against the byte table
+   implementation it replaced) on the standard check string and on random buffers, lengths and
+   initial values, then timed at frame lengths seen on the CRSF link. The paths beyond CRC_SLICES are skipped.
+ */
+
+#include <stdio.h>
+#include <random>
+#include "bench.h"
+#include "CRSF.h"
+
+// MSB first, no reflection, no final xor: the CRCs both classes implement
+static uint16_t crcBitwise(uint8_t bits, uint16_t poly, const uint8_t *data, uint16_t len, uint16_t crc)
+{
+    const uint16_t highbit = 1 << (bits - 1);
+    const uint16_t mask = (1 << bits) - 1;
+    while (len--)
+    {
+        uint8_t byte = *data++;
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            bool bit = ((crc & highbit) != 0) ^ ((byte & 0x80) != 0);
+            crc = (crc << 1) & mask;
+            if (bit) crc ^= poly;
+            byte <<= 1;
+        }
+    }
+    return crc & mask;
+}
+
+// Crc2Byte before the slice tables
+class Crc2ByteLegacy
+{
+private:
+    uint16_t _crctab[crclen];
+    uint8_t _bits;
+    uint16_t _bitmask;
+
+public:
+    Crc2ByteLegacy(uint8_t bits, uint16_t poly)
+    {
+        _bits = bits;
+        _bitmask = (1 << _bits) - 1;
+        uint16_t highbit = 1 << (_bits - 1);
+        for (uint16_t i = 0; i < crclen; i++)
+        {
+            uint16_t crc = i << (bits - 8);
+            for (uint8_t j = 0; j < 8; j++)
+            {
+                crc = (crc << 1) ^ ((crc & highbit) ? poly : 0);
+            }
+            _crctab[i] = crc;
+        }
+    }
+
+    uint16_t calc(const uint8_t *data, uint8_t len, uint16_t crc)
+    {
+        while (len--)
+        {
+            crc = (crc << 8) ^ _crctab[((crc >> (_bits - 8)) ^ (uint16_t) *data++) & 0x00FF];
+        }
+        return crc & _bitmask;
+    }
+};
+
+struct crc2Config_t
+{
+    uint8_t bits;
+    uint16_t poly;
+};
+
+// CRC-8/DVB-S2 (CRSF), 10, 12 and 14 bits (ExpressLRS OTA), CRC-16/XMODEM
+static constexpr crc2Config_t crc2Configs[] = {{8, 0xD5}, {10, 0x233}, {12, 0x80F}, {14, 0x2E57}, {16, 0x1021}};
+
+static constexpr Crc2Byte crc14(14, 0x2E57);
+static constexpr GENERIC_CRC8 cmd_crc(0xBA);
+
+static bool fail(const char *what, uint16_t len, uint32_t expected, uint32_t got)
+{
+    printf("MISMATCH %s, length %u: expected 0x%04X, got 0x%04X\n", what, len, expected, got);
+    return false;
+}
+
+// The slice-by-N paths only exist with CRC_SLICES >= N, the others pass
+template <unsigned SLICES>
+static bool checkCrc8(const char *what, const GENERIC_CRC8 &crc8, const uint8_t *data, uint16_t len, uint8_t init, uint8_t expected)
+{
+    if constexpr (SLICES <= CRC_SLICES)
+    {
+        if (crc8.calc<SLICES>(data, len, init) != expected) return fail(what, len, expected, crc8.calc<SLICES>(data, len, init));
+    }
+    return true;
+}
+
+template <unsigned SLICES>
+static bool checkCrc2(const char *what, const Crc2Byte &crc2, const uint8_t *data, uint8_t len, uint16_t init, uint16_t expected)
+{
+    if constexpr (SLICES <= CRC_SLICES)
+    {
+        if (crc2.calc<SLICES>(data, len, init) != expected) return fail(what, len, expected, crc2.calc<SLICES>(data, len, init));
+    }
+    return true;
+}
+
+static bool checkEquivalence(std::mt19937 &rng, uint32_t &checked)
+{
+    const uint8_t check[] = "123456789";
+    const uint16_t checkLen = sizeof(check) - 1;
+    if (crsf_crc.calc(check, checkLen) != 0xBC)
+        return fail("CRC-8/DVB-S2 check value", checkLen, 0xBC, crsf_crc.calc(check, checkLen));
+
+    uint8_t data[256];
+    for (uint32_t n = 0; n < 100000; n++)
+    {
+        const uint16_t len = rng() % (n < 50000 ? 80 : sizeof(data));
+        for (uint16_t i = 0; i < len; i++) data[i] = rng();
+        const uint8_t init = rng();
+
+        for (const GENERIC_CRC8 *crc8 : {&crsf_crc, &cmd_crc})
+        {
+            const uint8_t poly = crc8 == &crsf_crc ? CRSF_CRC_POLY : 0xBA;
+            const uint8_t expected = crcBitwise(8, poly, data, len, init);
+            if (!checkCrc8<1>("GENERIC_CRC8 byte-wise", *crc8, data, len, init, expected)) return false;
+            if (!checkCrc8<4>("GENERIC_CRC8 slice-by-4", *crc8, data, len, init, expected)) return false;
+            if (!checkCrc8<8>("GENERIC_CRC8 slice-by-8", *crc8, data, len, init, expected)) return false;
+            checked++;
+        }
+    }
+
+    Crc2Byte crc2;
+    for (const auto &config : crc2Configs)
+    {
+        crc2.init(config.bits, config.poly);
+        Crc2ByteLegacy legacy(config.bits, config.poly);
+        for (uint32_t n = 0; n < 20000; n++)
+        {
+            const uint8_t len = rng() % (n < 10000 ? 80 : 256);
+            for (uint16_t i = 0; i < len; i++) data[i] = rng();
+            const uint16_t init = rng(); // bits above the CRC width are ignored by both
+
+            const uint16_t expected = crcBitwise(config.bits, config.poly, data, len, init & ((1 << config.bits) - 1));
+            if (legacy.calc(data, len, init) != expected) return fail("Crc2Byte legacy", len, expected, legacy.calc(data, len, init));
+            if (!checkCrc2<1>("Crc2Byte byte-wise", crc2, data, len, init, expected)) return false;
+            if (!checkCrc2<4>("Crc2Byte slice-by-4", crc2, data, len, init, expected)) return false;
+            if (!checkCrc2<8>("Crc2Byte slice-by-8", crc2, data, len, init, expected)) return false;
+            checked++;
+        }
+    }
+    if (crc14.calc(data, 100, 0) != crcBitwise(14, 0x2E57, data, 100, 0))
+        return fail("constexpr Crc2Byte", 100, crcBitwise(14, 0x2E57, data, 100, 0), crc14.calc(data, 100, 0));
+    return true;
+}
+
+static volatile uint16_t sink;
+
+template <class F>
+static void timeCrc(const char *name, uint16_t len, const std::vector<uint8_t> &buffer, uint32_t rounds, F calc)
+{
+    const uint32_t frames = buffer.size() / len;
+    uint16_t acc = 0;
+    auto start = benchClock::now();
+    uint64_t cycles = benchCycles();
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (uint32_t f = 0; f < frames; f++)
+        {
+            acc ^= calc(&buffer[f * len], len);
+        }
+    }
+    cycles = benchCycles() - cycles;
+    double seconds = benchSecondsSince(start);
+    sink = acc;
+    double calls = (double)rounds * frames;
+    printf("%-14s %6u %10.2f %12.1f %10.0f\n", name, len, seconds * 1e9 / calls, cycles / calls, calls * len / seconds / 1e6);
+}
+
+// Time the slice-by-N paths of both CRCs, n/a for the ones not built with CRC_SLICES
+template <unsigned SLICES>
+static void timeCrc8(uint16_t len, const std::vector<uint8_t> &buffer, uint32_t rounds)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "crc8 x%u", SLICES);
+    if constexpr (SLICES <= CRC_SLICES)
+        timeCrc(name, len, buffer, rounds, [](const uint8_t *d, uint16_t l) { return crsf_crc.calc<SLICES>(d, l); });
+    else
+        printf("%-14s %6u %10s %12s %10s\n", name, len, "n/a", "n/a", "n/a");
+}
+
+template <unsigned SLICES>
+static void timeCrc14(uint16_t len, const std::vector<uint8_t> &buffer, uint32_t rounds)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "crc14 x%u", SLICES);
+    if constexpr (SLICES <= CRC_SLICES)
+        timeCrc(name, len, buffer, rounds, [](const uint8_t *d, uint16_t l) { return crc14.calc<SLICES>(d, l, 0); });
+    else
+        printf("%-14s %6u %10s %12s %10s\n", name, len, "n/a", "n/a", "n/a");
+}
+
+int benchCrc(int argc, char **argv)
+{
+    uint32_t rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    std::mt19937 rng(1);
+
+    uint32_t checked = 0;
+    if (!checkEquivalence(rng, checked))
+    {
+        return 1;
+    }
+    printf("GENERIC_CRC8 and Crc2Byte up to slice-by-%u (CRC_SLICES) match the bit-by-bit CRC on %u buffers\n\n", CRC_SLICES, checked);
+
+    std::vector<uint8_t> buffer(16384);
+    for (auto &b : buffer) b = rng();
+
+    // 4: device ping, 24: RC channels frame (type + payload), 62: largest CRSF frame
+    printf("%-14s %6s %10s %12s %10s\n", "crc", "bytes", "ns/call", benchCycleUnit, "MB/s");
+    for (uint16_t len : {4, 24, 62})
+    {
+        timeCrc8<1>(len, buffer, rounds);
+        timeCrc8<4>(len, buffer, rounds);
+        timeCrc8<8>(len, buffer, rounds);
+        timeCrc14<1>(len, buffer, rounds);
+        timeCrc14<4>(len, buffer, rounds);
+        timeCrc14<8>(len, buffer, rounds);
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* FIFO<> (locked) vs. LockFreeFIFO<> with length-prefixed packets, the way SerialOutFIFO is used.
+   "threads": a producer and a consumer thread, every packet's length and contents are verified by
+   the consumer, so this doubles as the stress test of the lock-free FIFO.
+   "single": push and pop from the same thread (the polling handset), measures the bare overhead.
+ */
+
+#include <stdio.h>
+#include <thread>
+#include "bench.h"
+#include "FIFO.h"
+#include "LockFreeFIFO.h"
+
+static constexpr uint32_t fifoSize = 256;
+static constexpr uint8_t maxPayload = 40;
+
+// Packet n: length byte (1 + n % maxPayload), then bytes n, n + 1, ...
+static uint8_t makePacket(uint32_t n, uint8_t *packet)
+{
+    uint8_t len = 1 + n % maxPayload;
+    packet[0] = len;
+    for (uint8_t i = 0; i < len; i++)
+    {
+        packet[1 + i] = (uint8_t)(n + i);
+    }
+    return len + 1;
+}
+
+template <class F>
+static bool tryPush(F &fifo, const uint8_t *packet, uint8_t len)
+{
+    fifo.lock();
+    bool ok = fifo.available(len);
+    if (ok)
+    {
+        fifo.pushBytes(packet, len);
+    }
+    fifo.unlock();
+    return ok;
+}
+
+// returns false if no packet was queued, sets `bad` when its contents are wrong
+template <class F>
+static bool tryPop(F &fifo, uint32_t n, bool &bad)
+{
+    uint8_t packet[maxPayload];
+    fifo.lock();
+    bool ok = fifo.size() > 0;
+    if (ok)
+    {
+        uint8_t len = fifo.pop();
+        fifo.popBytes(packet, len);
+        bad = len != 1 + n % maxPayload;
+        for (uint8_t i = 0; i < len && !bad; i++)
+        {
+            bad = packet[i] != (uint8_t)(n + i);
+        }
+    }
+    fifo.unlock();
+    return ok;
+}
+
+// The host may have fewer cores than threads, let the other side run
+static void backoff(uint64_t retries)
+{
+    if (retries % 16 == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+    else
+    {
+        std::this_thread::yield();
+    }
+}
+
+template <class F>
+static void runThreads(const char *name, uint32_t packets)
+{
+    static F fifo;
+    fifo.flush();
+    uint32_t errors = 0;
+    uint64_t pushRetries = 0;
+
+    auto start = benchClock::now();
+    std::thread producer([&]() {
+        uint8_t packet[maxPayload + 1];
+        for (uint32_t n = 0; n < packets; n++)
+        {
+            uint8_t len = makePacket(n, packet);
+            while (!tryPush(fifo, packet, len))
+            {
+                backoff(++pushRetries);
+            }
+        }
+    });
+    std::thread consumer([&]() {
+        for (uint32_t n = 0; n < packets; n++)
+        {
+            bool bad = false;
+            for (uint32_t retries = 1; !tryPop(fifo, n, bad); retries++)
+            {
+                backoff(retries);
+            }
+            if (bad) errors++;
+        }
+    });
+    producer.join();
+    consumer.join();
+    double seconds = benchSecondsSince(start);
+
+    printf("%-10s %-8s %10u %10.1f %12.0f %10llu %8u\n", name, "threads", packets, seconds * 1e9 / packets,
+           packets * (maxPayload / 2 + 1.5) / seconds / 1e6, (unsigned long long)pushRetries, errors);
+}
+
+template <class F>
+static void runSingle(const char *name, uint32_t packets)
+{
+    static F fifo;
+    fifo.flush();
+    uint32_t errors = 0;
+    uint8_t packet[maxPayload + 1];
+
+    auto start = benchClock::now();
+    for (uint32_t n = 0; n < packets; n++)
+    {
+        // a few packets queued at a time, as the handset does between two handleOutput() calls
+        tryPush(fifo, packet, makePacket(n, packet));
+        if (n % 4 == 3)
+        {
+            for (uint32_t m = n - 3; m <= n; m++)
+            {
+                bool bad = false;
+                if (!tryPop(fifo, m, bad) || bad) errors++;
+            }
+        }
+    }
+    double seconds = benchSecondsSince(start);
+
+    printf("%-10s %-8s %10u %10.1f %12.0f %10s %8u\n", name, "single", packets, seconds * 1e9 / packets,
+           packets * (maxPayload / 2 + 1.5) / seconds / 1e6, "-", errors);
+}
+
+int benchFifo(int argc, char **argv)
+{
+    uint32_t packets = argc > 1 ? atoi(argv[1]) : 2000000;
+    packets -= packets % 4;
+
+    printf("%u-byte FIFOs, length-prefixed packets of 2..%u bytes\n\n", fifoSize, maxPayload + 1);
+    printf("%-10s %-8s %10s %10s %12s %10s %8s\n", "fifo", "mode", "packets", "ns/packet", "MB/s", "full", "errors");
+    runSingle<FIFO<fifoSize>>("locked", packets);
+    runSingle<LockFreeFIFO<fifoSize>>("lock-free", packets);
+    runThreads<FIFO<fifoSize>>("locked", packets);
+    runThreads<LockFreeFIFO<fifoSize>>("lock-free", packets);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Handset input throughput benchmark.
+   The firmware runs unmodified: setup() once, then loop() is called while the CRSF byte stream is
+   delivered into the UART RX buffer at the line rate of the baud under test (baud / 10 bytes per
+   second of virtual time). The hwTimer fires from the virtual clock, so the ESP-NOW send path of
+   main.cpp is exercised as well. Only the host CPU time spent inside loop() is measured; with CRSF_RX_TASK the
+   bytes arrive while loop() waits, and the RX task they wake runs inside it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "bench.h"
+#include "common.h"
+#include "CRSF.h"
+#include "CRSFHandset.h"
+#include "NativeHAL.h"
+
+extern CRSFHandset *handset;
+void setup();
+void loop();
+
+static constexpr uint32_t benchStreamFrames = 20000;
+
+static uint32_t rcFrames;
+static void (*firmwareRcData)() = nullptr; // the firmware's own hook (ESPNOW_SEND_ON_ARRIVAL)
+
+static void countRcFrame()
+{
+    rcFrames++;
+    if (firmwareRcData) firmwareRcData();
+}
+
+int benchHandset(int argc, char **argv)
+{
+    std::vector<uint8_t> stream;
+    const char *capture = nullptr;
+    uint32_t rateHz = 1000000 / RF_FRAME_RATE_US;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            rateHz = atoi(argv[++i]);
+        else
+            capture = argv[i];
+    }
+    bool recorded = capture != nullptr;
+    if (recorded)
+    {
+        if (!benchLoadStream(capture, stream))
+        {
+            printf("Could not read CRSF capture '%s'\n", capture);
+            return 1;
+        }
+    }
+    else
+    {
+        stream = benchMakeHandsetStream(benchStreamFrames);
+    }
+
+    setup();
+    firmwareRcData = handset->getRCDataCallback();
+    handset->setRCDataCallback(countRcFrame);
+    loop(); // let the handset search start (it enables the autobaud measurement) before the stream starts
+
+    std::vector<int32_t> bauds(std::begin(CRSFHandset::TxToHandsetBauds), std::end(CRSFHandset::TxToHandsetBauds));
+    std::sort(bauds.begin(), bauds.end());
+
+    printf("CRSF stream: %u bytes (%s), delivered at line rate\n\n", (unsigned)stream.size(), recorded ? capture : "synthetic");
+    printf("%8s %8s %8s %8s %9s %7s %8s %12s %12s %10s %6s %7s %4s %8s\n",
+           "baud", "frames", "parsed", "lost", "rxDropped", "bufFull", "cpu ms", "frames/s", "bytes/s", "ns/frame", "load%", "espnow", "LQ", "rate Hz");
+
+    for (int32_t baud : bauds)
+    {
+        CRSFHandset::Port.updateBaudRate(baud);
+        CRSFHandset::Port.nativeReset();
+        // at the slower bauds the requested rate may be rejected, the previous one then stays
+        setPacketInterval(1000000 / rateHz);
+        nativeEspNowResetStats();
+        crsfUartErrorStats_t uartErrors;
+        handset->GetUartErrorStats(&uartErrors, true);
+        rcFrames = 0;
+
+        const double bytesPerMs = baud / 10.0 / 1000.0;
+        double credit = 0;
+        size_t offset = 0;
+        double cpuSeconds = 0;
+        uint64_t virtualStart = nativeNowUS();
+
+        // Every millisecond loop() waits, the bytes of that millisecond arrive, CRSF_RX_FIFO_FULL at a time as the
+        // UART driver moves them into the RX buffer (each one a UART event waking the RX task)
+        nativeDelayHook = [&]() {
+            credit += bytesPerMs;
+            size_t chunk = std::min((size_t)credit, stream.size() - offset);
+            credit -= chunk;
+            for (size_t end = offset + chunk; offset < end; )
+            {
+                const size_t piece = std::min(end - offset, (size_t)CRSF_RX_FIFO_FULL);
+                CRSFHandset::Port.nativeInjectRx(&stream[offset], piece);
+                offset += piece;
+            }
+        };
+        while (offset < stream.size() || CRSFHandset::Port.available() > 0)
+        {
+            auto start = benchClock::now();
+            loop();
+            cpuSeconds += benchSecondsSince(start);
+        }
+        nativeDelayHook = nullptr;
+        // The parser may still hold complete frames it has already read from the UART
+        for (uint32_t before = ~0U; before != rcFrames; )
+        {
+            before = rcFrames;
+            auto start = benchClock::now();
+            loop();
+            cpuSeconds += benchSecondsSince(start);
+        }
+
+        double virtualSeconds = (nativeNowUS() - virtualStart) / 1e6;
+        uint32_t parsed = rcFrames;
+        uint32_t offered = recorded ? parsed : benchStreamFrames;
+        handset->GetUartErrorStats(&uartErrors, false);
+        printf("%8d %8u %8u %8u %9u %7u %8.2f %12.0f %12.0f %10.1f %6.2f %7u %4u %8u\n",
+               baud, offered, parsed, offered - parsed, CRSFHandset::Port.nativeRxDropped, uartErrors.bufferFull,
+               cpuSeconds * 1e3, parsed / cpuSeconds, CRSFHandset::Port.nativeRxConsumed / cpuSeconds,
+               parsed ? cpuSeconds * 1e9 / parsed : 0.0, 100.0 * cpuSeconds / virtualSeconds, nativeEspNow.sends,
+               CRSF::LinkStatistics.uplink_Link_quality, 1000000 / getPacketInterval());
+    }
+    return 0;
+}
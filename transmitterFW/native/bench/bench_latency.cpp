@@ -0,0 +1,148 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Stage latency histograms of the RC frames, read with getLatencyHistogram() as on the module.
+   EdgeTX is simulated at 400000 baud: one RC frame per packet interval, its bytes arriving at line rate,
+   with the frame period slightly off the module's so the phase between the two drifts through a whole
+   interval. The shim completes esp_now_send() at once, so the "air" stage is 0. When polling, the firmware
+   takes the time it reads the bytes from the UART as their arrival, "input" then leaves out the wait
+   for the next poll (up to 1 ms) and is 0 here, as no time passes inside loop() before the parse. With
+   CRSF_RX_TASK the bytes are handed over while loop() waits, the UART event runs the RX task at once.
+   No virtual time passes in the timer ISR and the sender task either, "isr" and "wakeup" are 0; the host
+   CPU time of the ISR is printed instead, compare a build with -D ESPNOW_SEND_FROM_ISR for the send in the ISR.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "bench.h"
+#include "common.h"
+#include "CRSF.h"
+#include "CRSFHandset.h"
+#include "LatencyHistogram.h"
+#include "NativeHAL.h"
+
+extern CRSFHandset *handset;
+void setup();
+void loop();
+
+static constexpr int32_t benchBaud = 400000;
+static const char *const stageNames[latencyStageCount] = {"input", "schedule", "air", "total", "isr", "wakeup", "rx jitter", "turnaround"};
+
+// Feed `frames` RC frames, the handset's frame period is `periodUS`. Every millisecond loop() waits, every byte
+// whose arrival time has passed is handed to the UART.
+static void feed(uint32_t frames, uint32_t periodUS)
+{
+    const double byteUS = 10 * 1e6 / benchBaud;
+    uint16_t channels[16];
+    std::fill(std::begin(channels), std::end(channels), CRSF_CHANNEL_VALUE_MIN);
+    std::vector<uint8_t> frame;
+    benchMakeRcFrame(frame, channels);
+    const uint64_t start = nativeNowUS();
+    uint32_t n = 0;
+    size_t sent = 0;
+
+    nativeDelayHook = [&]() {
+        while (n < frames)
+        {
+            const uint64_t now = nativeNowUS();
+            const uint64_t frameStart = start + (uint64_t)n * periodUS;
+            size_t due = now < frameStart ? 0 : std::min(frame.size(), (size_t)((now - frameStart) / byteUS) + 1);
+            if (due > sent)
+            {
+                CRSFHandset::Port.nativeInjectRx(&frame[sent], due - sent);
+                sent = due;
+            }
+            if (sent < frame.size())
+                break;
+            // the next frame
+            n++;
+            sent = 0;
+            channels[0] = CRSF_CHANNEL_VALUE_MIN + n % benchSeqSpan;
+            frame.clear();
+            benchMakeRcFrame(frame, channels);
+        }
+    };
+    while (n < frames)
+    {
+        loop();
+    }
+    nativeDelayHook = nullptr;
+}
+
+static void printHistogram(const char *name, const latencyHistogram_t &h)
+{
+    printf("\n%s: %u samples, avg %u us, max %u us\n", name, h.count, h.count ? (uint32_t)(h.sumUS / h.count) : 0, h.maxUS);
+    for (uint8_t n = 0; n < LATENCY_HISTOGRAM_BUCKETS; n++)
+    {
+        if (!h.buckets[n])
+            continue;
+        char range[32];
+        if (n == LATENCY_HISTOGRAM_BUCKETS - 1)
+            snprintf(range, sizeof(range), ">= %u", latencyBucketMinUS(n));
+        else
+            snprintf(range, sizeof(range), "%u..%u", latencyBucketMinUS(n), n ? 2 * latencyBucketMinUS(n) - 1 : 0);
+        printf("  %16s us %8u %5.1f%%\n", range, h.buckets[n], 100.0 * h.buckets[n] / h.count);
+    }
+}
+
+int benchLatency(int argc, char **argv)
+{
+    uint32_t frames = argc > 1 ? atoi(argv[1]) : 5000;
+
+    setup();
+    loop(); // start of the handset search, as in the handset benchmark
+    CRSFHandset::Port.updateBaudRate(benchBaud);
+    CRSFHandset::Port.nativeReset();
+    std::vector<uint8_t> select;
+    benchMakeModelSelect(select, 0);
+    CRSFHandset::Port.nativeInjectRx(select.data(), select.size());
+
+    printf("%u RC frames per packet rate at %d baud, percentiles are bucket upper bounds in us\n\n", frames, benchBaud);
+    printf("%8s", "rate Hz");
+    for (const char *name : stageNames)
+        printf(" %10s p50/p99/max", name);
+    printf(" isr ns avg/max\n");
+
+    latencyHistogram_t histograms[latencyStageCount];
+    for (uint32_t intervalUS : RFpacketIntervalsUS)
+    {
+        if (!setPacketInterval(intervalUS))
+            continue;
+        // settle, then start the histograms over
+        feed(100, intervalUS + intervalUS / 500);
+        for (uint8_t s = 0; s < latencyStageCount; s++)
+            getLatencyHistogram((latencyStage_e)s, &histograms[s], true);
+
+        nativeTimerIsr = {};
+        feed(frames, intervalUS + intervalUS / 500);
+        printf("%8u", 1000000 / intervalUS);
+        for (uint8_t s = 0; s < latencyStageCount; s++)
+        {
+            getLatencyHistogram((latencyStage_e)s, &histograms[s], false);
+            printf(" %8u/%u/%u", latencyPercentileUS(&histograms[s], 50), latencyPercentileUS(&histograms[s], 99), histograms[s].maxUS);
+        }
+        printf(" %8.0f/%llu\n", nativeTimerIsr.calls ? (double)nativeTimerIsr.totalNS / nativeTimerIsr.calls : 0.0,
+               (unsigned long long)nativeTimerIsr.maxNS);
+    }
+
+    // The full histograms of the last rate
+    for (uint8_t s = 0; s < latencyStageCount; s++)
+        printHistogram(stageNames[s], histograms[s]);
+    return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Entry point of the host (env:native) build.
+   Usage: program <benchmark> [arguments], without arguments all benchmarks are listed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "CRSF.h"
+
+static const struct
+{
+    const char *name;
+    int (*func)(int argc, char **argv);
+    const char *help;
+} benchmarks[] = {
+    {"handset", benchHandset, "[capture.bin] CRSFHandset::handleInput() throughput at every handset baud"},
+    {"parser", benchParser, "streaming CRSF input parser vs. the previous one-frame-per-call parser"},
+    {"unpack", benchUnpack, "[rounds] RC channel unpacker/packer equivalence check and unpacker timing"},
+    {"fifo", benchFifo, "[packets] locked FIFO vs. lock-free SPSC FIFO, two-thread stress test and single-thread overhead"},
+    {"crc", benchCrc, "[rounds] CRC8/Crc2Byte slice-by-N equivalence check and timing per frame length"},
+    {"latency", benchLatency, "[frames] RC frame latency histograms per stage, UART to ESP-NOW send callback, at every packet rate"},
+    {"sync", benchSync, "[seed] EdgeTX mixer sync simulation: lock time, frame wait and late frames, checked against limits"},
+    {"snapshot", benchSnapshot, "[frames] tear-free channel snapshot, writer/reader thread stress test against a plain array copy"},
+    {"reconnect", benchReconnect, "[rate Hz] handset search after a handset reboot at another baud rate: time to the first good frame, checked against a limit"},
+    {"telemetry", benchTelemetry, "[seconds] telemetry to the handset under load: mixer sync period and the counters per telemetry class"},
+    {"params", benchParams, "the parameter menu from the radio: chunked reads at every packet rate, writes applied at once and saved"},
+    {"phyrate", benchPhyRate, "[trace] adaptive ESP-NOW PHY rate against a scripted loss trace vs. every fixed rate, and in the firmware"},
+    {"models", benchModels, "[switches] model selection across more models than ESP-NOW peers: peer cache and switch latency"},
+};
+
+void benchMakeRcFrame(std::vector<uint8_t> &stream, const uint16_t *channels)
+{
+    uint8_t frame[sizeof(rcPacket_t) + CRSF_FRAME_CRC_SIZE] = {0};
+    auto *packet = (rcPacket_t *)frame;
+    packet->header.device_addr = CRSF_ADDRESS_CRSF_TRANSMITTER;
+    packet->header.frame_size = CRSF_FRAME_SIZE(sizeof(crsf_channels_t));
+    packet->header.type = CRSF_FRAMETYPE_RC_CHANNELS_PACKED;
+
+    // 11 bits per channel, LSB first
+    uint8_t *payload = &frame[sizeof(crsf_header_t)];
+    uint32_t bitPos = 0;
+    for (unsigned ch = 0; ch < 16; ch++)
+    {
+        for (unsigned bit = 0; bit < 11; bit++, bitPos++)
+        {
+            if (channels[ch] & (1 << bit))
+            {
+                payload[bitPos / 8] |= 1 << (bitPos % 8);
+            }
+        }
+    }
+    frame[sizeof(rcPacket_t)] = crsf_crc.calc(&frame[CRSF_FRAME_NOT_COUNTED_BYTES], sizeof(rcPacket_t) - CRSF_FRAME_NOT_COUNTED_BYTES);
+    stream.insert(stream.end(), frame, frame + sizeof(frame));
+}
+
+void benchMakeModelSelect(std::vector<uint8_t> &stream, uint8_t modelid)
+{
+    // the command carries its own CRC8 (poly 0xBA)
+    static GENERIC_CRC8 cmd_crc(0xBA);
+    uint8_t modelSelect[] = {CRSF_ADDRESS_CRSF_TRANSMITTER, 8, CRSF_FRAMETYPE_COMMAND, CRSF_ADDRESS_CRSF_TRANSMITTER, CRSF_ADDRESS_RADIO_TRANSMITTER,
+                             CRSF_COMMAND_SUBCMD_RX, CRSF_COMMAND_MODEL_SELECT_ID, modelid, 0, 0};
+    modelSelect[8] = cmd_crc.calc(&modelSelect[2], 6);
+    modelSelect[9] = crsf_crc.calc(&modelSelect[2], 7);
+    stream.insert(stream.end(), modelSelect, modelSelect + sizeof(modelSelect));
+}
+
+std::vector<uint8_t> benchMakeHandsetStream(uint32_t frames, std::vector<uint32_t> *frameEnds)
+{
+    std::vector<uint8_t> stream;
+    stream.reserve(frames * 27);
+
+    // EdgeTX selects the receiver (model) number right after connecting
+    benchMakeModelSelect(stream, 0);
+
+    uint16_t channels[16];
+    for (uint32_t n = 0; n < frames; n++)
+    {
+        channels[0] = CRSF_CHANNEL_VALUE_MIN + n % benchSeqSpan;
+        for (unsigned ch = 1; ch < 15; ch++)
+        {
+            channels[ch] = CRSF_CHANNEL_VALUE_MID + (uint16_t)(800 * sin((n + ch * 97) * 0.01));
+        }
+        channels[15] = CRSF_CHANNEL_VALUE_MIN + n / benchSeqSpan;
+        benchMakeRcFrame(stream, channels);
+        if (frameEnds) frameEnds->push_back(stream.size());
+
+        if (n % 100 == 99)
+        {
+            // EdgeTX polls for modules with a broadcast device ping every now and then
+            uint8_t ping[] = {CRSF_ADDRESS_CRSF_TRANSMITTER, 4, CRSF_FRAMETYPE_DEVICE_PING, CRSF_ADDRESS_BROADCAST, CRSF_ADDRESS_RADIO_TRANSMITTER, 0};
+            ping[5] = crsf_crc.calc(&ping[2], 3);
+            stream.insert(stream.end(), ping, ping + sizeof(ping));
+        }
+    }
+    return stream;
+}
+
+bool benchLoadStream(const char *path, std::vector<uint8_t> &stream)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        return false;
+    }
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        stream.insert(stream.end(), buf, buf + n);
+    }
+    fclose(f);
+    return !stream.empty();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2)
+    {
+        for (const auto &bench : benchmarks)
+        {
+            if (strcmp(argv[1], bench.name) == 0)
+            {
+                return bench.func(argc - 1, argv + 1);
+            }
+        }
+    }
+
+    printf("Usage: %s <benchmark> [arguments]\n\n", argv[0]);
+    for (const auto &bench : benchmarks)
+    {
+        printf("  %-10s %s\n", bench.name, bench.help);
+    }
+    return 1;
+}
@@ -0,0 +1,139 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Model selection across more models than fit into the ESP-NOW peer table.
+   The firmware runs unmodified as in the handset benchmark, the model table is filled with
+   benchModelCount receivers at runtime and the handset stream selects a new model every
+   benchFramesPerModel RC frames, one per packet interval. The ESP-NOW shim registers peers instantly, so the switch time is
+   the virtual time from the model selection to the send callback of the first frame to the new receiver.
+   "hot set": 80 % of the selections among benchHotModels models, the rest among all of them.
+   "round robin": every model in turn, each selection misses the cache once there are more models than entries.
+   "add fails": round robin with the first registration of every receiver failing, loop() registers it again;
+   no frame may be sent to an unregistered receiver (errors).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "bench.h"
+#include "common.h"
+#include "CRSF.h"
+#include "CRSFHandset.h"
+#include "ModelTable.h"
+#include "PeerCache.h"
+#include "NativeHAL.h"
+
+extern CRSFHandset *handset;
+void setup();
+void loop();
+
+static constexpr uint8_t benchModelCount = 40;
+static constexpr uint8_t benchHotModels = 8;
+static constexpr uint32_t benchFramesPerModel = 10;
+static constexpr int32_t benchBaud = 400000;
+
+// The next model selected, `random` is the state of the pseudo random sequence
+static uint8_t nextModel(uint8_t modelid, bool hot, uint32_t &random)
+{
+    random = random * 1103515245 + 12345;
+    uint32_t r = random >> 16;
+    uint8_t next;
+    if (!hot)
+        next = modelid + 1;
+    else if (r % 100 < 80)
+        next = (r / 100) % benchHotModels;
+    else
+        next = (r / 100) % benchModelCount;
+    if (next == modelid)
+        next++;
+    return next % benchModelCount;
+}
+
+// Hand the bytes to the UART and run loop() for `ms` of virtual time
+static void deliver(const std::vector<uint8_t> &bytes, uint32_t ms, uint32_t &maxPeers)
+{
+    CRSFHandset::Port.nativeInjectRx(bytes.data(), bytes.size());
+    for (uint32_t i = 0; i < ms; i++)
+    {
+        loop();
+        maxPeers = std::max(maxPeers, nativeEspNow.peers);
+    }
+}
+
+static void run(const char *name, uint32_t switches, bool hot, bool addFails = false)
+{
+    modelSwitchStats_t before, after;
+    getModelSwitchStats(&before, true);
+    CRSFHandset::Port.nativeReset();
+    nativeEspNowResetStats();
+
+    // EdgeTX sends one RC frame per packet interval
+    const uint32_t frameMs = getPacketInterval() / 1000;
+    uint32_t random = 12345;
+    uint8_t modelid = handset->getModelID();
+    uint32_t maxPeers = nativeEspNow.peers;
+    uint16_t channels[16];
+    std::fill(std::begin(channels), std::end(channels), CRSF_CHANNEL_VALUE_MID);
+    std::vector<uint8_t> bytes;
+
+    for (uint32_t n = 0; n < switches; n++)
+    {
+        modelid = nextModel(modelid, hot, random);
+        // EdgeTX sends the selection at any time between two RC frames
+        bytes.clear();
+        benchMakeModelSelect(bytes, modelid);
+        nativeEspNowAddPeerFailures = addFails ? 1 : 0; // registering the receiver fails once, loop() retries it
+        deliver(bytes, n % frameMs, maxPeers);
+        bytes.clear();
+        for (uint32_t f = 0; f < benchFramesPerModel; f++)
+        {
+            channels[0] = CRSF_CHANNEL_VALUE_MIN + (n * benchFramesPerModel + f) % benchSeqSpan;
+            benchMakeRcFrame(bytes, channels);
+            deliver(bytes, frameMs, maxPeers);
+            bytes.clear();
+        }
+    }
+    getModelSwitchStats(&after, false);
+
+    printf("%-12s %8u %8u %8u %8u %9u %8u %8u %8u %6u %6u\n", name, switches, after.switches,
+           after.peerHits - before.peerHits, after.peerMisses - before.peerMisses, after.peerEvictions - before.peerEvictions,
+           after.minUS, after.avgUS, after.maxUS, maxPeers, nativeEspNow.sendErrors);
+}
+
+int benchModels(int argc, char **argv)
+{
+    uint32_t switches = argc > 1 ? atoi(argv[1]) : 2000;
+
+    setup();
+    loop(); // start of the handset search, as in the handset benchmark
+    CRSFHandset::Port.updateBaudRate(benchBaud);
+    for (uint8_t i = 0; i < benchModelCount; i++)
+    {
+        const uint8_t mac[6] = {0x02, 0xCB, 0x00, 0x00, 0x00, i};
+        ModelTable::setMAC(i, mac);
+    }
+
+    printf("%u models, %u ESP-NOW peer cache entries (%u peers max), %u RC frames per selection, %u Hz\n\n",
+           benchModelCount, ESPNOW_PEER_CACHE_SIZE, ESP_NOW_MAX_TOTAL_PEER_NUM, benchFramesPerModel, 1000000 / getPacketInterval());
+    printf("%-12s %8s %8s %8s %8s %9s %8s %8s %8s %6s %6s\n",
+           "pattern", "selects", "reached", "hits", "misses", "evictions", "min us", "avg us", "max us", "peers", "errors");
+    run("hot set", switches, true);
+    run("round robin", switches, false);
+    run("add fails", switches, false, true);
+    return 0;
+}
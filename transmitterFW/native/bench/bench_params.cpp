@@ -0,0 +1,371 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+/* The module's parameter menu as the radio's Lua script uses it. EdgeTX is simulated as in the telemetry
+   benchmark: a device ping announces the number of fields, then every field is read chunk by chunk at every
+   packet rate, the frames must fit GetMaxPacketBytes() and reassemble to the entry. The handset's baud rate in
+   the shim leaves room for whole entries, so the chunking is also checked on its own at the chunk sizes of
+   slower baud rates. Then the packet rate, WiFi channel, TX power, payload and PHY rate are written and checked
+   to take effect at once (ESP-NOW frames keep reaching the receiver on the new channel) and to be saved once the
+   radio is quiet, not from the handset input path, an out of range value to be rejected. Last "Bind" is run as the
+   Lua script does it, once timing out and once with a receiver's bind frame: the model's receiver must change,
+   frames go to it, the old peer is removed and the model table is saved from loop(). Exits with 1 when a check fails.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include "bench.h"
+#include "common.h"
+#include "CRSF.h"
+#include "CRSFHandset.h"
+#include "CRSFParameters.h"
+#include "EspNowPhyRates.h"
+#include "ModelTable.h"
+#include "NativeHAL.h"
+#include "Preferences.h"
+#include "Settings.h"
+#include "WiFi.h"
+
+extern CRSFHandset *handset;
+void setup();
+void loop();
+
+static std::vector<uint8_t> txStream;                // bytes written to the handset, not yet parsed
+static std::vector<std::vector<uint8_t>> txReplies;  // device information and parameter entry frames
+static bool failed = false;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failed = true;
+    }
+}
+
+static void parseTx(const uint8_t *data, size_t len)
+{
+    txStream.insert(txStream.end(), data, data + len);
+    while (txStream.size() >= 2 && txStream.size() >= (size_t)txStream[1] + 2)
+    {
+        const size_t frameLen = txStream[1] + 2;
+        if (txStream[2] == CRSF_FRAMETYPE_DEVICE_INFO || txStream[2] == CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY)
+        {
+            txReplies.emplace_back(txStream.begin(), txStream.begin() + frameLen);
+        }
+        txStream.erase(txStream.begin(), txStream.begin() + frameLen);
+    }
+}
+
+// An extended frame from the radio to the module
+static std::vector<uint8_t> request(uint8_t type, uint8_t dest, std::initializer_list<uint8_t> payload)
+{
+    std::vector<uint8_t> frame = {CRSF_ADDRESS_CRSF_TRANSMITTER, (uint8_t)(payload.size() + 4), type, dest, CRSF_ADDRESS_RADIO_TRANSMITTER};
+    frame.insert(frame.end(), payload);
+    frame.push_back(crsf_crc.calc(&frame[2], frame.size() - 2));
+    return frame;
+}
+
+// RC frames at the packet rate, `frame` is sent after the first one. Returns when a reply arrived or after `frames`.
+static bool exchange(const std::vector<uint8_t> &frame, uint32_t frames)
+{
+    const uint32_t intervalUS = getPacketInterval();
+    const double byteUS = 10 * 1e6 / CRSFHandset::GetCurrentBaudRate();
+    uint16_t channels[16];
+    std::fill(std::begin(channels), std::end(channels), CRSF_CHANNEL_VALUE_MID);
+    txReplies.clear();
+
+    for (uint32_t n = 0; n < frames && txReplies.empty(); n++)
+    {
+        std::vector<uint8_t> stream;
+        benchMakeRcFrame(stream, channels);
+        if (n == 0)
+            stream.insert(stream.end(), frame.begin(), frame.end());
+        const uint64_t frameStart = nativeNowUS();
+        size_t sent = 0;
+        while (sent < stream.size() || nativeNowUS() < frameStart + intervalUS)
+        {
+            size_t due = std::min(stream.size(), (size_t)((nativeNowUS() - frameStart) / byteUS) + 1);
+            if (due > sent)
+            {
+                CRSFHandset::Port.nativeInjectRx(&stream[sent], due - sent);
+                sent = due;
+            }
+            loop();
+        }
+    }
+    return !txReplies.empty();
+}
+
+// Read a field chunk by chunk, returns the reassembled entry, empty on error
+static std::vector<uint8_t> readField(uint8_t id, uint32_t *chunks, uint32_t *frames)
+{
+    std::vector<uint8_t> entry;
+    for (uint8_t chunk = 0;; chunk++)
+    {
+        const uint64_t start = nativeNowUS();
+        if (!exchange(request(CRSF_FRAMETYPE_PARAMETER_READ, CRSF_ADDRESS_CRSF_TRANSMITTER, {id, chunk}), 20))
+            return {};
+        *frames += (nativeNowUS() - start + getPacketInterval() - 1) / getPacketInterval();
+        (*chunks)++;
+        const std::vector<uint8_t> &reply = txReplies.front();
+        if (reply.size() > handset->GetMaxPacketBytes() || reply[2] != CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY || reply[5] != id)
+            return {};
+        entry.insert(entry.end(), reply.begin() + 7, reply.end() - 1);
+        if (reply[6] == 0)
+            return entry;
+    }
+}
+
+// The entry in one piece, as the handset would send it with unlimited room
+static std::vector<uint8_t> wholeEntry(uint8_t id)
+{
+    uint8_t payload[2 + CRSF_PARAMETER_ENTRY_MAX];
+    const uint8_t len = CRSFParameters::readChunk(id, 0, CRSF_PARAMETER_ENTRY_MAX, payload);
+    return std::vector<uint8_t>(payload + 2, payload + std::max(len, (uint8_t)2));
+}
+
+typedef struct
+{
+    uint8_t type;
+    std::string name;
+    std::string options; // CRSF_TEXT_SELECTION, the text of CRSF_INFO and CRSF_COMMAND
+    int value, min, max; // CRSF_COMMAND: the status and the poll interval in value and min
+    std::string units;
+    bool ok; // every string terminated within the entry, nothing left over
+} luaField_t;
+
+// Parse an entry with the offsets of the ExpressLRS Lua script (fieldUnsignedLoad, fieldTextSelectionLoad,
+// fieldStringLoad, fieldCommandLoad), not those of the encoder: the value, min and max follow each other, the units start 4 bytes
+// after the value, past the default
+static luaField_t luaLoad(const std::vector<uint8_t> &entry)
+{
+    luaField_t field = {};
+    size_t pos = 2;
+    auto string = [&](size_t at, size_t *next) {
+        size_t end = at;
+        while (end < entry.size() && entry[end]) end++;
+        field.ok = field.ok && end < entry.size();
+        *next = end + 1;
+        return at < entry.size() ? std::string((const char *)&entry[at], end - at) : std::string();
+    };
+    field.ok = entry.size() > 2;
+    if (!field.ok)
+        return field;
+    field.type = entry[1];
+    field.name = string(pos, &pos);
+    field.value = field.min = field.max = -1;
+    switch (field.type)
+    {
+    case CRSF_TEXT_SELECTION:
+        field.options = string(pos, &pos);
+        // fall through, the values follow the options
+    case CRSF_UINT8:
+        if (pos + 4 > entry.size())
+        {
+            field.ok = false;
+            break;
+        }
+        field.value = entry[pos];
+        field.min = entry[pos + 1];
+        field.max = entry[pos + 2];
+        field.units = string(pos + 4, &pos);
+        break;
+    case CRSF_COMMAND:
+        if (pos + 2 > entry.size())
+        {
+            field.ok = false;
+            break;
+        }
+        field.value = entry[pos];
+        field.min = entry[pos + 1];
+        field.options = string(pos + 2, &pos);
+        break;
+    default:
+        field.options = string(pos, &pos);
+        break;
+    }
+    field.ok = field.ok && pos == entry.size();
+    return field;
+}
+
+int benchParams(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    nativePreferencesClear();
+    setup();
+    loop(); // start of the handset search, as in the handset benchmark
+    CRSFHandset::Port.nativeOnTx = parseTx;
+
+    std::vector<uint8_t> select;
+    benchMakeModelSelect(select, 0);
+    exchange(select, 20); // connect and select model 0
+
+    // The radio pings, the device information announces the fields
+    check(exchange(request(CRSF_FRAMETYPE_DEVICE_PING, CRSF_ADDRESS_BROADCAST, {}), 20) &&
+          txReplies.front()[2] == CRSF_FRAMETYPE_DEVICE_INFO, "no device information");
+    const std::vector<uint8_t> &info = txReplies.front();
+    const uint8_t fields = info.size() > 3 ? info[info.size() - 3] : 0; // parametersCnt, parameterVersion, CRC
+    check(fields == CRSFParameters::count() && fields > 0, "device information without the parameter count");
+
+    printf("%s duplex at %d baud, %u fields read at every packet rate\n\n",
+           CRSFHandset::isHalfDuplex() ? "half" : "full", CRSFHandset::GetCurrentBaudRate(), fields);
+    printf("%8s %10s %10s %8s %12s\n", "rate Hz", "max bytes", "chunk", "chunks", "RC frames");
+
+    std::map<uint8_t, std::vector<uint8_t>> entries;
+    for (uint32_t intervalUS : RFpacketIntervalsUS)
+    {
+        if (!setPacketInterval(intervalUS))
+            continue;
+        exchange({}, 10); // settle at the rate
+
+        uint32_t chunks = 0, frames = 0;
+        for (uint8_t id = 1; id <= fields; id++)
+        {
+            std::vector<uint8_t> entry = readField(id, &chunks, &frames);
+            // the statistics change while the chunks are read, their entry is kept from the first chunk on
+            check(!entry.empty() && (entry[1] == CRSF_INFO || entry == wholeEntry(id)), "field not read or reassembled wrongly");
+            check(luaLoad(entry).ok, "field not parsed by the Lua script's offsets");
+            entries[id] = entry;
+        }
+        printf("%8u %10u %10d %8u %12u\n", 1000000 / intervalUS, handset->GetMaxPacketBytes(),
+               handset->GetMaxPacketBytes() - CRSF_PARAMETER_CHUNK_OVERHEAD, chunks, frames);
+    }
+
+    // 115200 baud leaves 6 bytes per chunk at 250 Hz, 400000 baud 56 (CRSF_MAX_PACKET_LEN) at 500 Hz
+    printf("\n%8s %8s\n", "chunk", "chunks");
+    for (uint8_t chunkSize : {6, 14, 32, 56})
+    {
+        uint32_t chunks = 0;
+        for (uint8_t id = 1; id <= fields; id++)
+        {
+            std::vector<uint8_t> entry;
+            uint8_t payload[2 + CRSF_PARAMETER_ENTRY_MAX];
+            uint8_t chunk = 0;
+            for (uint8_t len; (len = CRSFParameters::readChunk(id, chunk, chunkSize, payload)); chunk++)
+            {
+                check(len <= chunkSize + 2 && payload[0] == id, "chunk too long");
+                entry.insert(entry.end(), payload + 2, payload + len);
+                if (payload[1] == 0)
+                    break;
+            }
+            // the statistics differ from one read to the next, Tasks even resets its window
+            check((entry.size() > 1 && entry[1] == CRSF_INFO ? luaLoad(entry).ok : entry == wholeEntry(id)) &&
+                  !CRSFParameters::readChunk(id, chunk + 1, chunkSize, payload), "chunks do not reassemble");
+            chunks += chunk + 1;
+        }
+        printf("%8u %8u\n", chunkSize, chunks);
+    }
+    for (auto &entry : entries)
+    {
+        const luaField_t field = luaLoad(entry.second);
+        if (field.type == CRSF_INFO || field.type == CRSF_COMMAND)
+            printf("  field %2u: %-14s %s\n", entry.first, field.name.c_str(), field.options.c_str());
+        else
+            printf("  field %2u: %-14s value %3d, min %3d, max %3d, units \"%s\"\n", entry.first, field.name.c_str(), field.value,
+                   field.min, field.max, field.units.c_str());
+    }
+
+    // Find the fields by name
+    std::map<std::string, uint8_t> ids;
+    for (auto &field : entries)
+        ids[(const char *)&field.second[2]] = field.first;
+    auto command = [&](const char *name, uint8_t value) {
+        check(ids.count(name), "field missing");
+        exchange(request(CRSF_FRAMETYPE_PARAMETER_WRITE, CRSF_ADDRESS_CRSF_TRANSMITTER, {ids[name], value}), 3);
+        uint32_t chunks = 0, frames = 0;
+        return luaLoad(readField(ids[name], &chunks, &frames));
+    };
+    auto write = [&](const char *name, uint8_t value) { return command(name, value).value; };
+
+    const luaField_t channel = luaLoad(entries[ids["WiFi Channel"]]);
+    const luaField_t rate = luaLoad(entries[ids["Packet Rate"]]);
+    check(channel.type == CRSF_UINT8 && channel.min == 1 && channel.max == 11 && channel.units.empty(), "WiFi Channel misread by the Lua script");
+    check(rate.type == CRSF_TEXT_SELECTION && rate.min == 0 && rate.units == "Hz", "Packet Rate misread by the Lua script");
+
+    const uint32_t nvsWrites = nativeNvsWrites();
+    check(write("Packet Rate", 1) == 1 && getPacketInterval() == 10000, "packet rate not applied");
+    check(write("WiFi Channel", 6) == 6 && WiFi.channel == 6, "WiFi channel not applied");
+    check(write("WiFi Channel", 12) == 6 && WiFi.channel == 6, "out of range WiFi channel accepted");
+    check(write("TX Power", 5) == 5 && WiFi.txPower == WIFI_POWER_13dBm, "TX power not applied");
+    check(write("Payload", 1) == 1, "payload not applied");
+    const uint8_t phyRate24M = espnowPhyRateIndex(24000) + 1;
+    check(write("PHY Rate", phyRate24M) == phyRate24M, "PHY rate not applied");
+    check(nativeNvsWrites() == nvsWrites, "settings written to flash while the radio changes them");
+
+    nativeEspNowResetStats();
+    exchange({}, 20);
+    check(nativeEspNow.sends > 0 && nativeEspNow.sendErrors == 0, "ESP-NOW frames not sent on the new channel");
+    check(nativeEspNow.lastLen == 2 * CRSF_NUM_CHANNELS, "legacy payload not sent");
+    check(nativeEspNow.lastRate == WIFI_PHY_RATE_24M, "frames not sent at the PHY rate");
+    printf("\nafter the writes: %u Hz, channel %u, ESP-NOW %u frames of %u bytes at PHY rate 0x%02x, %u errors\n", 1000000 / getPacketInterval(),
+           WiFi.channel, nativeEspNow.sends, (unsigned)nativeEspNow.lastLen, nativeEspNow.lastRate, nativeEspNow.sendErrors);
+
+    // Written once from loop() after SETTINGS_COMMIT_DELAY_MS without a change
+    exchange({}, SETTINGS_COMMIT_DELAY_MS * 1000 / getPacketInterval() + 2);
+    check(nativeNvsWrites() == nvsWrites + 1, "settings not written once after the changes");
+
+    // What the next boot loads
+    const txSettings_t stored = Settings::begin({});
+    check(stored.packetIntervalUS == 10000 && stored.wifiChannel == 6 && stored.txPower == WIFI_POWER_13dBm && stored.legacyPayload &&
+          stored.phyRate == phyRate24M,
+          "settings not saved");
+
+    // Bind: the Lua script clicks, polls until the status is no longer executing and confirms the result
+    uint8_t oldMAC[6];
+    memcpy(oldMAC, ModelTable::getMAC(0), 6);
+    const uint8_t newMAC[6] = {0x02, 0xCB, 0xB1, 0x4D, 0x00, 0x01};
+    const uint32_t pollFrames = 200000 / getPacketInterval();
+    luaField_t bind = command("Bind", crsfCommandClick);
+    check(bind.type == CRSF_COMMAND && bind.ok && bind.value == crsfCommandExecuting && bind.min == 20, "bind not started");
+    exchange({}, BIND_TIMEOUT_MS * 1000 / getPacketInterval() + 2);
+    nativeEspNowReceive(newMAC, newMAC, 6); // too late
+    bind = command("Bind", crsfCommandQuery);
+    check(bind.value == crsfCommandAskConfirm && memcmp(ModelTable::getMAC(0), oldMAC, 6) == 0, "bind did not time out");
+    printf("\nbind without a receiver: \"%s\"\n", bind.options.c_str());
+    check(command("Bind", crsfCommandConfirmed).value == crsfCommandIdle, "bind result not confirmed");
+
+    const uint32_t modelWrites = nativeNvsWrites();
+    check(command("Bind", crsfCommandClick).value == crsfCommandExecuting, "bind not started again");
+    exchange({}, pollFrames);
+    check(command("Bind", crsfCommandQuery).value == crsfCommandExecuting, "bind ended without a receiver");
+    const uint8_t other[6] = {0x02, 0xCB, 0xB1, 0x4D, 0x00, 0x02};
+    const uint8_t notBind[6] = {0x02, 0xCB, 0xB1, 0x4D, 0x00, 0x03};
+    nativeEspNowReceive(other, notBind, 6); // not its own MAC address, not a bind frame
+    nativeEspNowReceive(newMAC, newMAC, 6);
+    exchange({}, pollFrames);
+    bind = command("Bind", crsfCommandQuery);
+    printf("bind with a receiver: \"%s\"\n", bind.options.c_str());
+    check(bind.value == crsfCommandAskConfirm && memcmp(ModelTable::getMAC(0), newMAC, 6) == 0, "receiver not bound");
+    check(nativeEspNowHasPeer(newMAC) && !nativeEspNowHasPeer(oldMAC), "peers not replaced");
+    check(command("Bind", crsfCommandConfirmed).value == crsfCommandIdle, "bind result not confirmed");
+    nativeEspNowResetStats();
+    exchange({}, 20);
+    check(nativeEspNow.sends > 0 && nativeEspNow.sendErrors == 0 && memcmp(nativeEspNow.lastPeer, newMAC, 6) == 0,
+          "frames not sent to the bound receiver");
+    check(nativeNvsWrites() > modelWrites, "model table not saved");
+    ModelTable::begin(nullptr, 0); // what the next boot loads, without the compiled receivers
+    check(ModelTable::getMAC(0) && memcmp(ModelTable::getMAC(0), newMAC, 6) == 0, "bound receiver not saved");
+    CRSFHandset::Port.nativeOnTx = nullptr;
+
+    return failed ? 1 : 0;
+}
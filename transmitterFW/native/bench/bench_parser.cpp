@@ -0,0 +1,234 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* CRSF input parser comparison.
+   Both parsers are polled once per millisecond of virtual time (the loop() cadence) while the stream
+   arrives at the line rate of the baud under test. The latency is measured from the moment the last
+   byte of an RC frame is put into the UART RX buffer until the frame is dispatched.
+   The noisy line has a burst of random bytes after every RC frame, a quarter of them start bytes, so most bytes
+   begin a candidate frame that fails its CRC.
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include "bench.h"
+#include "common.h"
+#include "CRSF.h"
+#include "CRSFHandset.h"
+#include "NativeHAL.h"
+
+extern CRSFHandset *handset;
+void setup();
+
+/**
+ * The parser as it was before the streaming rewrite: at most one frame per call, the remaining
+ * bytes are moved to the front of the buffer after every frame.
+ */
+class LegacyParser
+{
+public:
+    void handleInput()
+    {
+        auto toRead = std::min(CRSFHandset::Port.available(), CRSF_MAX_PACKET_LEN - SerialInPacketPtr);
+        SerialInPacketPtr += CRSFHandset::Port.readBytes(&SerialInBuffer[SerialInPacketPtr], toRead);
+        alignBufferToSync(0);
+
+        if (SerialInPacketPtr < 3)
+            return;
+
+        const uint32_t totalLen = SerialInBuffer[1] + 2;
+        if (totalLen < 4 || totalLen > CRSF_MAX_PACKET_LEN)
+        {
+            alignBufferToSync(1);
+            return;
+        }
+
+        if (SerialInPacketPtr < totalLen)
+            return;
+
+        uint8_t CalculatedCRC = crsf_crc.calc(&SerialInBuffer[2], totalLen - 3);
+        if (CalculatedCRC == SerialInBuffer[totalLen - 1] && SerialInBuffer[2] == CRSF_FRAMETYPE_RC_CHANNELS_PACKED)
+        {
+            RcPacketToChannels();
+        }
+
+        SerialInPacketPtr -= totalLen;
+        memmove(SerialInBuffer, &SerialInBuffer[totalLen], SerialInPacketPtr);
+    }
+
+    void (*onFrame)(int32_t index) = nullptr;
+
+private:
+    uint8_t SerialInBuffer[CRSF_MAX_PACKET_LEN] = {0};
+    uint8_t SerialInPacketPtr = 0;
+    volatile uint16_t channels[CRSF_NUM_CHANNELS];
+
+    void alignBufferToSync(uint8_t startIdx)
+    {
+        for (unsigned int i = startIdx; i < SerialInPacketPtr; i++)
+        {
+            if (SerialInBuffer[i] == CRSF_ADDRESS_CRSF_TRANSMITTER || SerialInBuffer[i] == CRSF_SYNC_BYTE)
+            {
+                SerialInPacketPtr -= i;
+                memmove(SerialInBuffer, &SerialInBuffer[i], SerialInPacketPtr);
+                return;
+            }
+        }
+        SerialInPacketPtr = 0;
+    }
+
+    void RcPacketToChannels()
+    {
+        const uint8_t *payload = &SerialInBuffer[sizeof(crsf_header_t)];
+        uint8_t bitsMerged = 0;
+        uint32_t readValue = 0;
+        unsigned readByteIndex = 0;
+        for (volatile uint16_t &n : channels)
+        {
+            while (bitsMerged < 11)
+            {
+                readValue |= ((uint32_t)payload[readByteIndex++]) << bitsMerged;
+                bitsMerged += 8;
+            }
+            n = (uint16_t)(readValue & 0x7FF);
+            readValue >>= 11;
+            bitsMerged -= 11;
+        }
+        if (onFrame) onFrame(benchFrameIndex(channels[0], channels[15]));
+    }
+};
+
+static constexpr uint8_t benchNoiseBytes = 26; // random bytes after every RC frame on the noisy line
+
+static std::vector<uint64_t> arrivalUS;
+static int32_t lastIndex;
+static uint32_t parsed;
+static uint64_t latencySumUS;
+static uint64_t latencyMaxUS;
+
+static void frameDispatched(int32_t index)
+{
+    // The handset may report the same frame more than once. Once the RX buffer overflows, the stream has gaps
+    // and the CRC8 lets roughly one in 256 spliced frames through, those carry no valid index.
+    if (index <= lastIndex || index >= (int32_t)arrivalUS.size())
+        return;
+    lastIndex = index;
+    parsed++;
+    uint64_t latency = nativeNowUS() - arrivalUS[lastIndex];
+    latencySumUS += latency;
+    latencyMaxUS = std::max(latencyMaxUS, latency);
+}
+
+static void handsetFrameDispatched()
+{
+    frameDispatched(benchFrameIndex(ChannelData[0], ChannelData[15]));
+}
+
+static void runParser(const char *name, int32_t baud, const std::vector<uint8_t> &stream, const std::vector<uint32_t> &frameEnds,
+                      const std::function<void()> &poll)
+{
+    CRSFHandset::Port.nativeReset();
+    memset((void *)ChannelData, 0, sizeof(ChannelData));
+    arrivalUS.assign(frameEnds.size(), 0);
+    lastIndex = -1;
+    parsed = 0;
+    latencySumUS = 0;
+    latencyMaxUS = 0;
+
+    const double bytesPerMs = baud / 10.0 / 1000.0;
+    double credit = 0;
+    size_t offset = 0;
+    size_t nextFrame = 0;
+    double cpuSeconds = 0;
+
+    for (uint32_t idle = 0; idle < 3; )
+    {
+        credit += bytesPerMs;
+        size_t chunk = std::min((size_t)credit, stream.size() - offset);
+        credit -= chunk;
+        CRSFHandset::Port.nativeInjectRx(&stream[offset], chunk);
+        offset += chunk;
+        while (nextFrame < frameEnds.size() && frameEnds[nextFrame] <= offset)
+        {
+            arrivalUS[nextFrame++] = nativeNowUS();
+        }
+
+        uint32_t before = parsed;
+        auto start = benchClock::now();
+        poll();
+        cpuSeconds += benchSecondsSince(start);
+        nativeAdvanceUS(1000);
+
+        bool drained = offset == stream.size() && CRSFHandset::Port.available() == 0 && parsed == before;
+        idle = drained ? idle + 1 : 0;
+    }
+
+    printf("%8d %-8s %8u %8u %9u %8.2f %10.1f %10.2f %10.2f\n",
+           baud, name, parsed, (uint32_t)frameEnds.size() - parsed, CRSFHandset::Port.nativeRxDropped,
+           cpuSeconds * 1e3, parsed ? cpuSeconds * 1e9 / parsed : 0.0,
+           parsed ? latencySumUS / 1e3 / parsed : 0.0, latencyMaxUS / 1e3);
+}
+
+int benchParser(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    std::vector<uint32_t> frameEnds;
+    std::vector<uint8_t> stream = benchMakeHandsetStream(20000, &frameEnds);
+
+    setup();
+    handset->setRCDataCallback(handsetFrameDispatched);
+    handset->handleInput(); // let the handset search start before the stream starts
+
+    LegacyParser legacy;
+    legacy.onFrame = frameDispatched;
+
+    std::vector<int32_t> bauds(std::begin(CRSFHandset::TxToHandsetBauds), std::end(CRSFHandset::TxToHandsetBauds));
+    std::sort(bauds.begin(), bauds.end());
+
+    printf("%u RC frames, %u bytes, delivered at line rate, parsers polled every 1 ms\n\n", (unsigned)frameEnds.size(), (unsigned)stream.size());
+    printf("%8s %-8s %8s %8s %9s %8s %10s %10s %10s\n", "baud", "parser", "parsed", "lost", "rxDropped", "cpu ms", "ns/frame", "lat avg ms", "lat max ms");
+    for (int32_t baud : bauds)
+    {
+        runParser("legacy", baud, stream, frameEnds, [&legacy]() { legacy.handleInput(); });
+        handset->handleInput(); // the handset was idle during the legacy run, let its UART watchdog settle first
+        runParser("stream", baud, stream, frameEnds, []() { handset->handleInput(); });
+    }
+
+    std::vector<uint8_t> noisy;
+    std::vector<uint32_t> noisyEnds;
+    uint32_t random = 1;
+    for (size_t n = 0, start = 0; n < frameEnds.size(); start = frameEnds[n++])
+    {
+        noisy.insert(noisy.end(), stream.begin() + start, stream.begin() + frameEnds[n]);
+        noisyEnds.push_back(noisy.size());
+        for (uint8_t i = 0; i < benchNoiseBytes; i++)
+        {
+            random = random * 1103515245 + 12345;
+            noisy.push_back((random >> 16) % 4 == 0 ? CRSF_SYNC_BYTE : random >> 24);
+        }
+    }
+    printf("\nnoisy line, %u random bytes after every RC frame\n", benchNoiseBytes);
+    for (int32_t baud : {400000, 921600})
+    {
+        runParser("legacy", baud, noisy, noisyEnds, [&legacy]() { legacy.handleInput(); });
+        handset->handleInput();
+        runParser("stream", baud, noisy, noisyEnds, []() { handset->handleInput(); });
+    }
+    return 0;
+}
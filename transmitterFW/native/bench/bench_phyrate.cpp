@@ -0,0 +1,309 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* The adaptive ESP-NOW PHY rate against a scripted link. A trace of segments (signal strength ramping from a
+   start to an end RSSI, plus a share of frames lost to interference) is played at 500 Hz, each frame lost with
+   a probability following from the RSSI, log-normal fading and the sensitivity of the rate it is sent at.
+   RateAdapter picks the rates from the send results, compared against every fixed rate by delivered frames,
+   the worst 1 s window, the longest loss burst and the mean airtime per frame. The built-in trace walks away
+   from the model, behind a wall and back with an interference burst; a trace file has one segment per line:
+   `seconds rssi_start rssi_end [interference %]`.
+   Then the firmware runs with the PHY Rate menu entry at Auto and a receiver acknowledging frames up to
+   2 Mbit/s only, the frames must settle at 2 Mbit/s.
+   Exits with 1 when the adaptive rate delivers more than a point less than its most robust rate, does not
+   save airtime against it, or does not reach its fastest rate on the clean part of the trace.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "common.h"
+#include "CRSF.h"
+#include "CRSFHandset.h"
+#include "CRSFParameters.h"
+#include "EspNowPhyRates.h"
+#include "NativeHAL.h"
+#include "Preferences.h"
+#include "RateAdapter.h"
+
+extern CRSFHandset *handset;
+void setup();
+void loop();
+
+static constexpr uint32_t frameHz = 500;
+static constexpr uint32_t frameBytes = 26 + 50; // versioned RC frame, ESP-NOW vendor action frame and MAC overhead
+static constexpr double fadingDB = 2.0;         // sigma of the RSSI around the trace
+
+// Receiver sensitivity at 10 % frame loss and PHY preamble of every rate in espnowPhyRates, typical ESP32 values
+static const struct
+{
+    double sensitivityDBm;
+    double preambleUS;
+} phyModel[] = {
+    {-105, 320}, {-102, 320}, {-97, 192}, {-95, 192}, {-92, 20}, {-89, 20}, {-84, 20}, {-75, 20},
+};
+static_assert(sizeof(phyModel) / sizeof(phyModel[0]) == espnowPhyRateCount, "a sensitivity for every PHY rate");
+
+typedef struct
+{
+    double seconds;
+    double rssiStart;
+    double rssiEnd;
+    double interference; // share of frames lost regardless of the rate
+} segment_t;
+
+static const segment_t builtinTrace[] = {
+    {10, -45, -45, 0},     // next to the model
+    {20, -45, -93, 0},     // walking away
+    {10, -93, -93, 0},     // far
+    {10, -99, -99, 0},     // behind a wall
+    {5, -70, -70, 0.15},   // back in sight, a WiFi access point busy on the channel
+    {15, -70, -45, 0},     // walking back
+};
+static constexpr uint32_t cleanFrames = 10 * frameHz; // the first segment
+
+typedef struct
+{
+    uint32_t delivered;
+    uint32_t frames;
+    uint32_t worstWindow; // least frames delivered in a 1 s window
+    uint32_t longestBurst;
+    double airtimeUS;
+    uint32_t framesAtHighest; // in the clean segment
+} runResult_t;
+
+static double airtimeUS(uint8_t rate)
+{
+    return phyModel[rate].preambleUS + frameBytes * 8 * 1000.0 / espnowPhyRates[rate].kbps;
+}
+
+static bool lossOf(uint8_t rate, double rssi, double interference, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> uniform(0, 1);
+    // logistic around the sensitivity: 10 % loss at it, 50 % a dB lower, 1 % about 1.5 dB higher
+    const double p = 1.0 / (1.0 + exp(2.0 * (rssi - phyModel[rate].sensitivityDBm) + log(9.0)));
+    return uniform(rng) < p || uniform(rng) < interference;
+}
+
+// adaptiveLow > adaptiveHigh: fixed at `fixed`
+static runResult_t run(const std::vector<segment_t> &trace, uint8_t fixed, uint8_t adaptiveLow, uint8_t adaptiveHigh)
+{
+    std::mt19937 rng(1234); // same fading and interference for every run
+    std::normal_distribution<double> fading(0, fadingDB);
+    const bool adaptive = adaptiveLow <= adaptiveHigh;
+    RateAdapter adapter;
+    adapter.begin(adaptiveLow, adaptiveHigh, adaptiveLow);
+
+    runResult_t result = {};
+    result.worstWindow = frameHz;
+    uint32_t window = 0;
+    uint32_t burst = 0;
+    for (const segment_t &segment : trace)
+    {
+        const uint32_t frames = segment.seconds * frameHz;
+        for (uint32_t n = 0; n < frames; n++)
+        {
+            const uint8_t rate = adaptive ? adapter.getRate() : fixed;
+            const double rssi = segment.rssiStart + (segment.rssiEnd - segment.rssiStart) * n / frames + fading(rng);
+            const bool lost = lossOf(rate, rssi, segment.interference, rng);
+            if (adaptive)
+                adapter.add(!lost);
+
+            result.frames++;
+            result.airtimeUS += airtimeUS(rate);
+            if (result.frames <= cleanFrames && rate == adaptiveHigh)
+                result.framesAtHighest++;
+            if (lost)
+            {
+                result.longestBurst = std::max(result.longestBurst, ++burst);
+            }
+            else
+            {
+                result.delivered++;
+                window++;
+                burst = 0;
+            }
+            if (result.frames % frameHz == 0)
+            {
+                result.worstWindow = std::min(result.worstWindow, window);
+                window = 0;
+            }
+        }
+    }
+    return result;
+}
+
+static void print(const char *name, const runResult_t &r)
+{
+    printf("%-14s %10.2f %10.1f %10u %12.0f\n", name, 100.0 * r.delivered / r.frames, 100.0 * r.worstWindow / frameHz,
+           r.longestBurst, r.airtimeUS / r.frames);
+}
+
+static bool loadTrace(const char *path, std::vector<segment_t> &trace)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        segment_t segment = {};
+        if (line[0] == '#')
+            continue;
+        int fields = sscanf(line, "%lf %lf %lf %lf", &segment.seconds, &segment.rssiStart, &segment.rssiEnd, &segment.interference);
+        if (fields < 3)
+            continue;
+        segment.interference /= 100;
+        trace.push_back(segment);
+    }
+    fclose(f);
+    return !trace.empty();
+}
+
+// Compare an adaptive ladder against its most robust rate, returns false when a check fails
+static bool compare(const std::vector<segment_t> &trace, const char *name, uint8_t low, uint8_t high, const runResult_t *fixed)
+{
+    runResult_t r = run(trace, 0, low, high);
+    print(name, r);
+    bool ok = true;
+    const double delivered = 100.0 * r.delivered / r.frames;
+    const double floorDelivered = 100.0 * fixed[low].delivered / fixed[low].frames;
+    if (delivered < floorDelivered - 1.0)
+    {
+        printf("FAIL: %s delivers %.2f %%, %.2f %% at %u kbit/s\n", name, delivered, floorDelivered, espnowPhyRates[low].kbps);
+        ok = false;
+    }
+    if (r.airtimeUS / r.frames > 0.8 * fixed[low].airtimeUS / fixed[low].frames)
+    {
+        printf("FAIL: %s saves less than 20 %% airtime against %u kbit/s\n", name, espnowPhyRates[low].kbps);
+        ok = false;
+    }
+    if (r.framesAtHighest < cleanFrames / 2)
+    {
+        printf("FAIL: %s sends %u of the %u clean frames at %u kbit/s\n", name, r.framesAtHighest, cleanFrames, espnowPhyRates[high].kbps);
+        ok = false;
+    }
+    return ok;
+}
+
+// The field id of a parameter menu entry
+static uint8_t fieldId(const char *name)
+{
+    uint8_t payload[2 + CRSF_PARAMETER_ENTRY_MAX];
+    for (uint8_t id = 1; id <= CRSFParameters::count(); id++)
+    {
+        if (CRSFParameters::readChunk(id, 0, CRSF_PARAMETER_ENTRY_MAX, payload) && !strcmp((const char *)&payload[4], name))
+            return id;
+    }
+    return 0;
+}
+
+// The firmware with the PHY rate at Auto and a receiver hearing up to 2 Mbit/s, returns false when a check fails
+static bool runFirmware()
+{
+    nativePreferencesClear();
+    setup();
+    loop(); // start of the handset search, as in the handset benchmark
+
+    const uint8_t auto_ = 0;
+    if (!CRSFParameters::write(fieldId("PHY Rate"), &auto_, 1))
+    {
+        printf("FAIL: PHY Rate not set to Auto\n");
+        return false;
+    }
+    uint32_t sentAt[espnowPhyRateCount] = {0};
+    nativeEspNowAck = [&](const uint8_t *, wifi_phy_rate_t rate) {
+        for (uint8_t n = 0; n < espnowPhyRateCount; n++)
+        {
+            if (espnowPhyRates[n].rate == rate)
+            {
+                if (nativeNowUS() > 1000000) // settled
+                    sentAt[n]++;
+                return espnowPhyRates[n].kbps <= 2000;
+            }
+        }
+        return false;
+    };
+
+    uint16_t channels[16];
+    std::fill(std::begin(channels), std::end(channels), CRSF_CHANNEL_VALUE_MID);
+    std::vector<uint8_t> stream;
+    benchMakeModelSelect(stream, 0);
+    for (uint32_t n = 0; n < 5 * 500; n++)
+    {
+        benchMakeRcFrame(stream, channels);
+        CRSFHandset::Port.nativeInjectRx(stream.data(), stream.size());
+        stream.clear();
+        const uint64_t next = nativeNowUS() + getPacketInterval();
+        while (nativeNowUS() < next)
+        {
+            loop();
+        }
+    }
+    nativeEspNowAck = nullptr;
+
+    phyRateStats_t stats;
+    getPhyRateStats(&stats, false);
+    const uint8_t twoM = espnowPhyRateIndex(2000);
+    uint32_t settled = 0;
+    for (uint32_t count : sentAt) settled += count;
+    printf("\nfirmware, receiver up to 2 Mbit/s: %u kbit/s, %u frames after the first second, %.1f %% of them at 2 Mbit/s, %u down, %u up, %u failed probes\n",
+           stats.kbps, settled, settled ? 100.0 * sentAt[twoM] / settled : 0.0, stats.stepsDown, stats.stepsUp, stats.failedProbes);
+    if (!stats.adaptive || settled == 0 || sentAt[twoM] < settled * 9 / 10)
+    {
+        printf("FAIL: the adaptive rate did not settle at 2 Mbit/s\n");
+        return false;
+    }
+    return true;
+}
+
+int benchPhyRate(int argc, char **argv)
+{
+    std::vector<segment_t> trace(std::begin(builtinTrace), std::end(builtinTrace));
+    if (argc > 1)
+    {
+        trace.clear();
+        if (!loadTrace(argv[1], trace))
+        {
+            printf("cannot read trace %s\n", argv[1]);
+            return 1;
+        }
+    }
+    double seconds = 0;
+    for (const segment_t &segment : trace) seconds += segment.seconds;
+    printf("%.0f s trace at %u Hz, %.0f dB fading\n\n", seconds, frameHz, fadingDB);
+
+    printf("%-14s %10s %10s %10s %12s\n", "rate", "delivered%", "worst 1s%", "burst", "airtime us");
+    runResult_t fixed[espnowPhyRateCount];
+    for (uint8_t n = 0; n < espnowPhyRateCount; n++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "%u kbit/s", espnowPhyRates[n].kbps);
+        fixed[n] = run(trace, n, 1, 0);
+        print(name, fixed[n]);
+    }
+
+    bool ok = compare(trace, "auto 1M-24M", espnowPhyRateIndex(1000), espnowPhyRateIndex(24000), fixed);
+    ok = compare(trace, "auto LR-24M", espnowPhyRateIndex(250), espnowPhyRateIndex(24000), fixed) && ok;
+    ok = runFirmware() && ok;
+    return ok ? 0 : 1;
+}
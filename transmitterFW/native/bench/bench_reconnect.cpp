@@ -0,0 +1,211 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+/* Handset search benchmark: the handset goes silent for a moment and comes back
+   at another baud rate, as after a handset reboot or a module hot-plug. EdgeTX is simulated sending one RC
+   frame per packet interval. The shim UART only delivers the handset's bytes intact when it runs at the
+   handset's baud rate, otherwise as many random bytes as the UART would sample; while the autobaud
+   measurement is enabled, its edge counter and pulse width registers follow the handset's bit time.
+   The handset sends while loop() waits, in 1 ms steps.
+   Reports the time from the handset's first byte to the first good frame, as seen by the bench (1 ms steps)
+   and by CRSFHandset::GetAutobaudStats(), the baud rates tried and the false locks, and exits with 1 when
+   a search takes longer than the limit.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include "bench.h"
+#include "common.h"
+#include "CRSFHandset.h"
+#include "NativeHAL.h"
+#include "soc/uart_reg.h"
+
+extern CRSFHandset *handset;
+void setup();
+void loop();
+
+static constexpr uint32_t maxFirstFrameMS = 100;
+static constexpr uint32_t silenceMS = 500; // shorter than the UART watchdog interval, the link loss is only seen from the new bytes
+static constexpr uint32_t edgesPerByte = 5;
+
+static uint32_t rcFrames;
+static uint64_t rcFrameUS; // virtual time of the last RC frame parsed
+static void (*firmwareRcData)() = nullptr;
+
+static void countRcFrame()
+{
+    rcFrames++;
+    rcFrameUS = nativeNowUS();
+    if (firmwareRcData) firmwareRcData();
+}
+
+class HandsetSim
+{
+public:
+    explicit HandsetSim(uint32_t periodMS) : periodMS(periodMS)
+    {
+        stream = benchMakeHandsetStream(100000, &frameEnds);
+    }
+
+    int32_t baud = 0; // of the handset, 0: silent
+
+    // One millisecond of the handset, called every millisecond loop() waits
+    void step()
+    {
+        // The autobaud measurement restarts when it is enabled
+        const bool enabled = REG_GET_BIT(UART_AUTOBAUD_REG(CRSF_UART_NUM), UART_AUTOBAUD_EN);
+        if (enabled && !measuring)
+        {
+            REG_WRITE(UART_RXD_CNT_REG(CRSF_UART_NUM), 0);
+        }
+        measuring = enabled;
+
+        if (!baud)
+        {
+            ms = 0; // the first frame goes out with the first step at a baud rate
+        }
+        else if (ms++ % periodMS == 0)
+        {
+            send(baud);
+        }
+    }
+
+private:
+    void send(int32_t baud)
+    {
+        const size_t start = frame ? frameEnds[frame - 1] : 0;
+        const size_t len = frameEnds[frame] - start;
+        frame = (frame + 1) % frameEnds.size();
+
+        const int32_t uartBaud = CRSFHandset::GetCurrentBaudRate();
+        if (uartBaud == baud)
+        {
+            CRSFHandset::Port.nativeInjectRx(&stream[start], len);
+        }
+        else
+        {
+            uint8_t garbage[CRSF_MAX_PACKET_LEN * 64];
+            const size_t count = std::max((size_t)1, std::min(sizeof(garbage), (size_t)((uint64_t)len * uartBaud / baud)));
+            for (size_t i = 0; i < count; i++)
+            {
+                garbage[i] = random();
+            }
+            CRSFHandset::Port.nativeInjectRx(garbage, count);
+        }
+
+        if (measuring)
+        {
+            const uint32_t bitClocks = (80000000 + baud / 2) / baud;
+            REG_WRITE(UART_RXD_CNT_REG(CRSF_UART_NUM), std::min(1023U, REG_READ(UART_RXD_CNT_REG(CRSF_UART_NUM)) + edgesPerByte * (uint32_t)len));
+            REG_WRITE(UART_LOWPULSE_REG(CRSF_UART_NUM), bitClocks - 3);
+            REG_WRITE(UART_HIGHPULSE_REG(CRSF_UART_NUM), bitClocks - 3);
+        }
+    }
+
+    const uint32_t periodMS;
+    std::vector<uint8_t> stream;
+    std::vector<uint32_t> frameEnds;
+    uint32_t frame = 0;
+    uint32_t ms = 0;
+    bool measuring = false;
+    std::minstd_rand random;
+};
+
+// Run loop() for `ms` of the handset at `baud`
+static void run(HandsetSim &sim, int32_t baud, uint32_t ms)
+{
+    sim.baud = baud;
+    const uint64_t end = nativeNowUS() + (uint64_t)ms * 1000;
+    while (nativeNowUS() < end)
+    {
+        loop();
+    }
+}
+
+// Silence, then the handset at `baud` until its first frame is parsed, returns the ms from its first byte
+// or 0 on timeout
+static uint32_t reconnect(HandsetSim &sim, int32_t baud)
+{
+    run(sim, 0, silenceMS);
+    const uint32_t before = rcFrames;
+    const uint64_t start = nativeNowUS();
+    sim.baud = baud;
+    while (nativeNowUS() - start < 5000 * 1000)
+    {
+        loop();
+        if (rcFrames != before)
+        {
+            return (uint32_t)((rcFrameUS - start + 999) / 1000); // the first byte went out 1 ms after the start
+        }
+    }
+    return 0;
+}
+
+int benchReconnect(int argc, char **argv)
+{
+    uint32_t rateHz = argc > 1 ? atoi(argv[1]) : 1000000 / RF_FRAME_RATE_US;
+    const uint32_t periodMS = std::max(1U, 1000 / rateHz);
+
+    setup();
+    firmwareRcData = handset->getRCDataCallback();
+    handset->setRCDataCallback(countRcFrame);
+    HandsetSim sim(periodMS);
+    nativeDelayHook = [&sim]() { sim.step(); };
+
+    printf("Handset silent for %u ms, then back at another baud rate, one RC frame every %u ms\n\n", silenceMS, periodMS);
+    printf("%8s %8s %10s %10s %9s %11s\n", "from", "to", "first ms", "stats us", "switches", "false locks");
+
+    uint32_t failures = 0;
+    int32_t from = CRSFHandset::GetCurrentBaudRate();
+    // every baud rate after every other one
+    for (int32_t to : CRSFHandset::TxToHandsetBauds)
+    {
+        for (int32_t previous : CRSFHandset::TxToHandsetBauds)
+        {
+            if (previous == to)
+                continue;
+            if (previous != from)
+            {
+                // get the handset locked at `previous` first
+                reconnect(sim, previous);
+                run(sim, previous, 20 * periodMS);
+                from = previous;
+            }
+            crsfAutobaudStats_t stats;
+            handset->GetAutobaudStats(&stats, true);
+            const uint32_t firstMS = reconnect(sim, to);
+            handset->GetAutobaudStats(&stats, false);
+            const bool ok = firstMS != 0 && firstMS <= maxFirstFrameMS && CRSFHandset::GetCurrentBaudRate() == (uint32_t)to;
+            failures += !ok;
+            printf("%8d %8d %10u %10u %9u %11u%s\n", from, to, firstMS, stats.lastUS, stats.baudSwitches, stats.falseLocks,
+                   ok ? "" : "  FAIL");
+            run(sim, to, 20 * periodMS);
+            from = to;
+        }
+    }
+
+    nativeDelayHook = nullptr;
+    if (failures)
+    {
+        printf("\nFAIL: %u searches took longer than %u ms to the first good frame\n", failures, maxFirstFrameMS);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+/* ChannelSnapshot<> stress test: a writer thread publishes RC frames as fast as it can while a reader thread
+   takes snapshots, as the handset input and the sender do. All channels of frame n are derived from n, so a
+   snapshot mixing two frames is detected. "plain" copies a volatile array channel by channel (ChannelData
+   as the sender used to read it) for comparison, "seqlock" goes through ChannelSnapshot<>. The snapshot is
+   what the sender packs, so a torn snapshot is a mixed ESP-NOW frame. Exits with 1 on a torn seqlock snapshot.
+ */
+
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include "bench.h"
+#include "ChannelSnapshot.h"
+
+static constexpr uint8_t numChannels = 16;
+
+static inline uint16_t channelValue(uint32_t n, uint8_t ch)
+{
+    return (uint16_t)(n * 40503u + ch * 131u);
+}
+
+// returns false if the channels do not all belong to the same frame
+static bool consistent(const uint16_t *channels)
+{
+    const uint32_t n = (uint16_t)(channels[0] * 30599u); // 30599 is the inverse of 40503 mod 2^16
+    for (uint8_t ch = 1; ch < numChannels; ch++)
+    {
+        if (channels[ch] != channelValue(n, ch))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct plainChannels
+{
+    volatile uint16_t channels[numChannels] = {0};
+
+    void publish(const uint16_t *values)
+    {
+        for (uint8_t ch = 0; ch < numChannels; ch++)
+        {
+            channels[ch] = values[ch];
+        }
+    }
+
+    bool read(uint16_t *values)
+    {
+        for (uint8_t ch = 0; ch < numChannels; ch++)
+        {
+            values[ch] = channels[ch];
+        }
+        return true;
+    }
+
+    uint32_t getRetries() const { return 0; }
+    uint32_t getFallbacks() const { return 0; }
+};
+
+template <class S>
+static uint64_t run(const char *name, uint32_t frames)
+{
+    static S snapshot;
+    std::atomic<bool> done{false};
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+
+    // frame 0 is in place before the reader starts, as the sender only runs once RC frames arrived
+    uint16_t first[numChannels];
+    for (uint8_t ch = 0; ch < numChannels; ch++)
+    {
+        first[ch] = channelValue(0, ch);
+    }
+    snapshot.publish(first);
+    snapshot.read(first);
+
+    auto start = benchClock::now();
+    std::thread writer([&]() {
+        uint16_t channels[numChannels];
+        for (uint32_t n = 1; n < frames; n++)
+        {
+            for (uint8_t ch = 0; ch < numChannels; ch++)
+            {
+                channels[ch] = channelValue(n, ch);
+            }
+            snapshot.publish(channels);
+        }
+        done = true;
+    });
+    std::thread reader([&]() {
+        uint16_t channels[numChannels];
+        while (!done)
+        {
+            snapshot.read(channels);
+            reads++;
+            if (!consistent(channels)) torn++;
+        }
+    });
+    writer.join();
+    reader.join();
+    double seconds = benchSecondsSince(start);
+
+    printf("%-8s %10u %10llu %10.1f %10llu %10u %10u\n", name, frames, (unsigned long long)reads,
+           reads ? seconds * 1e9 / reads : 0.0, (unsigned long long)torn, snapshot.getRetries(), snapshot.getFallbacks());
+    return torn;
+}
+
+int benchSnapshot(int argc, char **argv)
+{
+    uint32_t frames = argc > 1 ? atoi(argv[1]) : 20000000;
+
+    printf("%u channels, writer and reader thread, frames published back to back\n\n", numChannels);
+    printf("%-8s %10s %10s %10s %10s %10s %10s\n", "mode", "frames", "reads", "ns/read", "torn", "retries", "fallbacks");
+    run<plainChannels>("plain", frames);
+    if (run<ChannelSnapshot<numChannels>>("seqlock", frames))
+    {
+        printf("\nFAIL: the sender could send a frame mixing two RC frames\n");
+        return 1;
+    }
+    return 0;
+}
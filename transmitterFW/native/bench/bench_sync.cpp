@@ -0,0 +1,299 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* EdgeTX mixer sync simulator.
+   Drives MixerSync (and, for comparison, the running average it replaced) against a model of EdgeTX:
+   - the mixer runs at the packet interval off by `ppm` (crystal tolerance), each RC frame leaves after a
+     normally distributed mixer run time (`jitter` sigma) and is on the UART for 26 bytes at 400000 baud
+   - a timing packet sets the lag EdgeTX adds to its next mixer periods (at most half a period each), as in
+     EdgeTX's ModuleSyncStatus, the same lag again with every packet
+   - the module sees a frame when it polls the UART (every 1.01 ms from loop()) or 50 us after it
+     arrived (CRSF_RX_TASK)
+   Half-way through every run the mixer is set back by a third of an interval (a long mixer run).
+   Reported per run: the lock time, until the mean phase error of 200 ms windows first stays within the
+   tolerance of its final value for 1 s, at the start and after the step, and from lock on the mean and
+   sigma of the time the RC frames wait for their RF packet (true arrival) and the share of RF packets
+   that repeated a frame because the next one came late. The MixerSync runs are regression checked against fixed limits, the
+   program exits with 1 if one fails.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "MixerSync.h"
+
+static constexpr double simSeconds = 20;
+static constexpr double syncIntervalUS = 200000; // EdgeTXsyncPacketInterval
+static constexpr double frameUartUS = 26 * 10 / 0.4; // RC frame at 400000 baud
+static constexpr double syncUartUS = 15 * 10 / 0.4;  // timing packet
+static constexpr double pollUS = 1010;
+static constexpr double rxTaskUS = 50;
+static constexpr size_t lockWindows = 5; // 1 s
+
+// Limits of the regression check
+static constexpr double maxConvergeS = 4.0;
+static constexpr double maxStalePercent = 1.0;
+
+typedef struct
+{
+    uint32_t rateHz;
+    double ppm;
+    double jitterUS;
+    bool rxTask;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    {50, 0, 50, false},
+    {50, 100, 200, false},
+    {50, -100, 200, false},
+    {250, 100, 100, false},
+    {250, -100, 100, true},
+    {500, 50, 100, true},
+    {1000, -50, 50, true},
+};
+
+// The estimator of the firmware before MixerSync: running average over 20 ms of RF packets, reset by a late packet
+class LegacySync
+{
+public:
+    explicit LegacySync(int32_t intervalUS) : interval(intervalUS), windowSize(std::max((int32_t)1, 20000 / intervalUS)) {}
+
+    // returns true when a timing packet should go out right away
+    bool rfPacketSent(uint32_t nowUS, uint32_t frameUS)
+    {
+        int32_t delta = nowUS - frameUS;
+        if (delta >= interval)
+        {
+            offset = -(delta % interval) * 10;
+            window = 0;
+            return true;
+        }
+        window = std::min(window + 1, windowSize);
+        offset = (offset * (window - 1) + delta * 10) / window;
+        return false;
+    }
+
+    void update(int32_t *out) { *out = offset - 1000; }
+
+private:
+    int32_t interval;
+    int32_t windowSize;
+    int32_t window = 0;
+    int32_t offset = 0;
+};
+
+typedef struct
+{
+    double convergeS;   // < 0: never
+    double reconvergeS; // after the step
+    double waitMeanUS;
+    double waitSigmaUS;
+    double stalePercent;
+} result_t;
+
+// Lock time: from `from` until the first run of lockWindows window errors within the tolerance of where
+// they end up (their median over the last quarter of the range), -1 if there is none
+static double convergence(const std::vector<double> &windowErrors, size_t from, size_t to, double tolerance)
+{
+    std::vector<double> tail(windowErrors.begin() + to - (to - from) / 4, windowErrors.begin() + to);
+    std::nth_element(tail.begin(), tail.begin() + tail.size() / 2, tail.end());
+    const double steady = tail[tail.size() / 2];
+    size_t run = 0;
+    for (size_t w = from; w < to; w++)
+    {
+        run = fabs(windowErrors[w] - steady) > tolerance ? 0 : run + 1;
+        if (run == lockWindows)
+            return (w + 1 - lockWindows - from) * syncIntervalUS / 1e6;
+    }
+    return -1;
+}
+
+template <class Sync>
+static result_t simulate(const scenario_t &s, Sync &sync, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> jitter(0, s.jitterUS);
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    const double interval = 1e6 / s.rateHz;
+    const double mixerPeriod = interval * (1 + s.ppm * 1e-6);
+    const double stepAt = simSeconds * 1e6 / 2;
+
+    double mixerStart = uniform(rng) * interval; // EdgeTX starts at any phase
+    double lag = 0;                              // from the last timing packet
+    double pendingLag = 0, pendingLagAt = -1;    // timing packet on the wire
+    bool stepped = false;
+
+    // RC frames, true arrival and when the module sees it
+    double arrival = -1e9, seen = -1e9, nextArrival = 0, nextSeen = 0;
+    double pollPhase = uniform(rng) * pollUS;
+    uint64_t frameCount = 0, lastSentFrame = 0, seenFrame = 0, nextFrame = 0;
+    auto scheduleFrame = [&]() {
+        nextArrival = mixerStart + std::max(0.0, 200 + jitter(rng)) + frameUartUS;
+        nextSeen = s.rxTask ? nextArrival + rxTaskUS : pollPhase + ceil((nextArrival - pollPhase) / pollUS) * pollUS;
+        nextFrame = ++frameCount;
+        // the next mixer run, EdgeTX moves it by the lag it was told, half a period at most per run
+        double adjust = std::max(-mixerPeriod / 2, std::min(mixerPeriod / 2, lag));
+        lag -= adjust;
+        mixerStart += mixerPeriod + adjust;
+        if (!stepped && mixerStart >= stepAt)
+        {
+            mixerStart += interval / 3;
+            stepped = true;
+        }
+    };
+    scheduleFrame();
+
+    std::vector<double> windowErrors;
+    double windowSum = 0;
+    uint32_t windowN = 0;
+    double nextSync = syncIntervalUS;
+    bool syncNow = false;
+
+    double waitSum = 0, waitSq = 0;
+    uint32_t waitN = 0, stale = 0, slots = 0;
+    std::vector<double> waits; // per slot after the step window, evaluated later
+    std::vector<std::pair<double, bool>> slotLog;
+
+    for (double t = interval; t < simSeconds * 1e6; t += interval)
+    {
+        // Frames and timing packets up to this RF slot
+        while (nextSeen <= t)
+        {
+            arrival = nextArrival;
+            seen = nextSeen;
+            seenFrame = nextFrame;
+            // the firmware sends a timing packet after handling a frame, once the sync interval is up
+            if (syncNow || seen >= nextSync)
+            {
+                int32_t offset;
+                sync.update(&offset);
+                pendingLag = offset / 10.0;
+                pendingLagAt = seen + syncUartUS;
+                nextSync = seen + syncIntervalUS;
+                syncNow = false;
+            }
+            if (pendingLagAt >= 0 && pendingLagAt <= mixerStart)
+            {
+                lag = pendingLag;
+                pendingLagAt = -1;
+            }
+            scheduleFrame();
+        }
+
+        // RF packet
+        if (sync.rfPacketSent((uint32_t)t, (uint32_t)seen))
+            syncNow = true;
+        double error = t - seen - MIXER_SYNC_MARGIN_US;
+        error -= interval * round(error / interval);
+        windowSum += error;
+        if (++windowN == (uint32_t)(syncIntervalUS / interval))
+        {
+            windowErrors.push_back(windowSum / windowN);
+            windowSum = 0;
+            windowN = 0;
+        }
+        slotLog.push_back({t - arrival, seenFrame == lastSentFrame});
+        lastSentFrame = seenFrame;
+    }
+
+    result_t r = {};
+    const double tolerance = std::max(100.0, interval / 20);
+    const size_t half = windowErrors.size() / 2;
+    r.convergeS = convergence(windowErrors, 0, half, tolerance);
+    r.reconvergeS = convergence(windowErrors, half + 1, windowErrors.size(), tolerance);
+
+    // Steady state: from convergence to the step, and from reconvergence to the end
+    const double slotsPerWindow = syncIntervalUS / interval;
+    for (size_t i = 0; i < slotLog.size(); i++)
+    {
+        double w = i / slotsPerWindow;
+        bool first = r.convergeS >= 0 && w >= r.convergeS * 1e6 / syncIntervalUS && w < half;
+        bool second = r.reconvergeS >= 0 && w >= half + 1 + r.reconvergeS * 1e6 / syncIntervalUS;
+        if (!first && !second)
+            continue;
+        slots++;
+        if (slotLog[i].second)
+        {
+            stale++;
+            continue;
+        }
+        waitSum += slotLog[i].first;
+        waitSq += slotLog[i].first * slotLog[i].first;
+        waitN++;
+    }
+    r.waitMeanUS = waitN ? waitSum / waitN : 0;
+    r.waitSigmaUS = waitN ? sqrt(std::max(0.0, waitSq / waitN - r.waitMeanUS * r.waitMeanUS)) : 0;
+    r.stalePercent = slots ? 100.0 * stale / slots : 100;
+    return r;
+}
+
+// MixerSync as the simulation expects it
+class MixerSyncSim
+{
+public:
+    explicit MixerSyncSim(uint32_t intervalUS) { sync.begin(intervalUS); }
+    bool rfPacketSent(uint32_t nowUS, uint32_t frameUS)
+    {
+        sync.rfPacketSent(nowUS, frameUS);
+        return false;
+    }
+    void update(int32_t *offset) { sync.update(offset); }
+    MixerSync sync;
+};
+
+static void printResult(const scenario_t &s, const char *name, const result_t &r, const char *ppm, const char *check)
+{
+    char converge[16], reconverge[16];
+    snprintf(converge, sizeof(converge), r.convergeS < 0 ? "never" : "%.1f", r.convergeS);
+    snprintf(reconverge, sizeof(reconverge), r.reconvergeS < 0 ? "never" : "%.1f", r.reconvergeS);
+    printf("%5u %6.0f %6.0f %-7s %-9s %8s %8s %8.0f %8.0f %7.2f %8s %6s\n", s.rateHz, s.ppm, s.jitterUS, s.rxTask ? "task" : "poll",
+           name, converge, reconverge, r.waitMeanUS, r.waitSigmaUS, r.stalePercent, ppm, check);
+}
+
+int benchSync(int argc, char **argv)
+{
+    uint32_t seed = argc > 1 ? atoi(argv[1]) : 1;
+    bool failed = false;
+
+    printf("%.0f s per run, mixer set back by 1/3 interval at %.0f s, tolerance max(100 us, interval / 20)\n\n", simSeconds, simSeconds / 2);
+    printf("%5s %6s %6s %-7s %-9s %8s %8s %8s %8s %7s %8s %6s\n",
+           "Hz", "ppm", "jitter", "input", "sync", "lock s", "relock s", "wait us", "sigma", "stale%", "est ppm", "check");
+    for (const scenario_t &s : scenarios)
+    {
+        const uint32_t intervalUS = 1000000 / s.rateHz;
+        LegacySync legacy(intervalUS);
+        printResult(s, "average", simulate(s, legacy, seed), "-", "");
+
+        MixerSyncSim pi(intervalUS);
+        result_t r = simulate(s, pi, seed);
+        bool ok = r.convergeS >= 0 && r.convergeS <= maxConvergeS && r.reconvergeS >= 0 && r.reconvergeS <= maxConvergeS &&
+                  r.stalePercent <= maxStalePercent;
+        failed |= !ok;
+        // the drift the controller has learned, from its period error estimate
+        mixerSyncStats_t stats;
+        pi.sync.getStats(&stats);
+        char ppm[16];
+        snprintf(ppm, sizeof(ppm), "%.0f", stats.periodErrorNS * 1e3 / intervalUS);
+        printResult(s, "PI", r, ppm, ok ? "ok" : "FAIL");
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Telemetry to the handset under load. EdgeTX is simulated as in the latency benchmark, at the baud rate the
+   handset is locked at (the start baud rate of 5250000 in the shim) and at every packet rate, while more telemetry
+   is queued than the handset takes: five forwarded frames after every RC frame and a device information frame
+   every 50. The bytes the firmware writes to the UART are parsed back,
+   the mixer sync (timing) packets must keep their period, checked against EdgeTXsyncPacketInterval plus three
+   packet intervals: exits with 1 when exceeded. Then a burst of link statistics is queued at once, only the newest
+   must reach the handset, the others replaced (exits with 1 otherwise). Prints the counters per telemetry class, see
+   CRSFHandset::GetTelemetryStats(). Build for a half-duplex target to see the window limit instead of the
+   token bucket of a full duplex line.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "bench.h"
+#include "common.h"
+#include "CRSF.h"
+#include "CRSFHandset.h"
+#include "NativeHAL.h"
+
+extern CRSFHandset *handset;
+void setup();
+void loop();
+
+static constexpr uint32_t syncPeriodMS = 200; // EdgeTXsyncPacketInterval
+static constexpr uint8_t gpsFrameType = 0x02;  // CRSF GPS, passed through by the module
+static const char *const classNames[telemetryClassCount] = {"timing", "link stats", "device info", "forwarded"};
+
+static std::vector<uint8_t> txStream;  // bytes written to the handset, not yet parsed
+static std::vector<uint64_t> syncTimes; // virtual time of every mixer sync packet written
+static std::vector<uint8_t> linkQualities; // uplink link quality of every link statistics frame written
+
+static void parseTx(const uint8_t *data, size_t len)
+{
+    txStream.insert(txStream.end(), data, data + len);
+    while (txStream.size() >= 2 && txStream.size() >= (size_t)txStream[1] + 2)
+    {
+        const size_t frameLen = txStream[1] + 2;
+        if (txStream[2] == CRSF_FRAMETYPE_HANDSET && frameLen > 5 && txStream[5] == CRSF_HANDSET_SUBCMD_TIMING)
+        {
+            syncTimes.push_back(nativeNowUS());
+        }
+        if (txStream[2] == CRSF_FRAMETYPE_LINK_STATISTICS && frameLen >= CRSF_FRAME_SIZE(sizeof(crsfLinkStatistics_t)) + 2)
+        {
+            linkQualities.push_back(((const crsfLinkStatistics_t *)&txStream[3])->uplink_Link_quality);
+        }
+        txStream.erase(txStream.begin(), txStream.begin() + frameLen);
+    }
+}
+
+// A telemetry frame as the model's receiver would send it, `payload` bytes of GPS-like data
+static void queueForwarded(uint8_t payload, uint8_t seq)
+{
+    uint8_t frame[CRSF_MAX_PACKET_LEN];
+    frame[0] = CRSF_ADDRESS_RADIO_TRANSMITTER;
+    frame[CRSF_TELEMETRY_LENGTH_INDEX] = payload + 2;
+    frame[CRSF_TELEMETRY_TYPE_INDEX] = gpsFrameType;
+    for (uint8_t i = 0; i < payload; i++)
+        frame[3 + i] = seq + i;
+    frame[3 + payload] = crsf_crc.calc(&frame[2], payload + 1);
+    handset->sendTelemetryToTX(frame);
+}
+
+static void feed(uint32_t frames, uint32_t periodUS, int32_t baud)
+{
+    const double byteUS = 10 * 1e6 / baud;
+    uint16_t channels[16];
+    std::fill(std::begin(channels), std::end(channels), CRSF_CHANNEL_VALUE_MID);
+    std::vector<uint8_t> frame;
+    uint8_t deviceInfo[48] = {0};
+    const uint64_t start = nativeNowUS();
+
+    for (uint32_t n = 0; n < frames; n++)
+    {
+        frame.clear();
+        benchMakeRcFrame(frame, channels);
+        const uint64_t frameStart = start + (uint64_t)n * periodUS;
+        size_t sent = 0;
+        while (sent < frame.size())
+        {
+            const uint64_t now = nativeNowUS();
+            size_t due = now < frameStart ? 0 : std::min(frame.size(), (size_t)((now - frameStart) / byteUS) + 1);
+            if (due > sent)
+            {
+                CRSFHandset::Port.nativeInjectRx(&frame[sent], due - sent);
+                sent = due;
+            }
+            loop();
+        }
+        for (uint8_t f = 0; f < 5; f++)
+            queueForwarded(28, n + f);
+        if (n % 50 == 0)
+            CRSFHandset::packetQueueExtended(CRSF_FRAMETYPE_DEVICE_INFO, deviceInfo, sizeof(deviceInfo));
+    }
+}
+
+int benchTelemetry(int argc, char **argv)
+{
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : 10;
+    const int32_t baud = CRSFHandset::GetCurrentBaudRate();
+
+    setup();
+    loop(); // start of the handset search, as in the handset benchmark
+    CRSFHandset::Port.nativeOnTx = parseTx;
+
+    printf("%s duplex at %d baud, more telemetry queued than the handset takes for %u s per packet rate\n\n",
+           CRSFHandset::isHalfDuplex() ? "half" : "full", baud, seconds);
+    printf("%8s %8s %12s %-12s %8s %8s %8s %8s\n", "rate Hz", "syncs", "max gap ms", "class", "queued", "sent", "deferred", "dropped");
+
+    bool failed = false;
+    std::vector<uint8_t> select;
+    benchMakeModelSelect(select, 0);
+    CRSFHandset::Port.nativeInjectRx(select.data(), select.size());
+    for (uint32_t intervalUS : RFpacketIntervalsUS)
+    {
+        if (!setPacketInterval(intervalUS))
+            continue;
+
+        feed(100, intervalUS, baud); // connect and settle
+        crsfTelemetryStats_t stats[telemetryClassCount];
+        handset->GetTelemetryStats(stats, true);
+        txStream.clear();
+        syncTimes.clear();
+
+        feed(seconds * 1000000 / intervalUS, intervalUS, baud);
+        handset->GetTelemetryStats(stats, false);
+        uint64_t maxGapUS = 0;
+        for (size_t n = 1; n < syncTimes.size(); n++)
+            maxGapUS = std::max(maxGapUS, syncTimes[n] - syncTimes[n - 1]);
+        const bool late = syncTimes.size() < 2 || maxGapUS > syncPeriodMS * 1000 + 3 * intervalUS;
+        failed |= late;
+
+        for (uint8_t c = 0; c < telemetryClassCount; c++)
+        {
+            if (c == 0)
+                printf("%8u %8u %12.1f", 1000000 / intervalUS, (unsigned)syncTimes.size(), maxGapUS / 1000.0);
+            else
+                printf("%8s %8s %12s", "", "", "");
+            printf(" %-12s %8u %8u %8u %8u%s\n", classNames[c], stats[c].queued, stats[c].sent, stats[c].deferred, stats[c].dropped,
+                   c == 0 && late ? "  LATE" : "");
+        }
+    }
+
+    // Link statistics queued faster than they go out, the newest replaces the waiting one
+    crsfTelemetryStats_t before[telemetryClassCount], after[telemetryClassCount];
+    handset->GetTelemetryStats(before, false);
+    linkQualities.clear();
+    constexpr uint8_t burst = 20;
+    for (uint8_t lq = 1; lq <= burst; lq++)
+    {
+        uint8_t frame[CRSF_FRAME_SIZE(sizeof(crsfLinkStatistics_t)) + CRSF_FRAME_NOT_COUNTED_BYTES];
+        CRSF::LinkStatistics.uplink_Link_quality = lq;
+        CRSFHandset::makeLinkStatisticsPacket(frame);
+        handset->sendTelemetryToTX(frame);
+    }
+    feed(10, getPacketInterval(), baud);
+    handset->GetTelemetryStats(after, false);
+    const uint32_t replaced = after[telemetryLinkStats].dropped - before[telemetryLinkStats].dropped;
+    printf("\n%u link statistics queued at once: first one sent has link quality %d, %u replaced\n", burst,
+           linkQualities.empty() ? -1 : linkQualities.front(), replaced);
+    const bool stale = linkQualities.empty() || linkQualities.front() != burst || replaced < burst - 1;
+    CRSFHandset::Port.nativeOnTx = nullptr;
+
+    if (failed)
+    {
+        printf("\nFAIL: a mixer sync packet came later than %u ms plus three packet intervals\n", syncPeriodMS);
+        return 1;
+    }
+    if (stale)
+    {
+        printf("\nFAIL: the link statistics sent were not the newest\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* RC channel unpacking: crsfUnpackChannels() vs. the BetaFlight bit-merging loop it replaced.
+   The two are first checked for identical results on every 11-bit value in every channel slot, on
+   every single set bit and on random frames, then both are timed on a set of pre-built frames.
+   The same frames also check crsfPackChannels() (as used for the ESP-NOW frames) against the
+   bit-by-bit packing of benchMakeRcFrame().
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include "bench.h"
+#include "common.h"
+#include "CRSF.h"
+#include "crsf_bitpack.h"
+#include "espnow_protocol.h"
+
+static constexpr unsigned channelBits = 11;
+static constexpr unsigned firstBit = offsetof(rcPacket_t, channels) * 8;
+
+// code from BetaFlight rx/crsf.cpp / bitpacker_unpack, as used by CRSFHandset::RcPacketToChannelsData() before
+static void __attribute__((noinline)) unpackLoop(const inBuffer_U &in, volatile uint16_t *channels)
+{
+    auto payload = (uint8_t const * const)&in.asRCPacket_t.channels;
+    uint8_t bitsMerged = 0;
+    uint32_t readValue = 0;
+    unsigned readByteIndex = 0;
+    for (unsigned ch = 0; ch < CRSF_NUM_CHANNELS; ch++)
+    {
+        while (bitsMerged < channelBits)
+        {
+            readValue |= ((uint32_t)payload[readByteIndex++]) << bitsMerged;
+            bitsMerged += 8;
+        }
+        channels[ch] = (uint16_t)(readValue & ((1 << channelBits) - 1));
+        readValue >>= channelBits;
+        bitsMerged -= channelBits;
+    }
+}
+
+static void __attribute__((noinline)) unpackWords(const inBuffer_U &in, volatile uint16_t *channels)
+{
+    crsfUnpackChannels<channelBits, CRSF_NUM_CHANNELS, firstBit>(in.asUint32_t, channels);
+}
+
+static void makeFrame(inBuffer_U &in, const uint16_t *channels)
+{
+    std::vector<uint8_t> frame;
+    benchMakeRcFrame(frame, channels);
+    memset(&in, 0xA5, sizeof(in)); // bytes past the frame must not leak into the channels
+    memcpy(in.asUint8_t, frame.data(), frame.size());
+}
+
+static bool compare(const inBuffer_U &in, const uint16_t *channels, const char *what)
+{
+    espnowRcChannelsPacket_t packet;
+    espnowRcPackChannels(&packet, channels, 0);
+    if (memcmp(packet.channels, &in.asRCPacket_t.channels, sizeof(packet.channels)) != 0)
+    {
+        printf("MISMATCH (%s): packed ESP-NOW channels differ from the CRSF payload\n", what);
+        return false;
+    }
+
+    volatile uint16_t expected[CRSF_NUM_CHANNELS];
+    volatile uint16_t actual[CRSF_NUM_CHANNELS];
+    unpackLoop(in, expected);
+    unpackWords(in, actual);
+    for (unsigned ch = 0; ch < CRSF_NUM_CHANNELS; ch++)
+    {
+        if (expected[ch] != actual[ch])
+        {
+            printf("MISMATCH (%s): channel %u is %u, expected %u\n", what, ch + 1, actual[ch], expected[ch]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkEquivalence(std::mt19937 &rng, uint32_t &checked)
+{
+    inBuffer_U in;
+    uint16_t channels[CRSF_NUM_CHANNELS];
+
+    // Every value in every slot, the neighbours random
+    for (unsigned slot = 0; slot < CRSF_NUM_CHANNELS; slot++)
+    {
+        for (unsigned value = 0; value < (1U << channelBits); value++)
+        {
+            for (auto &ch : channels) ch = rng() & ((1 << channelBits) - 1);
+            channels[slot] = value;
+            makeFrame(in, channels);
+            if (!compare(in, channels, "value sweep")) return false;
+            checked++;
+        }
+    }
+
+    // Every single bit of the payload, the other bits all clear and all set
+    for (unsigned bit = 0; bit < CRSF_NUM_CHANNELS * channelBits; bit++)
+    {
+        for (uint16_t fill : {0, (1 << channelBits) - 1})
+        {
+            for (auto &ch : channels) ch = fill;
+            channels[bit / channelBits] ^= 1 << (bit % channelBits);
+            makeFrame(in, channels);
+            if (!compare(in, channels, "single bit")) return false;
+            checked++;
+        }
+    }
+
+    for (unsigned n = 0; n < 100000; n++)
+    {
+        for (auto &ch : channels) ch = rng() & ((1 << channelBits) - 1);
+        makeFrame(in, channels);
+        if (!compare(in, channels, "random")) return false;
+        checked++;
+    }
+    return true;
+}
+
+static void timeUnpacker(const char *name, void (*unpack)(const inBuffer_U &, volatile uint16_t *),
+                         const std::vector<inBuffer_U> &frames, uint32_t rounds)
+{
+    volatile uint16_t channels[CRSF_NUM_CHANNELS];
+    auto start = benchClock::now();
+    uint64_t cycles = benchCycles();
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (const auto &in : frames)
+        {
+            unpack(in, channels);
+        }
+    }
+    cycles = benchCycles() - cycles;
+    double seconds = benchSecondsSince(start);
+    double calls = (double)rounds * frames.size();
+    printf("%-8s %10.0f %10.2f %12.1f\n", name, calls, seconds * 1e9 / calls, cycles / calls);
+}
+
+int benchUnpack(int argc, char **argv)
+{
+    uint32_t rounds = argc > 1 ? atoi(argv[1]) : 10000;
+    std::mt19937 rng(1);
+
+    uint32_t checked = 0;
+    if (!checkEquivalence(rng, checked))
+    {
+        return 1;
+    }
+    printf("crsfUnpackChannels<%u, %u, %u>() and crsfPackChannels() match the bit-by-bit reference on %u frames\n\n",
+           channelBits, CRSF_NUM_CHANNELS, firstBit, checked);
+
+    std::vector<inBuffer_U> frames(1024);
+    uint16_t channels[CRSF_NUM_CHANNELS];
+    for (auto &in : frames)
+    {
+        for (auto &ch : channels) ch = CRSF_CHANNEL_VALUE_MIN + rng() % (CRSF_CHANNEL_VALUE_MAX - CRSF_CHANNEL_VALUE_MIN + 1);
+        makeFrame(in, channels);
+    }
+
+    printf("%-8s %10s %10s %12s\n", "unpacker", "frames", "ns/frame", benchCycleUnit);
+    timeUnpacker("loop", unpackLoop, frames, rounds);
+    timeUnpacker("words", unpackWords, frames, rounds);
+    return 0;
+}
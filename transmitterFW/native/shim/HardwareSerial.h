@@ -0,0 +1,93 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+#define SERIAL_8N1 0x800001c
+
+typedef enum
+{
+    UART_NO_ERROR,
+    UART_BREAK_ERROR,
+    UART_BUFFER_FULL_ERROR,
+    UART_FIFO_OVF_ERROR,
+    UART_FRAME_ERROR,
+    UART_PARITY_ERROR
+} hardwareSerial_error_t;
+
+typedef std::function<void(hardwareSerial_error_t)> OnReceiveErrorCb;
+typedef std::function<void(void)> OnReceiveCb;
+
+/**
+ * @brief Host stand-in for the ESP32 Arduino HardwareSerial.
+ *
+ * Received bytes are injected by the host code into a bounded ring buffer of the same default size as the
+ * ESP32 Arduino core (256 bytes), bytes that do not fit are counted as dropped and reported to the
+ * onReceiveError() callback as UART_BUFFER_FULL_ERROR, like a UART RX overflow.
+ * The onReceive() callback is called once per injection that delivered bytes, standing in for the UART
+ * RX FIFO-full and RX-timeout events.
+ * Transmitted bytes are counted, and take their time on the line at the baud rate (see uart_wait_tx_done()).
+ */
+class HardwareSerial
+{
+public:
+    HardwareSerial(int uart_nr) : uartNr(uart_nr) {}
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1, bool invert = false, unsigned long timeout_ms = 20000UL);
+    void end() {}
+    void updateBaudRate(unsigned long baud) { _baudRate = baud; }
+    uint32_t baudRate() const { return _baudRate; }
+    void setTimeout(unsigned long) {}
+    size_t setRxBufferSize(size_t new_size);
+    bool setRxFIFOFull(uint8_t) { return true; } // the hardware RX FIFO is not modelled
+    bool setRxTimeout(uint8_t) { return true; }
+    void onReceiveError(OnReceiveErrorCb function) { onError = function; }
+    void onReceive(OnReceiveCb function, bool onlyOnTimeout = false) { onRx = function; (void)onlyOnTimeout; }
+
+    int available();
+    int read();
+    size_t readBytes(uint8_t *buffer, size_t length);
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size);
+    void flush() {}
+
+    /// Host side hooks ///
+    size_t nativeInjectRx(const uint8_t *data, size_t len);
+    void nativeReset();
+
+    uint32_t nativeRxConsumed = 0; // bytes read by the firmware
+    uint32_t nativeRxDropped = 0;  // bytes lost because the RX buffer was full
+    uint32_t nativeTxBytes = 0;    // bytes written by the firmware
+    std::function<void(const uint8_t *, size_t)> nativeOnTx; // sees every write of the firmware, if set
+
+private:
+    static constexpr size_t RX_BUFFER_MAX = 4096;
+
+    int uartNr;
+    unsigned long _baudRate = 0;
+    size_t rxBufferSize = 256;
+    uint8_t rxBuffer[RX_BUFFER_MAX] = {0};
+    size_t rxHead = 0;
+    size_t rxCount = 0;
+    OnReceiveErrorCb onError;
+    OnReceiveCb onRx;
+};
@@ -0,0 +1,656 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <map>
+#include <vector>
+#include <ucontext.h>
+#include "Arduino.h"
+#include "WiFi.h"
+#include "esp_now.h"
+#include "hal/uart_ll.h"
+#include "soc/soc.h"
+#include "soc/gpio_periph.h"
+#include "driver/uart.h"
+#include "NativeHAL.h"
+#include <thread>
+#include <chrono>
+
+NativeWiFiClass WiFi;
+uart_dev_t nativeUartDev[3] = {{0}, {1}, {2}};
+uint64_t nativeUartTxDoneUS[3] = {0};
+nativeEspNowStats_t nativeEspNow = {};
+uint32_t nativeEspNowAddPeerFailures = 0;
+std::function<bool(const uint8_t *peer, wifi_phy_rate_t rate)> nativeEspNowAck;
+nativeTimerIsrStats_t nativeTimerIsr = {};
+
+/// esp_system ///
+
+esp_reset_reason_t esp_reset_reason()
+{
+    return ESP_RST_POWERON;
+}
+
+/// Critical sections ///
+
+void nativeEnterCritical(portMUX_TYPE *mux)
+{
+    // On the ESP32 the holder of a critical section cannot be preempted, a host thread can.
+    // Yield after a short spin so a preempted holder gets to run on hosts with few cores.
+    int expected = 0;
+    for (uint32_t spins = 1; !mux->locked.compare_exchange_weak(expected, 1, std::memory_order_acquire); spins++)
+    {
+        expected = 0;
+        if (spins % 64 == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void nativeExitCritical(portMUX_TYPE *mux)
+{
+    mux->locked.store(0, std::memory_order_release);
+}
+
+/// FreeRTOS tasks ///
+
+// The host runs the firmware on one thread, as one core. A task is a coroutine that runs from the moment
+// it is created or notified until it blocks in ulTaskNotifyTake() again, like a task of higher priority than
+// the code that woke it; a task notified from the timer ISR runs when the ISR has returned, one whose wait timed
+// out when the virtual clock has passed the timeout. Priorities are not modelled. All tasks share core 0.
+struct nativeTask_s
+{
+    ucontext_t context;
+    ucontext_t *resumer; // context that switched to the task, it returns there when it blocks
+    std::vector<uint8_t> stack;
+    uint32_t stackDepth; // as requested, the host stack is larger
+    UBaseType_t priority;
+    TaskFunction_t function;
+    void *param;
+    uint32_t notifications;
+    bool blocked;
+    uint64_t timeoutUS; // virtual time ulTaskNotifyTake() gives up waiting at
+};
+
+static constexpr uint32_t nativeTaskMinStack = 64 * 1024; // the host needs more stack than the ESP32
+static constexpr uint8_t nativeStackPaint = 0xA5;         // unused stack, for the high-water mark
+static std::vector<nativeTask_s *> nativeTasks;
+static nativeTask_s *nativeCurrentTask = nullptr; // nullptr: setup()/loop() or the host code
+
+static void nativeSwitchTo(nativeTask_s *task)
+{
+    ucontext_t here;
+    nativeTask_s *previous = nativeCurrentTask;
+    task->resumer = &here;
+    task->blocked = false;
+    nativeCurrentTask = task;
+    swapcontext(&here, &task->context);
+    nativeCurrentTask = previous;
+}
+
+static void nativeTaskEntry()
+{
+    nativeTask_s *task = nativeCurrentTask;
+    task->function(task->param);
+    // A FreeRTOS task must not return, block for good
+    task->blocked = true;
+    task->notifications = 0;
+    task->timeoutUS = UINT64_MAX;
+    for (;;)
+    {
+        swapcontext(&task->context, task->resumer);
+    }
+}
+
+// Run the tasks notified from an ISR
+static void nativeRunNotifiedTasks()
+{
+    for (nativeTask_s *task : nativeTasks)
+    {
+        if (task->blocked && task->notifications && task != nativeCurrentTask)
+        {
+            nativeSwitchTo(task);
+        }
+    }
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth, void *param, UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void)name;
+    auto *task = new nativeTask_s();
+    task->stack.resize(std::max(stackDepth, nativeTaskMinStack), nativeStackPaint);
+    task->stackDepth = stackDepth;
+    task->priority = priority;
+    task->function = function;
+    task->param = param;
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = task->stack.data();
+    task->context.uc_stack.ss_size = task->stack.size();
+    task->context.uc_link = nullptr;
+    makecontext(&task->context, nativeTaskEntry, 0);
+    nativeTasks.push_back(task);
+    if (handle) *handle = task;
+    nativeSwitchTo(task); // runs until it first blocks
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *param, UBaseType_t priority,
+                                   TaskHandle_t *handle, BaseType_t core)
+{
+    (void)core;
+    return xTaskCreate(function, name, stackDepth, param, priority, handle);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return nativeCurrentTask;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    if (!task) task = nativeCurrentTask;
+    return task ? task->priority : 1; // the host code stands in for the Arduino loop task
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    if (!task) task = nativeCurrentTask;
+    if (!task)
+    {
+        return 0; // the host thread's stack is not measured
+    }
+    // The stack grows down from the end, count the bytes never written at its start
+    size_t unused = 0;
+    while (unused < task->stack.size() && task->stack[unused] == nativeStackPaint)
+    {
+        unused++;
+    }
+    const size_t used = task->stack.size() - unused;
+    return used < task->stackDepth ? task->stackDepth - used : 0;
+}
+
+BaseType_t xPortGetCoreID()
+{
+    return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    task->notifications++;
+    if (task->blocked && task != nativeCurrentTask)
+    {
+        nativeSwitchTo(task);
+    }
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    task->notifications++;
+    if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+    nativeTask_s *task = nativeCurrentTask;
+    if (!task)
+    {
+        return 0; // the host code cannot block
+    }
+    if (task->notifications == 0)
+    {
+        task->timeoutUS = ticksToWait == portMAX_DELAY ? UINT64_MAX : nativeNowUS() + (uint64_t)ticksToWait * 1000;
+        task->blocked = true;
+        swapcontext(&task->context, task->resumer);
+    }
+    const uint32_t value = task->notifications;
+    task->notifications = clearCountOnExit ? 0 : value - 1;
+    return value;
+}
+
+/// FreeRTOS mutexes ///
+
+// A task is not switched out while it holds a mutex on the host, so a mutex is never found taken
+struct nativeMutex_s
+{
+    bool taken;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new nativeMutex_s();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticksToWait)
+{
+    (void)ticksToWait;
+    if (mutex->taken)
+    {
+        return pdFALSE;
+    }
+    mutex->taken = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    mutex->taken = false;
+    return pdTRUE;
+}
+
+/// Hardware timer ///
+
+struct hw_timer_s
+{
+    void (*isr)(void);
+    bool started;
+    bool armed;
+    bool autoreload;
+    uint64_t periodUS;
+    uint64_t nextAlarmUS;
+};
+
+static hw_timer_t nativeTimer = {};
+static uint32_t nativeTimerTicksPerUS = 1;
+
+hw_timer_t *timerBegin(uint32_t frequency)
+{
+    nativeTimerTicksPerUS = frequency / 1000000 ? frequency / 1000000 : 1;
+    return &nativeTimer;
+}
+
+void timerStart(hw_timer_t *timer)
+{
+    timer->started = true;
+}
+
+void timerStop(hw_timer_t *timer)
+{
+    timer->started = false;
+}
+
+void timerRestart(hw_timer_t *timer)
+{
+    // the counter starts over, the next alarm is one period from now
+    timer->nextAlarmUS = nativeNowUS() + timer->periodUS;
+}
+
+void timerAttachInterrupt(hw_timer_t *timer, void (*userFunc)(void))
+{
+    timer->isr = userFunc;
+}
+
+void timerAlarm(hw_timer_t *timer, uint64_t alarm_value, bool autoreload, uint64_t reload_count)
+{
+    (void)reload_count;
+    timer->periodUS = alarm_value / nativeTimerTicksPerUS;
+    timer->autoreload = autoreload;
+    timer->armed = timer->periodUS != 0;
+    timer->nextAlarmUS = nativeNowUS() + timer->periodUS;
+}
+
+/// Virtual clock ///
+
+static uint64_t nowUS = 0;
+
+uint64_t nativeNowUS()
+{
+    return nowUS;
+}
+
+void nativeAdvanceUS(uint32_t us)
+{
+    const uint64_t target = nowUS + us;
+    while (nativeTimer.started && nativeTimer.armed && nativeTimer.nextAlarmUS <= target)
+    {
+        nowUS = nativeTimer.nextAlarmUS;
+        if (nativeTimer.autoreload)
+        {
+            nativeTimer.nextAlarmUS += nativeTimer.periodUS;
+        }
+        else
+        {
+            nativeTimer.armed = false;
+        }
+        if (nativeTimer.isr)
+        {
+            auto start = std::chrono::steady_clock::now();
+            nativeTimer.isr();
+            const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            nativeTimerIsr.calls++;
+            nativeTimerIsr.totalNS += ns;
+            nativeTimerIsr.maxNS = std::max(nativeTimerIsr.maxNS, ns);
+        }
+        nativeRunNotifiedTasks();
+    }
+    nowUS = target;
+    for (nativeTask_s *task : nativeTasks)
+    {
+        if (task->blocked && task->timeoutUS <= nowUS && task != nativeCurrentTask)
+        {
+            nativeSwitchTo(task);
+        }
+    }
+}
+
+unsigned long micros()
+{
+    return (unsigned long)(uint32_t)nowUS;
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(uint32_t)(nowUS / 1000);
+}
+
+std::function<void()> nativeDelayHook;
+
+void delay(uint32_t ms)
+{
+    for (uint32_t n = 0; n < ms; n++)
+    {
+        nativeAdvanceUS(1000);
+        if (nativeDelayHook) nativeDelayHook();
+    }
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    nativeAdvanceUS(us);
+}
+
+/// Registers ///
+
+static std::map<uint32_t, uint32_t> nativeRegisters;
+
+uint32_t nativeRegRead(uint32_t addr)
+{
+    auto reg = nativeRegisters.find(addr);
+    return reg == nativeRegisters.end() ? 0 : reg->second;
+}
+
+void nativeRegWrite(uint32_t addr, uint32_t val)
+{
+    nativeRegisters[addr] = val;
+}
+
+/// HardwareSerial ///
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin, bool invert, unsigned long timeout_ms)
+{
+    (void)config; (void)rxPin; (void)txPin; (void)invert; (void)timeout_ms;
+    _baudRate = baud;
+    nativeReset();
+}
+
+size_t HardwareSerial::setRxBufferSize(size_t new_size)
+{
+    rxBufferSize = std::min(new_size, RX_BUFFER_MAX);
+    nativeReset();
+    return rxBufferSize;
+}
+
+int HardwareSerial::available()
+{
+    return (int)rxCount;
+}
+
+int HardwareSerial::read()
+{
+    if (rxCount == 0)
+    {
+        return -1;
+    }
+    uint8_t data = rxBuffer[rxHead];
+    rxHead = (rxHead + 1) % rxBufferSize;
+    rxCount--;
+    nativeRxConsumed++;
+    return data;
+}
+
+size_t HardwareSerial::readBytes(uint8_t *buffer, size_t length)
+{
+    size_t count = std::min(length, rxCount);
+    for (size_t i = 0; i < count; i++)
+    {
+        buffer[i] = rxBuffer[rxHead];
+        rxHead = (rxHead + 1) % rxBufferSize;
+    }
+    rxCount -= count;
+    nativeRxConsumed += count;
+    return count;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    nativeTxBytes += size;
+    if (nativeOnTx)
+    {
+        nativeOnTx(buffer, size);
+    }
+    // The bytes queue behind those still on the line, 10 bits each
+    uint64_t &txDone = nativeUartTxDoneUS[uartNr];
+    txDone = std::max(txDone, nativeNowUS()) + (_baudRate ? (uint64_t)size * 10000000 / _baudRate : 0);
+    return size;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait)
+{
+    const uint64_t now = nativeNowUS();
+    const uint64_t txDone = nativeUartTxDoneUS[uart_num];
+    if (txDone <= now)
+    {
+        return ESP_OK;
+    }
+    if (txDone - now > (uint64_t)ticks_to_wait * 1000)
+    {
+        nativeAdvanceUS(ticks_to_wait * 1000);
+        return ESP_ERR_TIMEOUT;
+    }
+    nativeAdvanceUS(txDone - now);
+    return ESP_OK;
+}
+
+size_t HardwareSerial::nativeInjectRx(const uint8_t *data, size_t len)
+{
+    size_t accepted = std::min(len, rxBufferSize - rxCount);
+    for (size_t i = 0; i < accepted; i++)
+    {
+        rxBuffer[(rxHead + rxCount + i) % rxBufferSize] = data[i];
+    }
+    rxCount += accepted;
+    nativeRxDropped += len - accepted;
+    if (accepted < len && onError)
+    {
+        onError(UART_BUFFER_FULL_ERROR);
+    }
+    if (accepted && onRx)
+    {
+        onRx();
+    }
+    return accepted;
+}
+
+void HardwareSerial::nativeReset()
+{
+    rxHead = 0;
+    rxCount = 0;
+    nativeRxConsumed = 0;
+    nativeRxDropped = 0;
+    nativeTxBytes = 0;
+}
+
+/// GPIO ///
+
+// Pad registers of the IO_MUX as on the ESP32, 0 for the GPIOs that do not exist
+const uint32_t GPIO_PIN_MUX_REG[SOC_GPIO_PIN_COUNT] = {
+    0x3ff49044, 0x3ff49088, 0x3ff49040, 0x3ff49084, 0x3ff49048, 0x3ff4906c, 0x3ff49060, 0x3ff49064,
+    0x3ff49068, 0x3ff49054, 0x3ff49058, 0x3ff4905c, 0x3ff49034, 0x3ff49038, 0x3ff49030, 0x3ff4903c,
+    0x3ff4904c, 0x3ff49050, 0x3ff49070, 0x3ff49074, 0x3ff49078, 0x3ff4907c, 0x3ff49080, 0x3ff4908c,
+    0, 0x3ff49024, 0x3ff49028, 0x3ff4902c, 0, 0, 0, 0,
+    0x3ff4901c, 0x3ff49020, 0x3ff49014, 0x3ff49018, 0x3ff49004, 0x3ff49008, 0x3ff4900c, 0x3ff49010,
+};
+
+/// ESP-NOW ///
+
+static esp_now_send_cb_t nativeSendCB = nullptr;
+static esp_now_recv_cb_t nativeRecvCB = nullptr;
+static std::map<uint64_t, esp_now_peer_info_t> nativePeers;
+static std::map<uint64_t, esp_now_rate_config_t> nativePeerRates;
+
+static uint64_t macToKey(const uint8_t *mac)
+{
+    uint64_t key = 0;
+    for (int i = 0; i < ESP_NOW_ETH_ALEN; i++)
+    {
+        key = (key << 8) | mac[i];
+    }
+    return key;
+}
+
+esp_err_t esp_now_init()
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb)
+{
+    nativeSendCB = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb)
+{
+    nativeRecvCB = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer)
+{
+    if (nativeEspNowAddPeerFailures)
+    {
+        nativeEspNowAddPeerFailures--;
+        return ESP_FAIL;
+    }
+    if (nativePeers.size() >= ESP_NOW_MAX_TOTAL_PEER_NUM)
+    {
+        return ESP_ERR_ESPNOW_FULL;
+    }
+    nativePeers[macToKey(peer->peer_addr)] = *peer;
+    nativeEspNow.peers = nativePeers.size();
+    return ESP_OK;
+}
+
+esp_err_t esp_now_del_peer(const uint8_t *peer_addr)
+{
+    if (nativePeers.erase(macToKey(peer_addr)) == 0)
+    {
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    nativePeerRates.erase(macToKey(peer_addr));
+    nativeEspNow.peers = nativePeers.size();
+    return ESP_OK;
+}
+
+esp_err_t esp_now_mod_peer(const esp_now_peer_info_t *peer)
+{
+    auto it = nativePeers.find(macToKey(peer->peer_addr));
+    if (it == nativePeers.end())
+    {
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    it->second = *peer;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_set_peer_rate_config(const uint8_t *peer_addr, esp_now_rate_config_t *config)
+{
+    if (nativePeers.find(macToKey(peer_addr)) == nativePeers.end())
+    {
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    if (config->phymode == WIFI_PHY_MODE_LR && !(WiFi.protocol & WIFI_PROTOCOL_LR))
+    {
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    nativePeerRates[macToKey(peer_addr)] = *config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_protocol(wifi_interface_t ifx, uint8_t protocol_bitmap)
+{
+    (void)ifx;
+    WiFi.protocol = protocol_bitmap;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data, size_t len)
+{
+    if (len > ESP_NOW_MAX_DATA_LEN)
+    {
+        nativeEspNow.sendErrors++;
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    auto peer = nativePeers.find(macToKey(peer_addr));
+    if (peer == nativePeers.end())
+    {
+        nativeEspNow.sendErrors++;
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    if (peer->second.channel && peer->second.channel != WiFi.channel)
+    {
+        // a peer must be on the channel of the radio (or channel 0, whichever that is)
+        nativeEspNow.sendErrors++;
+        return ESP_ERR_ESPNOW_CHAN;
+    }
+    nativeEspNow.sends++;
+    nativeEspNow.bytes += len;
+    memcpy(nativeEspNow.lastPeer, peer_addr, ESP_NOW_ETH_ALEN);
+    memcpy(nativeEspNow.lastPayload, data, len);
+    nativeEspNow.lastLen = len;
+    auto rate = nativePeerRates.find(macToKey(peer_addr));
+    nativeEspNow.lastRate = rate == nativePeerRates.end() ? WIFI_PHY_RATE_1M_L : rate->second.rate; // the ESP-NOW default
+    const bool acked = !nativeEspNowAck || nativeEspNowAck(peer_addr, nativeEspNow.lastRate);
+    if (!acked) nativeEspNow.lost++;
+    if (nativeSendCB) nativeSendCB(peer_addr, acked ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+    return ESP_OK;
+}
+
+void nativeEspNowReceive(const uint8_t *src, const uint8_t *data, int len)
+{
+    uint8_t srcAddr[ESP_NOW_ETH_ALEN];
+    uint8_t desAddr[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    memcpy(srcAddr, src, ESP_NOW_ETH_ALEN);
+    wifi_pkt_rx_ctrl_t rxCtrl = {};
+    rxCtrl.rssi = -50;
+    rxCtrl.channel = WiFi.channel;
+    esp_now_recv_info_t info = {srcAddr, desAddr, &rxCtrl};
+    if (nativeRecvCB) nativeRecvCB(&info, data, len);
+}
+
+bool nativeEspNowHasPeer(const uint8_t *mac)
+{
+    return nativePeers.find(macToKey(mac)) != nativePeers.end();
+}
+
+void nativeEspNowResetStats()
+{
+    uint32_t peers = nativeEspNow.peers;
+    nativeEspNow = {};
+    nativeEspNow.peers = peers;
+}
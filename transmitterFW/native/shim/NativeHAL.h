@@ -0,0 +1,101 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Host side control of the native HAL shim.
+   The firmware only sees the Arduino/ESP-IDF API, the host code (benchmarks, simulators) uses the
+   functions below to drive the virtual clock and to inspect what the firmware did.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include "esp_now.h"
+
+/**
+ * @brief Advance the virtual clock, firing any hardware timer alarms that fall into the interval.
+ * delay() and delayMicroseconds() advance the same clock.
+ */
+void nativeAdvanceUS(uint32_t us);
+
+/**
+ * @brief Called after every millisecond of virtual time delay() lets pass, to hand the UART the bytes that arrived
+ * meanwhile. loop() polling the handset waits 1 ms, with CRSF_RX_TASK 10 ms and the RX task runs on the bytes in between.
+ */
+extern std::function<void()> nativeDelayHook;
+
+/**
+ * @return the current virtual time in microseconds, without wrap-around
+ */
+uint64_t nativeNowUS();
+
+/**
+ * @brief Host CPU time spent in the hardware timer ISR, tasks it notified not included
+ */
+typedef struct
+{
+    uint32_t calls;
+    uint64_t totalNS;
+    uint64_t maxNS;
+} nativeTimerIsrStats_t;
+
+extern nativeTimerIsrStats_t nativeTimerIsr;
+
+/**
+ * @brief Statistics of the ESP-NOW shim, every esp_now_send() is completed synchronously.
+ */
+typedef struct
+{
+    uint32_t sends;                        // calls to esp_now_send() that were accepted
+    uint32_t sendErrors;                   // calls to esp_now_send() that were rejected
+    uint32_t bytes;                        // payload bytes accepted
+    uint32_t peers;                        // currently registered peers
+    uint8_t lastPeer[ESP_NOW_ETH_ALEN];    // destination of the last accepted frame
+    uint8_t lastPayload[ESP_NOW_MAX_DATA_LEN];
+    size_t lastLen;
+    wifi_phy_rate_t lastRate;              // PHY rate of the last accepted frame, see esp_now_set_peer_rate_config()
+    uint32_t lost;                         // frames reported to the send callback as not acknowledged
+} nativeEspNowStats_t;
+
+extern nativeEspNowStats_t nativeEspNow;
+
+/**
+ * @brief The next this many esp_now_add_peer() calls fail, as with a busy WiFi stack
+ */
+extern uint32_t nativeEspNowAddPeerFailures;
+
+/**
+ * @brief Decides whether the receiver acknowledges a frame sent at `rate`, every frame is acknowledged if unset
+ */
+extern std::function<bool(const uint8_t *peer, wifi_phy_rate_t rate)> nativeEspNowAck;
+
+/**
+ * @brief Deliver a frame from `src` to the receive callback, as if sent to the broadcast address
+ */
+void nativeEspNowReceive(const uint8_t *src, const uint8_t *data, int len);
+
+/**
+ * @return true if `mac` is a registered peer
+ */
+bool nativeEspNowHasPeer(const uint8_t *mac);
+
+/**
+ * @brief Reset the ESP-NOW shim counters (registered peers are kept).
+ */
+void nativeEspNowResetStats();
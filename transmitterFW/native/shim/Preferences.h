@@ -0,0 +1,94 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Arduino-ESP32 Preferences (NVS) backed by memory, lost when the host program ends.
+   nativePreferencesClear() simulates a fresh flash, nativeNvsWrites() counts the writes (flash commits on target). */
+
+typedef std::map<std::string, std::vector<uint8_t>> nativeNvsNamespace_t;
+
+inline std::map<std::string, nativeNvsNamespace_t> &nativeNvs()
+{
+    static std::map<std::string, nativeNvsNamespace_t> nvs;
+    return nvs;
+}
+
+inline uint32_t &nativeNvsWrites()
+{
+    static uint32_t writes = 0;
+    return writes;
+}
+
+inline void nativePreferencesClear() { nativeNvs().clear(); }
+
+class Preferences
+{
+public:
+    bool begin(const char *name, bool readOnly = false)
+    {
+        space = &nativeNvs()[name];
+        this->readOnly = readOnly;
+        return true;
+    }
+
+    void end() { space = nullptr; }
+
+    size_t getBytesLength(const char *key)
+    {
+        auto it = space->find(key);
+        return it == space->end() ? 0 : it->second.size();
+    }
+
+    size_t getBytes(const char *key, void *buf, size_t maxLen)
+    {
+        auto it = space->find(key);
+        if (it == space->end() || it->second.size() > maxLen)
+            return 0;
+        memcpy(buf, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+
+    size_t putBytes(const char *key, const void *value, size_t len)
+    {
+        if (readOnly)
+            return 0;
+        (*space)[key].assign((const uint8_t *)value, (const uint8_t *)value + len);
+        nativeNvsWrites()++;
+        return len;
+    }
+
+    uint64_t getULong64(const char *key, uint64_t defaultValue = 0)
+    {
+        uint64_t value;
+        return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+    }
+
+    size_t putULong64(const char *key, uint64_t value) { return putBytes(key, &value, sizeof(value)); }
+
+private:
+    nativeNvsNamespace_t *space = nullptr;
+    bool readOnly = false;
+};
@@ -0,0 +1,36 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct
+{
+    int num;
+} uart_dev_t;
+
+extern uart_dev_t nativeUartDev[3];
+
+#define UART_LL_GET_HW(num) (&nativeUartDev[(num)])
+
+// Virtual time at which the last byte written to each UART has been shifted out, see HardwareSerial::write()
+extern uint64_t nativeUartTxDoneUS[3];
+uint64_t nativeNowUS();
+
+inline bool uart_ll_is_tx_idle(uart_dev_t *hw) { return nativeNowUS() >= nativeUartTxDoneUS[hw->num]; }
@@ -0,0 +1,37 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "soc/soc.h"
+
+// GPIO matrix registers, offsets follow the ESP32 technical reference manual
+#define DR_REG_GPIO_BASE 0x3ff44000
+
+#define GPIO_ENABLE_W1TS_REG (DR_REG_GPIO_BASE + 0x0024)
+#define GPIO_ENABLE_W1TC_REG (DR_REG_GPIO_BASE + 0x0028)
+#define GPIO_ENABLE1_W1TS_REG (DR_REG_GPIO_BASE + 0x0030)
+#define GPIO_ENABLE1_W1TC_REG (DR_REG_GPIO_BASE + 0x0034)
+
+#define GPIO_FUNC0_IN_SEL_CFG_REG (DR_REG_GPIO_BASE + 0x0130)
+#define GPIO_FUNC0_IN_SEL 0x0000003F
+#define GPIO_FUNC0_IN_INV_SEL (1U << 6)
+#define GPIO_SIG0_IN_SEL (1U << 7)
+
+#define GPIO_FUNC0_OUT_SEL_CFG_REG (DR_REG_GPIO_BASE + 0x0530)
+#define GPIO_FUNC0_OUT_INV_SEL (1U << 9)
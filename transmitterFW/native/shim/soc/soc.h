@@ -0,0 +1,31 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Peripheral registers are backed by a small sparse register file on the host
+uint32_t nativeRegRead(uint32_t addr);
+void nativeRegWrite(uint32_t addr, uint32_t val);
+
+#define REG_READ(_r) nativeRegRead((uint32_t)(_r))
+#define REG_WRITE(_r, _v) nativeRegWrite((uint32_t)(_r), (uint32_t)(_v))
+#define REG_GET_BIT(_r, _b) (nativeRegRead((uint32_t)(_r)) & (_b))
+#define REG_SET_BIT(_r, _b) nativeRegWrite((uint32_t)(_r), nativeRegRead((uint32_t)(_r)) | (_b))
+#define REG_CLR_BIT(_r, _b) nativeRegWrite((uint32_t)(_r), nativeRegRead((uint32_t)(_r)) & ~(_b))
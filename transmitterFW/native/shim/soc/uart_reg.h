@@ -0,0 +1,31 @@
+/*
+ * This file belongs to the CyberBrick ESP-NOW transmitter & receiver project, hosted originally at:
+ * https://github.com/rotorman/CyberBrick_ESPNOW
+ * Copyright (C) 2025, Risto Kõiva
+ *
+ * License GPL-3.0: https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "soc/soc.h"
+
+// Register offsets follow the ESP32 technical reference manual
+#define REG_UART_BASE(i) (0x3ff40000 + ((i) > 1 ? 0xe000 : 0) + ((i) > 0 ? 0x10000 : 0))
+
+#define UART_AUTOBAUD_REG(i) (REG_UART_BASE(i) + 0x18)
+#define UART_GLITCH_FILT_S 8
+#define UART_AUTOBAUD_EN (1U << 0)
+#define UART_LOWPULSE_REG(i) (REG_UART_BASE(i) + 0x28)
+#define UART_HIGHPULSE_REG(i) (REG_UART_BASE(i) + 0x30)
+#define UART_RXD_CNT_REG(i) (REG_UART_BASE(i) + 0x38)
@@ -24,18 +24,31 @@
    You can use any in EdgeTX selectable baud rate.
 */
 
+#include <atomic>
 #include <esp_now.h>
 #include <WiFi.h>
 #include "common.h"
+#include "CRSF.h"
 #include "CRSFHandset.h"
+#include "espnow_protocol.h"
 #include "UnusedPeriph.h"
 #include "hwTimer.h"
+#include "LatencyHistogram.h"
+#include "LinkQuality.h"
+#include "ModelTable.h"
+#include "PeerCache.h"
+#include "ParameterMenu.h"
+#include "EspNowPhyRates.h"
+#include "RateAdapter.h"
+#include "Settings.h"
+#include "TaskLoad.h"
 
 /***** TODO! Adjust the values in this section to YOUR setup! *****/
 
 // Model receiver's MAC address(es) - replace with YOUR CyberBrick receiver Core MAC address(es)!
 // The example below lists 3 models. If you wish to control only one model, remove the bottom two lines (models 1 and 2).
-// You can control/add up to 20 models to the list below (limitation of ESP32 ESP-NOW peer address table).
+// You can control/add up to 64 models to the list below (MODEL_TABLE_SIZE). The receivers are registered with ESP-NOW
+// when their model is selected, the ESPNOW_PEER_CACHE_SIZE most recently used ones stay registered.
 uint8_t cyberbrickRxMAC[][6] =
   {
     {0xa1, 0xb1, 0xc1, 0xd1, 0xe1, 0xf1}, // Model 0 receiver MAC address
@@ -49,10 +62,56 @@ uint8_t cyberbrickRxMAC[][6] =
 // All models must be programmed to use the same WiFi channel:
 
 #define WIFI_CHANNEL 1 // Change to a channel your model's CyberBrick Core MicroPython code is configured to!
-                       // Valid range is from 1 to 11
+                       // Valid range is from 1 to 11. It can also be changed from the radio, in the module's parameter menu.
 
 /******************************************************************/
 
+#ifndef LINK_STATS_INTERVAL_MS
+#define LINK_STATS_INTERVAL_MS 200 // how often link statistics are sent to the handset
+#endif
+#ifndef LINK_QUALITY_WINDOW
+#define LINK_QUALITY_WINDOW 100 // number of ESP-NOW transmissions the link quality is averaged over
+#endif
+#if defined(ESPNOW_SEND_ON_CHANGE)
+#ifndef ESPNOW_CHANGE_TOLERANCE
+#define ESPNOW_CHANGE_TOLERANCE 0 // largest channel change (CRSF units) that still counts as unchanged
+#endif
+#ifndef ESPNOW_KEEPALIVE_MS
+#define ESPNOW_KEEPALIVE_MS 100 // keepalive interval while the channels are unchanged, well below the 500 ms receiver failsafe
+#endif
+#endif
+#ifndef ESPNOW_PHY_RATE
+#define ESPNOW_PHY_RATE 1000 // ESP-NOW PHY rate in kbit/s, one of espnowPhyRates, 0 to adapt it to the link
+#endif
+#ifndef ESPNOW_PHY_RATE_MIN
+#define ESPNOW_PHY_RATE_MIN 1000 // the most robust rate the adaptive rate goes down to, 250 or 500 for 802.11 LR
+#endif
+#ifndef ESPNOW_PHY_RATE_MAX
+#define ESPNOW_PHY_RATE_MAX 24000 // the fastest rate the adaptive rate goes up to
+#endif
+#ifndef ESPNOW_SEND_TASK_PRIORITY
+#define ESPNOW_SEND_TASK_PRIORITY (configMAX_PRIORITIES - 1) // the sender task, woken by the timer ISR
+#endif
+#ifndef ESPNOW_SEND_TASK_CORE
+#define ESPNOW_SEND_TASK_CORE 0 // the core of the WiFi stack (CONFIG_ESP_WIFI_TASK_CORE_ID), loop() and the handset I/O run on 1
+#endif
+#if defined(ESPNOW_SEND_ON_ARRIVAL)
+#ifndef ESPNOW_ARRIVAL_WATCHDOG_PERCENT
+#define ESPNOW_ARRIVAL_WATCHDOG_PERCENT 150 // packet interval in % after which the timer sends when no RC frame arrived
+#endif
+#endif
+#if defined(ESPNOW_CONVOY)
+#ifndef CONVOY_MODEL_ID
+#define CONVOY_MODEL_ID 63 // EdgeTX receiver number that selects the convoy instead of a single model
+#endif
+#ifndef CONVOY_SIZE
+#define CONVOY_SIZE 0 // number of models in the convoy, the first ones of cyberbrickRxMAC, 0 for all
+#endif
+#if defined(ESPNOW_LEGACY_PAYLOAD) && !defined(CONVOY_SHARED)
+#error "The legacy payload has no group frame, use CONVOY_SHARED"
+#endif
+#endif
+
 // The following is replied in a CRSF ping response telegram to the handset and
 // displayed as a module identification in EdgeTX under:
 // System -> About -> Modules / RX version
@@ -61,46 +120,168 @@ char versionID[] = "1.0.0";
 
 // Current state of channels, CRSF format
 volatile uint16_t ChannelData[CRSF_NUM_CHANNELS];
+static uint16_t txChannels[CRSF_NUM_CHANNELS]; // the channels being sent, one snapshot of ChannelData per send slot
 connectionState_e connectionState = awatingFirstPacket;
 
 CRSFHandset *handset = new CRSFHandset();
 esp_now_peer_info_t peerInfo;
+static constexpr unsigned modelCount = sizeof(cyberbrickRxMAC) / sizeof(cyberbrickRxMAC[0]);
+static_assert(modelCount <= MODEL_TABLE_SIZE, "more models than MODEL_TABLE_SIZE");
+static LinkQuality<LINK_QUALITY_WINDOW> linkQuality[MODEL_TABLE_SIZE]; // ESP-NOW send results per model
+static portMUX_TYPE linkQualityMux = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t espnowSeq = 0; // sequence number of the next ESP-NOW RC frame
+static uint32_t packetIntervalUS = RF_FRAME_RATE_US;
+static PeerCache peerCache;
+static std::atomic<const uint8_t *> peerMissing{nullptr}; // receiver of the selected model not registered, retried from loop()
+#if defined(ESPNOW_LEGACY_PAYLOAD)
+static volatile bool legacyPayload = true; // the default, the payload can be changed from the parameter menu
+#else
+static volatile bool legacyPayload = false;
+#endif
+static_assert(ESPNOW_PHY_RATE == 0 || espnowPhyRateIndex(ESPNOW_PHY_RATE) >= 0, "ESPNOW_PHY_RATE is not one of espnowPhyRates");
+static_assert(espnowPhyRateIndex(ESPNOW_PHY_RATE_MIN) >= 0 && espnowPhyRateIndex(ESPNOW_PHY_RATE_MAX) >= espnowPhyRateIndex(ESPNOW_PHY_RATE_MIN),
+              "ESPNOW_PHY_RATE_MIN and ESPNOW_PHY_RATE_MAX must be rates of espnowPhyRates, the minimum the more robust one");
+static RateAdapter rateAdapter;              // PHY rate of the selected model's frames when adaptive, from their send results
+static volatile uint8_t phyRate = 0;         // the index into espnowPhyRates + 1, 0 when adaptive (txSettings_t::phyRate)
+static volatile bool phyRateStale = true;    // the receiver sent to needs its PHY rate set (again)
+static portMUX_TYPE modelSwitchMux = portMUX_INITIALIZER_UNLOCKED;
+static const uint8_t *modelSwitchMAC = nullptr; // receiver of the newly selected model, until a frame reached it
+static uint32_t modelSwitchStartUS = 0;
+static uint32_t modelSwitches = 0;
+static uint32_t modelSwitchMinUS = UINT32_MAX;
+static uint32_t modelSwitchMaxUS = 0;
+static uint32_t modelSwitchLastUS = 0;
+static uint64_t modelSwitchSumUS = 0;
+static LatencyHistogram latencyHistograms[latencyStageCount]; // latencyInput, latencyRxJitter and latencyTurnaround are kept by the handset
+static uint32_t latencyLastFrame = 0;          // RCdataLastRecv of the last RC frame timed, each one is timed once
+static volatile uint32_t latencySendUS = 0;    // when the last frame was handed to esp_now_send()
+static volatile uint32_t latencyArrival = 0;   // UART arrival of the RC frame it carries
+static volatile bool latencyNewFrame = false;  // it carries an RC frame not sent before
+static TaskHandle_t loopTaskHandle = nullptr;  // the Arduino loop task, runs setup() and loop()
+static int8_t loopTaskCore = -1;
+static TaskLoad loopLoad;                      // handset polling and link statistics in loop()
+static TaskLoad timerIsrLoad;
+#if defined(ESPNOW_CONVOY)
+static constexpr uint8_t convoySize = CONVOY_SIZE ? CONVOY_SIZE : modelCount;
+static_assert(convoySize <= modelCount && convoySize <= ESPNOW_RC_MAX_SLOTS, "CONVOY_SIZE too large");
+static_assert(CONVOY_MODEL_ID >= modelCount, "CONVOY_MODEL_ID must not be the number of a single model");
+static const uint8_t broadcastMAC[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+#endif
+#if defined(ESPNOW_SEND_FROM_ISR)
+#if defined(ESPNOW_SEND_ON_ARRIVAL)
+// SendRCdataToRF() runs from the handset and from the timer ISR, whoever finds it taken skips its send instead of
+// spinning: the ISR may preempt the handset on its core, and esp_now_send() must not run with interrupts masked
+static std::atomic_flag sendBusy = ATOMIC_FLAG_INIT;
+#endif
+#else
+static TaskHandle_t senderTaskHandle = nullptr; // runs SendRCdataToRF(), woken by the timer ISR (and the handset)
+static volatile uint32_t timerEventUS = 0;      // when the timer ISR last woke the sender task
+static volatile bool timerEventPending = false;
+static TaskLoad senderLoad;
+#endif
+#if defined(ESPNOW_SEND_ON_CHANGE)
+static uint16_t sentChannels[CRSF_NUM_CHANNELS]; // channels of the last channels frame handed to ESP-NOW
+static uint8_t sentModelId = 0xFF;               // model they were sent to
+static uint32_t lastSendUS = 0;                  // time of the last channels or keepalive frame
+static volatile bool resendChannels = true;      // a frame was lost, the receiver may hold outdated channels
+#endif
 
 bool SendRCdataToRF();
 void timerCallback();
+#if !defined(ESPNOW_SEND_FROM_ISR)
+static void senderTask(void *param);
+#endif
 bool initESPNOW();
 void ESPNOW_OnDataSentCB(const uint8_t *mac_addr, esp_now_send_status_t status);
+void ESPNOW_OnDataRecvCB(const esp_now_recv_info_t *info, const uint8_t *data, int len);
 static void UARTconnected();
 static void UARTdisconnected();
 void ModelUpdateReq();
+static void ModelSelectReq(uint8_t modelid);
+static void registerPeer(const uint8_t *mac);
+static void retryPeer();
+static void linkQualityAdd(uint8_t modelid, bool success);
+static void sendLinkStatistics();
+static void applyPacketInterval(uint32_t intervalUS);
+static bool isConvoy(uint8_t modelid);
+#if defined(ESPNOW_SEND_ON_ARRIVAL)
+static void RCdataArrived();
+#endif
+static bool menuSetWifiChannel(uint8_t channel);
+static void menuSetPayload(bool legacy);
+static void menuSetPhyRate(uint8_t index);
+static void menuBindReceiver(uint8_t modelid, const uint8_t *mac);
+static void applyPhyRate();
+
+// What the parameter menu changes outside of the settings
+static const parameterMenuHooks_t menuHooks = {menuSetWifiChannel, menuSetPayload, menuSetPhyRate, isConvoy, menuBindReceiver};
 
 // Initialization
 void setup() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  loopTaskCore = xPortGetCoreID();
   pinMode(GPIO_PIN_BOOT0, INPUT); // setup so that we can detect pin-change for passthrough mode of the optional ExpressLRS module backpack
   initUnusedDevices();
   handset->Begin();
   handset->registerCallbacks(UARTconnected, UARTdisconnected, ModelUpdateReq);
+  handset->setModelSelectCallback(ModelSelectReq);
+  ModelTable::begin(cyberbrickRxMAC, modelCount);
+  // The settings last saved from the parameter menu, values not (or no longer) supported fall back to the compiled ones
+  const txSettings_t defaults = {RF_FRAME_RATE_US, WIFI_CHANNEL, WIFI_POWER_19_5dBm, legacyPayload,
+                                 ESPNOW_PHY_RATE ? (uint8_t)(espnowPhyRateIndex(ESPNOW_PHY_RATE) + 1) : (uint8_t)0};
+  const txSettings_t &settings = ParameterMenu::begin(handset, menuHooks, defaults);
+  packetIntervalUS = settings.packetIntervalUS;
+  legacyPayload = settings.legacyPayload;
+  phyRate = settings.phyRate;
+  // The adaptive rate starts at the most robust one and moves up while the link is clean
+  rateAdapter.begin(espnowPhyRateIndex(ESPNOW_PHY_RATE_MIN), espnowPhyRateIndex(ESPNOW_PHY_RATE_MAX), espnowPhyRateIndex(ESPNOW_PHY_RATE_MIN));
+#if defined(ESPNOW_SEND_ON_ARRIVAL)
+  handset->setRCDataCallback(RCdataArrived);
+  handset->setSendOnArrival(true);
+#endif
 
   while (!initESPNOW()) {}
+#if !defined(ESPNOW_SEND_FROM_ISR)
+  xTaskCreatePinnedToCore(senderTask, "ESPNOWtx", 4096, nullptr, ESPNOW_SEND_TASK_PRIORITY, &senderTaskHandle, ESPNOW_SEND_TASK_CORE);
+#endif
   hwTimer::init(timerCallback);
-  hwTimer::updateIntervalUS(RF_FRAME_RATE_US);
+  applyPacketInterval(packetIntervalUS);
   setConnectionState(awatingFirstPacket);
+#if defined(CRSF_RX_TASK)
+  handset->startRxTask();
+#endif
 }
 
 // Main execution loop
 void loop() {
-  handset->handleInput();
+  loopLoad.start();
+#if !defined(CRSF_RX_TASK)
+  handset->handleInput(); // else handled by its own task
+#endif
+  sendLinkStatistics();
+  retryPeer();
+  applyPhyRate();
+  Settings::commit();
+  ModelTable::commit();
+  loopLoad.stop();
+#if defined(CRSF_RX_TASK)
+  delay(10);
+#else
   delay(1); // yield
+#endif
 }
 
 bool initESPNOW()
 {
   WiFi.mode(WIFI_STA);
-  WiFi.setChannel(WIFI_CHANNEL, WIFI_SECOND_CHAN_NONE);
-  WiFi.setTxPower(WIFI_POWER_19_5dBm);
+  const txSettings_t &settings = Settings::get();
+  WiFi.setChannel(settings.wifiChannel, WIFI_SECOND_CHAN_NONE);
+  WiFi.setTxPower((wifi_power_t)settings.txPower);
   while (!WiFi.STA.started()) {
     delay(100);
   }
+  // 802.11 LR on top of b/g/n, so the LR rates can be picked at runtime; receivers without LR still hear the b/g/n rates
+  esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N | WIFI_PROTOCOL_LR);
 
   // Init ESP-NOW
   if (esp_now_init() != ESP_OK) return false;
@@ -108,57 +289,406 @@ bool initESPNOW()
   // Register callback to get the status of the transmitted ESP-NOW packet
   if (esp_now_register_send_cb(ESPNOW_OnDataSentCB) != ESP_OK) return false;
 
-  // Register peers
+  // Receivers are only heard while binding
+  if (esp_now_register_recv_cb(ESPNOW_OnDataRecvCB) != ESP_OK) return false;
+
+  // Register the receiver of the selected model, the others follow when selected
   bool bResult = true;
-  for (int i = 0; i < sizeof(cyberbrickRxMAC)/6; i++)
-  { 
-    // Iterate through the peer addresses
-    memset(&peerInfo, 0, sizeof(esp_now_peer_info_t));
-    peerInfo.channel = WIFI_CHANNEL;
-    peerInfo.encrypt = false;
-    memcpy(peerInfo.peer_addr, cyberbrickRxMAC[i], 6);
-    if (esp_now_add_peer(&peerInfo) != ESP_OK)
-    {
-      bResult = false;
-    }
+  peerCache.begin(settings.wifiChannel);
+  const uint8_t *mac = ModelTable::getMAC(handset->getModelID());
+  if (mac && !isConvoy(handset->getModelID()) && !peerCache.use(mac))
+  {
+    bResult = false;
   }
+#if defined(ESPNOW_CONVOY)
+  // The convoy frames are broadcast, every receiver picks out its own channels
+  memset(&peerInfo, 0, sizeof(esp_now_peer_info_t));
+  peerInfo.channel = settings.wifiChannel;
+  peerInfo.encrypt = false;
+  memcpy(peerInfo.peer_addr, broadcastMAC, 6);
+  if (esp_now_add_peer(&peerInfo) != ESP_OK)
+  {
+    bResult = false;
+  }
+#endif
   return bResult;
 }
 
 /*
- * Called from timer ISR when there is a CRSF connection from the handset
+ * Called from timer ISR when there is a CRSF connection from the handset.
+ * Only wakes the sender task (unless ESPNOW_SEND_FROM_ISR): esp_now_send() runs the WiFi stack, which must not happen with the
+ * interrupts masked (the UART RX interrupt would have to wait).
  */
 void ICACHE_RAM_ATTR timerCallback()
 {
+  timerIsrLoad.start();
+  const uint32_t entryUS = micros();
+#if defined(ESPNOW_SEND_FROM_ISR)
   // Do not transmit until in disconnected/connected state
-  if (connectionState == awaitingModelId)
+  if (connectionState != awaitingModelId)
+  {
+#if defined(ESPNOW_SEND_ON_ARRIVAL)
+    // No RC frame for a while, repeat the last channels, unless the handset is sending one right now
+    if (!sendBusy.test_and_set(std::memory_order_acquire))
+    {
+      SendRCdataToRF();
+      sendBusy.clear(std::memory_order_release);
+    }
+#else
+    SendRCdataToRF();
+#endif
+  }
+  latencyHistograms[latencyTimerIsr].add(micros() - entryUS);
+  timerIsrLoad.stop();
+#else
+  BaseType_t woken = pdFALSE;
+  timerEventUS = entryUS;
+  timerEventPending = true;
+  vTaskNotifyGiveFromISR(senderTaskHandle, &woken);
+  latencyHistograms[latencyTimerIsr].add(micros() - entryUS);
+  timerIsrLoad.stop();
+  portYIELD_FROM_ISR(woken);
+#endif
+}
+
+#if !defined(ESPNOW_SEND_FROM_ISR)
+/*
+ * Sends one ESP-NOW frame per wake-up, notifications that come in while it sends are merged into the next one
+ */
+static void senderTask(void *param)
+{
+  (void)param;
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    senderLoad.start();
+    if (timerEventPending)
+    {
+      timerEventPending = false;
+      latencyHistograms[latencyWakeup].add(micros() - timerEventUS);
+    }
+
+    // Do not transmit until in disconnected/connected state
+    if (connectionState != awaitingModelId)
+      SendRCdataToRF();
+    senderLoad.stop();
+  }
+}
+#endif
+
+#if defined(ESPNOW_SEND_ON_ARRIVAL)
+/*
+ * Called from the handset input when an RC frame has been unpacked into ChannelData and published
+ */
+static void RCdataArrived()
+{
+  if (!hwTimer::running || connectionState == awaitingModelId)
     return;
 
-  SendRCdataToRF();
+#if defined(ESPNOW_SEND_FROM_ISR)
+  hwTimer::restart(); // first, the timer then only fires when the next RC frame is late
+  if (!sendBusy.test_and_set(std::memory_order_acquire))
+  {
+    SendRCdataToRF();
+    sendBusy.clear(std::memory_order_release);
+  } // else the ISR on the other core is sending, the next RC frame follows within the packet interval
+#else
+  hwTimer::restart(); // the timer only fires when the next RC frame is late
+  xTaskNotifyGive(senderTaskHandle);
+#endif
+}
+#endif
+
+static bool ICACHE_RAM_ATTR isConvoy(uint8_t modelid)
+{
+#if defined(ESPNOW_CONVOY)
+  return modelid == CONVOY_MODEL_ID;
+#else
+  (void)modelid;
+  return false;
+#endif
 }
 
+static const uint8_t * ICACHE_RAM_ATTR peerMAC(uint8_t modelid)
+{
+#if defined(ESPNOW_CONVOY)
+  if (isConvoy(modelid))
+    return broadcastMAC;
+#endif
+  return ModelTable::getMAC(modelid);
+}
+
+// Hand a frame to ESP-NOW, along with the timestamps its send callback needs for the latency histograms.
+// `channels`: the frame carries ChannelData, an RC frame is timed with its first transmission only.
+static esp_err_t ICACHE_RAM_ATTR espnowSend(const uint8_t *mac, const uint8_t *data, size_t len, bool channels)
+{
+  const uint32_t received = handset->GetRCdataLastRecv();
+  const bool newFrame = channels && received != latencyLastFrame;
+  const uint32_t now = micros();
+  latencyArrival = handset->GetRCdataArrival();
+  latencySendUS = now;
+  latencyNewFrame = newFrame; // set before sending, the callback may run before esp_now_send() returns
+
+  esp_err_t result = esp_now_send(mac, data, len);
+  if (result != ESP_OK)
+  {
+    latencyNewFrame = false;
+  }
+  else if (newFrame)
+  {
+    latencyHistograms[latencySchedule].add(now - received);
+    latencyLastFrame = received;
+  }
+  return result;
+}
+
+static esp_err_t ICACHE_RAM_ATTR espnowSendChannels(uint8_t modelid)
+{
+#if defined(ESPNOW_CONVOY) && !defined(CONVOY_SHARED)
+  if (isConvoy(modelid))
+  {
+    // One frame for the whole convoy, the 16 channels are split evenly between its models
+    espnowRcGroupPacket_t packet;
+    espnowRcPackGroup(&packet, txChannels, espnowSeq, convoySize, ModelTable::getMACs());
+    return espnowSend(broadcastMAC, (uint8_t *) &packet, espnowRcGroupPacketSize(convoySize), true);
+  }
+#endif
+  if (legacyPayload)
+    return espnowSend(peerMAC(modelid), (uint8_t *) txChannels, sizeof(txChannels), true);
+  espnowRcChannelsPacket_t packet;
+  espnowRcPackChannels(&packet, txChannels, espnowSeq);
+  return espnowSend(peerMAC(modelid), (uint8_t *) &packet, sizeof(packet), true);
+}
+
+#if defined(ESPNOW_SEND_ON_CHANGE)
+static esp_err_t ICACHE_RAM_ATTR espnowSendKeepalive(uint8_t modelid)
+{
+  if (isConvoy(modelid))
+    return espnowSendChannels(modelid); // broadcasts are not acknowledged, a lost frame is only repaired by the next one
+  if (legacyPayload)
+    return espnowSendChannels(modelid); // the legacy format has no keepalive frame
+  espnowRcHeader_t packet;
+  espnowRcMakeKeepalive(&packet, espnowSeq);
+  return espnowSend(peerMAC(modelid), (uint8_t *) &packet, sizeof(packet), false);
+}
+
+static bool ICACHE_RAM_ATTR channelsChanged()
+{
+  for (unsigned i = 0; i < CRSF_NUM_CHANNELS; i++)
+  {
+    if (abs((int)txChannels[i] - (int)sentChannels[i]) > ESPNOW_CHANGE_TOLERANCE)
+      return true;
+  }
+  return false;
+}
+#endif
+
 bool ICACHE_RAM_ATTR SendRCdataToRF()
 {
   // Send message via ESP-NOW
   uint8_t modelid = handset->getModelID();
   bool bResult = false;
-  if (modelid <= sizeof(cyberbrickRxMAC)/6) // Plausibility check that we are not accessing cyberbrickRxMAC array out of bounds
+  if (isConvoy(modelid) || ModelTable::getMAC(modelid)) // Plausibility check that the model has a receiver
   {
-    esp_err_t result = esp_now_send(cyberbrickRxMAC[modelid], (uint8_t *) &ChannelData, sizeof(ChannelData));
-   
+    if (!isConvoy(modelid) && peerMissing.load() == ModelTable::getMAC(modelid))
+      return false; // not registered as a peer, no frame for it until loop() registered it
+    handset->ReadChannels(txChannels); // all channels of one RC frame, ChannelData may be written meanwhile
+#if defined(ESPNOW_SEND_ON_CHANGE)
+    esp_err_t result;
+    if (resendChannels || modelid != sentModelId || channelsChanged())
+    {
+      result = espnowSendChannels(modelid);
+      if (result == ESP_OK)
+      {
+        for (unsigned i = 0; i < CRSF_NUM_CHANNELS; i++) sentChannels[i] = txChannels[i];
+        sentModelId = modelid;
+        resendChannels = false;
+      }
+    }
+    else if (micros() - lastSendUS >= ESPNOW_KEEPALIVE_MS * 1000)
+    {
+      result = espnowSendKeepalive(modelid);
+    }
+    else
+    {
+      handset->JustSentRFpacket(); // nothing to send in this slot, keep the EdgeTX sync running
+      return false;
+    }
+    if (result == ESP_OK)
+      lastSendUS = micros();
+#else
+    esp_err_t result = espnowSendChannels(modelid);
+#endif
+
     if (result == ESP_OK) {
+      espnowSeq++; // only frames that went to the radio count, a gap seen by the receiver is a frame lost on air
       bResult = true;
     }
+    else if (!isConvoy(modelid))
+    {
+      linkQualityAdd(modelid, false); // there will be no send callback for this frame
+    }
   }
   return bResult;
 }
 
 // ESP-NOW callback, called when data is sent
 void ESPNOW_OnDataSentCB(const uint8_t *mac_addr, esp_now_send_status_t status) {
+  const uint32_t now = micros();
+  latencyHistograms[latencyAir].add(now - latencySendUS);
+  if (latencyNewFrame)
+  {
+    if (status == ESP_NOW_SEND_SUCCESS)
+      latencyHistograms[latencyTotal].add(now - latencyArrival);
+    latencyNewFrame = false;
+  }
+
   if (status == ESP_NOW_SEND_SUCCESS)
   {
     handset->JustSentRFpacket();
   }
+
+  int modelid = ModelTable::find(mac_addr);
+  if (modelid >= 0)
+  {
+    linkQualityAdd(modelid, status == ESP_NOW_SEND_SUCCESS);
+    if (!phyRate && modelid == handset->getModelID())
+    {
+      portENTER_CRITICAL_ISR(&linkQualityMux);
+      rateAdapter.add(status == ESP_NOW_SEND_SUCCESS);
+      portEXIT_CRITICAL_ISR(&linkQualityMux);
+    }
+  }
+
+  if (status == ESP_NOW_SEND_SUCCESS)
+  {
+    portENTER_CRITICAL_ISR(&modelSwitchMux);
+    if (modelSwitchMAC && memcmp(mac_addr, modelSwitchMAC, 6) == 0)
+    {
+      // First frame that reached the receiver of a newly selected model
+      uint32_t us = micros() - modelSwitchStartUS;
+      modelSwitchMAC = nullptr;
+      modelSwitches++;
+      modelSwitchLastUS = us;
+      modelSwitchMinUS = min(modelSwitchMinUS, us);
+      modelSwitchMaxUS = max(modelSwitchMaxUS, us);
+      modelSwitchSumUS += us;
+    }
+    portEXIT_CRITICAL_ISR(&modelSwitchMux);
+  }
+#if defined(ESPNOW_SEND_ON_CHANGE)
+  if (status != ESP_NOW_SEND_SUCCESS)
+    resendChannels = true;
+#endif
+}
+
+// Called from the WiFi task, receivers are only heard while binding
+void ESPNOW_OnDataRecvCB(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+  ParameterMenu::onReceive(info->src_addr, data, len);
+}
+
+// Called from the ESP-NOW send callback and from the timer ISR
+static void ICACHE_RAM_ATTR linkQualityAdd(uint8_t modelid, bool success)
+{
+  portENTER_CRITICAL_ISR(&linkQualityMux);
+  linkQuality[modelid].add(success);
+  portEXIT_CRITICAL_ISR(&linkQualityMux);
+}
+
+// Report the ESP-NOW link quality of the selected model to the handset as CRSF link statistics
+static void sendLinkStatistics()
+{
+  static uint32_t lastSent = 0;
+  uint32_t now = millis();
+  if (connectionState != connected || (now - lastSent) < LINK_STATS_INTERVAL_MS)
+    return;
+  lastSent = now;
+
+  uint8_t modelid = handset->getModelID();
+  if (isConvoy(modelid) || !ModelTable::getMAC(modelid))
+    return;
+
+  // ESP-NOW reports no RSSI or SNR for sent frames, only the uplink quality is known
+  CRSF::LinkStatistics.uplink_Link_quality = linkQuality[modelid].getLQ();
+  CRSF::LinkStatistics.uplink_TX_Power = ParameterMenu::getCrsfTxPower();
+  CRSF::LinkStatistics.active_antenna = 0;
+
+  uint8_t frame[CRSF_FRAME_SIZE(sizeof(crsfLinkStatistics_t)) + CRSF_FRAME_NOT_COUNTED_BYTES];
+  CRSFHandset::makeLinkStatisticsPacket(frame);
+  handset->sendTelemetryToTX(frame);
+}
+
+bool setPacketInterval(uint32_t intervalUS)
+{
+  const auto end = RFpacketIntervalsUS + sizeof(RFpacketIntervalsUS) / sizeof(RFpacketIntervalsUS[0]);
+  if (std::find(RFpacketIntervalsUS, end, intervalUS) == end)
+    return false;
+  if ((int32_t)intervalUS < handset->getMinPacketInterval())
+    return false; // the handset cannot send RC frames this fast at its baud rate
+
+  packetIntervalUS = intervalUS;
+  applyPacketInterval(intervalUS);
+  return true;
+}
+
+uint32_t getPacketInterval()
+{
+  return packetIntervalUS;
+}
+
+// Set the PHY rate of the receiver sent to when the rate, the model or its registration changed, called from loop().
+// The other receivers keep theirs until selected. Convoy broadcasts are not acknowledged, they go at the adaptive
+// rate's most robust one.
+static void applyPhyRate()
+{
+  static uint8_t appliedModel = 0xFF;
+  static uint8_t appliedRate = 0xFF;
+  const uint8_t modelid = handset->getModelID();
+  uint8_t rate = phyRate ? phyRate - 1 : isConvoy(modelid) ? espnowPhyRateIndex(ESPNOW_PHY_RATE_MIN) : rateAdapter.getRate();
+  const uint8_t *mac = peerMAC(modelid);
+  if (!mac || (!phyRateStale && modelid == appliedModel && rate == appliedRate))
+    return;
+
+  phyRateStale = false;
+  esp_now_rate_config_t config = {};
+  config.phymode = espnowPhyRates[rate].mode;
+  config.rate = espnowPhyRates[rate].rate;
+  if (esp_now_set_peer_rate_config(mac, &config) != ESP_OK)
+  {
+    phyRateStale = true; // the receiver is not registered (yet), try again
+    return;
+  }
+  appliedModel = modelid;
+  appliedRate = rate;
+}
+
+void getPhyRateStats(phyRateStats_t *stats, bool reset)
+{
+  rateAdapterStats_t adapter;
+  portENTER_CRITICAL(&linkQualityMux);
+  rateAdapter.getStats(&adapter, reset);
+  portEXIT_CRITICAL(&linkQualityMux);
+  stats->kbps = espnowPhyRates[phyRate ? phyRate - 1 : rateAdapter.getRate()].kbps;
+  stats->adaptive = !phyRate;
+  stats->stepsDown = adapter.stepsDown;
+  stats->stepsUp = adapter.stepsUp;
+  stats->failedProbes = adapter.failedProbes;
+}
+
+// Move the hwTimer, the EdgeTX sync and the telemetry window to the interval in one go
+static void applyPacketInterval(uint32_t intervalUS)
+{
+  const bool running = hwTimer::running;
+  hwTimer::stop(); // the timer must not run while its interval changes
+#if defined(ESPNOW_SEND_ON_ARRIVAL)
+  hwTimer::updateIntervalUS(intervalUS * ESPNOW_ARRIVAL_WATCHDOG_PERCENT / 100);
+#else
+  hwTimer::updateIntervalUS(intervalUS);
+#endif
+  handset->setPacketInterval(intervalUS);
+  if (running)
+    hwTimer::resume();
 }
 
 static void UARTdisconnected()
@@ -180,14 +710,169 @@ static void UARTconnected()
     setConnectionState(awaitingModelId);
   }
 
+  // The handset may have come back at a lower baud rate, fall back to the fastest rate it still supports
+  if ((int32_t)packetIntervalUS < handset->getMinPacketInterval())
+  {
+    for (uint32_t intervalUS : RFpacketIntervalsUS)
+    {
+      if ((int32_t)intervalUS >= handset->getMinPacketInterval())
+        packetIntervalUS = intervalUS; // the intervals are sorted from the slowest to the fastest rate
+    }
+    applyPacketInterval(packetIntervalUS);
+  }
+
+#if defined(ESPNOW_SEND_ON_CHANGE)
+  resendChannels = true; // the receiver may have gone to failsafe meanwhile
+#endif
+
   // Start the timer to get EdgeTX sync going and a ModelID update sent
   hwTimer::resume();
 }
 
 void ModelUpdateReq()
 {
+  ParameterMenu::applyBind(); // bind to the model selected when it started
+  phyRateStale = true; // a receiver registered anew starts at the default rate
+
   if (connectionState == awaitingModelId)
   {
     setConnectionState(connected);
   }
 }
+
+// Called before the handset selects the model, so its receiver is a registered peer before a frame is sent to it.
+// Times how long until a frame reaches it.
+static void ModelSelectReq(uint8_t modelid)
+{
+  const uint8_t *mac = ModelTable::getMAC(modelid);
+  if (!mac || isConvoy(modelid))
+    return;
+  portENTER_CRITICAL(&modelSwitchMux);
+  modelSwitchStartUS = micros();
+  modelSwitchMAC = mac;
+  portEXIT_CRITICAL(&modelSwitchMux);
+  registerPeer(mac);
+}
+
+// Register the receiver of the selected model, loop() retries it if esp_now_add_peer() failed
+static void registerPeer(const uint8_t *mac)
+{
+  peerMissing = peerCache.use(mac) ? nullptr : mac;
+}
+
+static void retryPeer()
+{
+  const uint8_t *mac = peerMissing.load();
+  if (mac && peerCache.use(mac))
+    peerMissing.compare_exchange_strong(mac, nullptr); // unless the handset selected another model meanwhile
+}
+
+void getModelSwitchStats(modelSwitchStats_t *stats, bool reset)
+{
+  const peerCacheStats_t &cache = peerCache.getStats();
+  portENTER_CRITICAL(&modelSwitchMux);
+  stats->switches = modelSwitches;
+  stats->lastUS = modelSwitchLastUS;
+  stats->minUS = modelSwitches ? modelSwitchMinUS : 0;
+  stats->maxUS = modelSwitchMaxUS;
+  stats->avgUS = modelSwitches ? modelSwitchSumUS / modelSwitches : 0;
+  stats->peerHits = cache.hits;
+  stats->peerMisses = cache.misses;
+  stats->peerEvictions = cache.evictions;
+  if (reset)
+  {
+    modelSwitches = 0;
+    modelSwitchMinUS = UINT32_MAX;
+    modelSwitchMaxUS = 0;
+    modelSwitchSumUS = 0;
+  }
+  portEXIT_CRITICAL(&modelSwitchMux);
+}
+
+void getLatencyHistogram(latencyStage_e stage, latencyHistogram_t *histogram, bool reset)
+{
+  if (stage == latencyInput)
+    handset->GetInputLatency(histogram, reset);
+  else if (stage == latencyRxJitter)
+    handset->GetRxJitter(histogram, reset);
+  else if (stage == latencyTurnaround)
+    handset->GetTurnaround(histogram, reset);
+  else if (stage < latencyStageCount)
+    latencyHistograms[stage].read(histogram, reset);
+}
+
+static void taskStats(taskStats_t *stats, const char *name, TaskHandle_t task, int8_t core, TaskLoad &load, bool reset)
+{
+  stats->name = name;
+  stats->core = core;
+  stats->priority = task ? uxTaskPriorityGet(task) : 0;
+  stats->loadPermille = load.read(&stats->runs, reset);
+  stats->stackFreeBytes = task ? uxTaskGetStackHighWaterMark(task) : 0;
+}
+
+uint8_t getTaskStats(taskStats_t *stats, uint8_t maxTasks, bool reset)
+{
+  uint8_t n = 0;
+  if (n < maxTasks)
+    taskStats(&stats[n++], "loop", loopTaskHandle, loopTaskCore, loopLoad, reset);
+#if defined(CRSF_RX_TASK)
+  if (n < maxTasks && handset->GetRxTask())
+    taskStats(&stats[n++], "CRSFrx", handset->GetRxTask(), CRSF_RX_TASK_CORE, handset->GetRxTaskLoad(), reset);
+#endif
+#if !defined(ESPNOW_SEND_FROM_ISR)
+  if (n < maxTasks)
+    taskStats(&stats[n++], "ESPNOWtx", senderTaskHandle, ESPNOW_SEND_TASK_CORE, senderLoad, reset);
+#endif
+  if (n < maxTasks)
+    taskStats(&stats[n++], "timer ISR", nullptr, loopTaskCore, timerIsrLoad, reset); // attached from setup()
+  return n;
+}
+
+/// Hooks of the parameter menu (ParameterMenu), for the state the firmware owns. Called in the handset context ///
+
+// The radio changes channel at once, the registered receivers follow it
+static bool menuSetWifiChannel(uint8_t channel)
+{
+  if (!WiFi.setChannel(channel, WIFI_SECOND_CHAN_NONE))
+    return false;
+  if (!peerCache.setChannel(channel))
+  {
+    // A receiver that could not be moved is unregistered, the selected one is registered again
+    const uint8_t modelid = handset->getModelID();
+    const uint8_t *mac = ModelTable::getMAC(modelid);
+    if (mac && !isConvoy(modelid))
+      registerPeer(mac);
+  }
+#if defined(ESPNOW_CONVOY)
+  peerInfo.channel = channel; // still the broadcast peer registered in initESPNOW()
+  esp_now_mod_peer(&peerInfo);
+#endif
+  phyRateStale = true;
+  return true;
+}
+
+static void menuSetPayload(bool legacy)
+{
+  legacyPayload = legacy;
+}
+
+static void menuSetPhyRate(uint8_t index)
+{
+  phyRate = index;
+  phyRateStale = true;
+}
+
+// Store the receiver heard by Bind. The new peer is registered before the model table refers to it, the old one removed after.
+static void menuBindReceiver(uint8_t modelid, const uint8_t *mac)
+{
+  uint8_t oldMAC[6] = {};
+  const uint8_t *old = ModelTable::getMAC(modelid);
+  if (old)
+    memcpy(oldMAC, old, 6);
+  if (modelid == handset->getModelID())
+    registerPeer(mac);
+  ModelTable::setMAC(modelid, mac);
+  if (old && memcmp(oldMAC, mac, 6) != 0)
+    peerCache.remove(oldMAC);
+  phyRateStale = true;
+}